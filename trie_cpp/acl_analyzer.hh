@@ -0,0 +1,427 @@
+#ifndef ACL_ANALYZER_HH
+#define ACL_ANALYZER_HH
+
+#include "classifier.hh"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Static set of closed intervals answering which of them overlap [ql, qh] in
+// O(log n + k): the intervals are sorted by low bound, which leaves the
+// candidates as the prefix with low <= qh, and a max segment tree of the high
+// bounds over that order prunes every subtree whose highest bound is below ql.
+// How many overlap is O(log n) alone: those with low <= qh less those with
+// high < ql, which all have low <= qh.
+class interval_index {
+public:
+    void add(uint32_t lo, uint32_t hi, uint32_t id) {
+        items.push_back({lo, hi, id});
+    }
+
+    // call once after the last add().
+    void build() {
+        std::sort(items.begin(), items.end(), [](const item& a, const item& b) {
+            return a.lo < b.lo;
+        });
+        leaves = std::bit_ceil(std::max<size_t>(items.size(), 1));
+        max_hi.assign(2 * leaves, 0);
+        for (size_t i = 0; i < items.size(); i++) {
+            max_hi[leaves + i] = items[i].hi;
+        }
+        for (size_t i = leaves; i-- > 1;) {
+            max_hi[i] = std::max(max_hi[2 * i], max_hi[2 * i + 1]);
+        }
+        highs.clear();
+        for (const auto& it : items) {
+            highs.push_back(it.hi);
+        }
+        std::sort(highs.begin(), highs.end());
+    }
+
+    // the number of intervals overlapping [ql, qh].
+    size_t count(uint32_t ql, uint32_t qh) const {
+        return low_at_most(qh) - (std::lower_bound(highs.begin(), highs.end(), ql) - highs.begin());
+    }
+
+    // calls f(id) for every interval overlapping [ql, qh], by low bound.
+    template <typename F>
+    void overlapping(uint32_t ql, uint32_t qh, F&& f) const {
+        visit(1, 0, leaves, low_at_most(qh), ql, f);
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    size_t memory_usage() const {
+        return sizeof(interval_index) + items.capacity() * sizeof(item) +
+               (max_hi.capacity() + highs.capacity()) * sizeof(uint32_t);
+    }
+
+private:
+    struct item {
+        uint32_t lo;
+        uint32_t hi;
+        uint32_t id;
+    };
+
+    size_t low_at_most(uint32_t qh) const {
+        return std::upper_bound(items.begin(), items.end(), qh, [](uint32_t v, const item& a) {
+                   return v < a.lo;
+               }) - items.begin();
+    }
+
+    template <typename F>
+    void visit(size_t node, size_t b, size_t e, size_t k, uint32_t ql, F& f) const {
+        if (b >= k || max_hi[node] < ql) {
+            return;
+        }
+        if (e - b == 1) {
+            f(items[b].id);
+            return;
+        }
+        size_t mid = (b + e) / 2;
+        visit(2 * node, b, mid, k, ql, f);
+        visit(2 * node + 1, mid, e, k, ql, f);
+    }
+
+    std::vector<item> items;
+    std::vector<uint32_t> max_hi;
+    // the high bounds, sorted.
+    std::vector<uint32_t> highs;
+    size_t leaves = 1;
+};
+
+// Findings of acl_analyzer, rule ids being positions in the rule vector.
+struct acl_report {
+    struct finding {
+        uint32_t rule;
+        uint32_t by;
+        bool operator==(const finding&) const = default;
+    };
+
+    size_t rules = 0;
+    // rule never matches: the earlier rule by covers all of it.
+    std::vector<finding> shadowed;
+    // rule can be removed if its action equals the one of by: by is the
+    // first later rule overlapping it and covers all of it.
+    std::vector<finding> redundant;
+    // (earlier, later) pairs overlapping without either covering the other,
+    // at most max_correlated of them, the same ones for any thread count.
+    std::vector<std::pair<uint32_t, uint32_t>> correlated;
+    uint64_t correlated_count = 0;
+
+    // one JSON object, findings sorted by rule.
+    std::string json() const {
+        std::string out = fmt::format("{{\"rules\":{},\"shadowed\":[", rules);
+        auto findings = [&](const std::vector<finding>& fs) {
+            for (size_t i = 0; i < fs.size(); i++) {
+                out += fmt::format("{}{{\"rule\":{},\"by\":{}}}", i ? "," : "", fs[i].rule, fs[i].by);
+            }
+        };
+        findings(shadowed);
+        out += "],\"redundant\":[";
+        findings(redundant);
+        out += fmt::format("],\"correlated_count\":{},\"correlated\":[", correlated_count);
+        for (size_t i = 0; i < correlated.size(); i++) {
+            out += fmt::format("{}[{},{}]", i ? "," : "", correlated[i].first, correlated[i].second);
+        }
+        out += "]}";
+        return out;
+    }
+};
+
+// Conflict analysis of an acl_rule set (Al-Shaer and Hamed anomalies) without
+// comparing every pair of rules.
+//
+// Two rules overlap only if their src prefixes nest, their dst prefixes nest
+// and their port and protocol ranges intersect. The rules are grouped by src
+// prefix in a trie, and every group keeps its rules sorted by dst, with a trie
+// from each dst prefix to its slice. A long slice, such as the one of the
+// wildcard, has an interval_index for each of the src port, dst port and
+// protocol ranges. A rule walks the less specifics of its src, at most 33
+// groups; in each, the dst trie gives the slices of its dst and of its less
+// specifics. A long slice is searched through the index of the range fewest
+// of its rules overlap the rule in, counted in O(log n); a short one is
+// scanned. The more specifics of its dst are one contiguous range scanned
+// linearly. Every pair comes up once, from the more specific src side.
+//
+// The cost is O(n log n) plus, for every rule, the rules of the slices it
+// meets overlapping it in their most selective range, plus the rules under
+// more specific dst prefixes. When one of the ranges, or the dst prefixes,
+// separate the rules, that is about the number of overlapping pairs, the
+// output size of any exact correlation report. The worst case is still
+// quadratic: rules with nested addresses whose ranges overlap pairwise in
+// every field taken alone but seldom in all of them at once, a grid of port
+// ranges for one, or many rules under more specific dst prefixes whose ports
+// all differ.
+//
+// The index is read only once built, analyze() splits the rules across
+// threads and merges their findings in rule order, so the report does not
+// depend on the thread count.
+class acl_analyzer {
+public:
+    static constexpr size_t default_max_correlated = 1 << 20;
+
+    explicit acl_analyzer(const std::vector<acl_rule>& rules) : rules{rules}, boxes(rules.begin(), rules.end()) {
+        if (rules.size() >= no_rule) {
+            throw std::invalid_argument(fmt::format("too many rules {}", rules.size()));
+        }
+        // trie values are ids + 1, 0 being no info.
+        for (uint32_t i = 0; i < rules.size(); i++) {
+            auto g = src_index.find(rules[i].src);
+            if (!g || !*g) {
+                groups.push_back(std::make_unique<group>());
+                src_index.insert(rules[i].src, uint32_t(groups.size()));
+                g = groups.size();
+            }
+            groups[*g - 1]->ids.push_back(i);
+        }
+        for (auto& g : groups) {
+            build_group(*g);
+        }
+    }
+
+    acl_analyzer(const acl_analyzer&) = delete;
+    acl_analyzer& operator=(const acl_analyzer&) = delete;
+
+    acl_report analyze(size_t threads = std::max(1u, std::thread::hardware_concurrency()),
+                       size_t max_correlated = default_max_correlated) const {
+        if (threads == 0) {
+            throw std::invalid_argument("analyzer needs at least one thread");
+        }
+        size_t n = rules.size();
+        threads = std::max<size_t>(1, std::min(threads, n / min_chunk));
+        size_t chunks = std::max<size_t>(1, std::min(threads * 16, (n + min_chunk - 1) / min_chunk));
+
+        std::vector<scratch> local(threads);
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(chunks);
+        std::vector<uint64_t> counts(chunks, 0);
+        std::atomic<size_t> next{0};
+        auto work = [&](scratch& s) {
+            s.shadowed_by.assign(n, no_rule);
+            s.first_later.assign(n, no_rule);
+            for (size_t c; (c = next.fetch_add(1, std::memory_order_relaxed)) < chunks;) {
+                for (size_t j = c * n / chunks; j < (c + 1) * n / chunks; j++) {
+                    pairs_of(uint32_t(j), s, [&](uint32_t a, uint32_t b) {
+                        // every chunk keeps its first max_correlated, enough
+                        // for the first max_correlated overall.
+                        if (found[c].size() < max_correlated) {
+                            found[c].emplace_back(a, b);
+                        }
+                        counts[c]++;
+                    });
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++) {
+            pool.emplace_back(work, std::ref(local[t]));
+        }
+        work(local[0]);
+        for (auto& t : pool) {
+            t.join();
+        }
+
+        acl_report r;
+        r.rules = n;
+        for (size_t t = 1; t < threads; t++) {
+            for (size_t i = 0; i < n; i++) {
+                local[0].shadowed_by[i] = std::min(local[0].shadowed_by[i], local[t].shadowed_by[i]);
+                local[0].first_later[i] = std::min(local[0].first_later[i], local[t].first_later[i]);
+            }
+        }
+        const auto& shadowed_by = local[0].shadowed_by;
+        const auto& first_later = local[0].first_later;
+        for (uint32_t i = 0; i < n; i++) {
+            if (shadowed_by[i] != no_rule) {
+                r.shadowed.push_back({i, shadowed_by[i]});
+                continue;
+            }
+            // removing i hands its packets to the first later rule it
+            // overlaps; equal boxes are reported as that rule being shadowed.
+            uint32_t k = first_later[i];
+            if (k != no_rule && boxes[k].contains(boxes[i]) && !(boxes[k] == boxes[i])) {
+                r.redundant.push_back({i, k});
+            }
+        }
+        for (size_t c = 0; c < chunks; c++) {
+            r.correlated_count += counts[c];
+            size_t take = std::min(found[c].size(), max_correlated - r.correlated.size());
+            r.correlated.insert(r.correlated.end(), found[c].begin(), found[c].begin() + take);
+        }
+        std::sort(r.correlated.begin(), r.correlated.end());
+        return r;
+    }
+
+    size_t memory_usage() const {
+        size_t bytes = src_index.node_count() * sizeof(trie_node<uint32_t>) + boxes.capacity() * sizeof(acl_box) +
+                       rules.capacity() * sizeof(acl_rule);
+        for (const auto& g : groups) {
+            bytes += sizeof(group) + g->dst_index.node_count() * sizeof(trie_node<uint32_t>) +
+                     g->ids.capacity() * sizeof(uint32_t) + g->boxes.capacity() * sizeof(acl_box) +
+                     g->slices.capacity() * sizeof(slice);
+            for (const auto& sl : g->slices) {
+                if (sl.ranges) {
+                    for (const auto& index : *sl.ranges) {
+                        bytes += index.memory_usage();
+                    }
+                }
+            }
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t no_rule = std::numeric_limits<uint32_t>::max();
+    // rules per unit of work handed to a thread.
+    static constexpr size_t min_chunk = 256;
+    // shorter slices are scanned, the range indexes do not pay for
+    // themselves.
+    static constexpr size_t indexed_slice = 16;
+    // the fields of acl_box with a range index: src port, dst port, proto.
+    static constexpr size_t first_range = 2;
+    static constexpr size_t range_fields = acl_fields - first_range;
+
+    // rules [begin, end) of a group share their dst prefix.
+    struct slice {
+        uint32_t begin;
+        uint32_t end;
+        // range field to positions in the group, for long slices only.
+        std::unique_ptr<std::array<interval_index, range_fields>> ranges;
+
+        // calls f(position) for the rules of the slice overlapping b, and
+        // for some more when not indexed.
+        template <typename F>
+        void overlapping(const acl_box& b, F& f) const {
+            if (!ranges) {
+                for (uint32_t k = begin; k < end; k++) {
+                    f(k);
+                }
+                return;
+            }
+            const auto& index = *ranges;
+            size_t best = 0;
+            size_t fewest = index[0].count(b.lo[first_range], b.hi[first_range]);
+            for (size_t d = 1; d < range_fields && fewest; d++) {
+                size_t c = index[d].count(b.lo[first_range + d], b.hi[first_range + d]);
+                if (c < fewest) {
+                    best = d;
+                    fewest = c;
+                }
+            }
+            if (fewest) {
+                index[best].overlapping(b.lo[first_range + best], b.hi[first_range + best], f);
+            }
+        }
+    };
+
+    // the rules of one src prefix, by dst address then prefix length: the
+    // more specifics of a dst prefix are the rules from its address on up to
+    // its last address, less the shorter ones at its very address.
+    struct group {
+        std::vector<uint32_t> ids;
+        std::vector<acl_box> boxes;
+        std::vector<slice> slices;
+        // dst prefix to slice id + 1.
+        trie<uint32_t> dst_index;
+    };
+
+    // per thread minimums, merged after the join.
+    struct scratch {
+        std::vector<uint32_t> shadowed_by;
+        std::vector<uint32_t> first_later;
+    };
+
+    void build_group(group& g) {
+        // stable, the rules of a slice stay in priority order.
+        std::stable_sort(g.ids.begin(), g.ids.end(), [&](uint32_t a, uint32_t b) {
+            const auto& pa = rules[a].dst;
+            const auto& pb = rules[b].dst;
+            return pa.v != pb.v ? pa.v < pb.v : pa.len < pb.len;
+        });
+        for (uint32_t k = 0; k < g.ids.size(); k++) {
+            g.boxes.push_back(boxes[g.ids[k]]);
+            const auto& dst = rules[g.ids[k]].dst;
+            if (k == 0 || !(dst == rules[g.ids[k - 1]].dst)) {
+                g.slices.push_back({k, k, nullptr});
+                g.dst_index.insert(dst, uint32_t(g.slices.size()));
+            }
+            g.slices.back().end = k + 1;
+        }
+        for (auto& sl : g.slices) {
+            if (sl.end - sl.begin >= indexed_slice) {
+                sl.ranges = std::make_unique<std::array<interval_index, range_fields>>();
+                for (size_t d = 0; d < range_fields; d++) {
+                    auto& index = (*sl.ranges)[d];
+                    for (uint32_t k = sl.begin; k < sl.end; k++) {
+                        index.add(g.boxes[k].lo[first_range + d], g.boxes[k].hi[first_range + d], k);
+                    }
+                    index.build();
+                }
+            }
+        }
+    }
+
+    // the rules overlapping j whose src is a less specific of the one of j,
+    // or the same src and an earlier rule, so every pair comes up once.
+    // Correlated pairs go to correlated(earlier, later).
+    template <typename F>
+    void pairs_of(uint32_t j, scratch& s, F&& correlated) const {
+        const acl_rule& rj = rules[j];
+        const acl_box& bj = boxes[j];
+        for (auto [src, gi] : src_index.covering(rj.src)) {
+            const group& g = *groups[gi - 1];
+            bool same_src = src.len == rj.src.len;
+            auto check = [&](uint32_t k) {
+                uint32_t i = g.ids[k];
+                if (!g.boxes[k].overlaps(bj) || i == j || (same_src && i > j)) {
+                    return;
+                }
+                uint32_t a = std::min(i, j), b = std::max(i, j);
+                s.first_later[a] = std::min(s.first_later[a], b);
+                if (boxes[a].contains(boxes[b])) {
+                    s.shadowed_by[b] = std::min(s.shadowed_by[b], a);
+                } else if (!boxes[b].contains(boxes[a])) {
+                    correlated(a, b);
+                }
+            };
+            // the slice of the dst of j itself, skipped by the scan below.
+            const slice* same_dst = nullptr;
+            for (auto [dst, sl] : g.dst_index.covering(rj.dst)) {
+                const slice& l = g.slices[sl - 1];
+                l.overlapping(bj, check);
+                if (dst.len == rj.dst.len) {
+                    same_dst = &l;
+                }
+            }
+            auto k = std::lower_bound(g.boxes.begin(), g.boxes.end(), bj.lo[1], [](const acl_box& b, uint32_t v) {
+                         return b.lo[1] < v;
+                     }) - g.boxes.begin();
+            for (; k < ptrdiff_t(g.boxes.size()) && g.boxes[k].lo[1] <= bj.hi[1]; k++) {
+                if (same_dst && k == same_dst->begin) {
+                    k = same_dst->end - 1;
+                } else if (g.boxes[k].hi[1] <= bj.hi[1]) {
+                    check(k);
+                }
+            }
+        }
+    }
+
+    std::vector<acl_rule> rules;
+    std::vector<acl_box> boxes;
+    // src prefix to group id + 1.
+    trie<uint32_t> src_index;
+    std::vector<std::unique_ptr<group>> groups;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "acl_analyzer.hh"
+#include "test_util.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+std::vector<acl_rule> make_rules(size_t n, uint32_t seed) {
+    return nested_rules(n, seed, 0x03030303, 8, 100);
+}
+
+// every pair compared.
+acl_report brute_force(const std::vector<acl_rule>& rules) {
+    std::vector<acl_box> boxes(rules.begin(), rules.end());
+    acl_report r;
+    r.rules = rules.size();
+    for (uint32_t b = 0; b < boxes.size(); b++) {
+        uint32_t shadow = 0;
+        while (shadow < b && !boxes[shadow].contains(boxes[b])) {
+            shadow++;
+        }
+        if (shadow < b) {
+            r.shadowed.push_back({b, shadow});
+            continue;
+        }
+        for (uint32_t k = b + 1; k < boxes.size(); k++) {
+            if (boxes[k].overlaps(boxes[b])) {
+                if (boxes[k].contains(boxes[b]) && !(boxes[k] == boxes[b])) {
+                    r.redundant.push_back({b, k});
+                }
+                break;
+            }
+        }
+    }
+    for (uint32_t a = 0; a < boxes.size(); a++) {
+        for (uint32_t b = a + 1; b < boxes.size(); b++) {
+            if (boxes[a].overlaps(boxes[b]) && !boxes[a].contains(boxes[b]) && !boxes[b].contains(boxes[a])) {
+                r.correlated.emplace_back(a, b);
+            }
+        }
+    }
+    r.correlated_count = r.correlated.size();
+    return r;
+}
+
+}
+
+TEST(AclAnalyzer, Test1) {
+    std::vector<acl_rule> rules = {
+        {"10.0.0.0/8", "0.0.0.0/0", "0-65535", "80-80", "6-6"},
+        {"10.1.0.0/16", "192.168.0.0/16", "0-65535", "80-80", "6-6"},
+        {"10.1.0.0/16", "0.0.0.0/0", "0-65535", "0-65535", "6-6"},
+        {"0.0.0.0/0", "192.168.1.0/24", "1024-65535", "0-1023", "0-255"},
+        {"0.0.0.0/0", "0.0.0.0/0", "0-65535", "0-65535", "0-255"},
+    };
+    acl_analyzer a(rules);
+    auto r = a.analyze(1);
+    EXPECT_THAT(r.shadowed, testing::ElementsAre(acl_report::finding{1, 0}));
+    EXPECT_THAT(r.redundant, testing::ElementsAre(acl_report::finding{3, 4}));
+    using p = std::pair<uint32_t, uint32_t>;
+    EXPECT_THAT(r.correlated, testing::ElementsAre(p{0, 2}, p{0, 3}, p{1, 3}, p{2, 3}));
+    EXPECT_EQ(r.correlated_count, 4);
+    EXPECT_EQ(r.json(), "{\"rules\":5,\"shadowed\":[{\"rule\":1,\"by\":0}],\"redundant\":[{\"rule\":3,\"by\":4}],"
+                        "\"correlated_count\":4,\"correlated\":[[0,2],[0,3],[1,3],[2,3]]}");
+}
+
+TEST(AclAnalyzer, Empty) {
+    acl_analyzer a({});
+    EXPECT_EQ(a.analyze().json(), "{\"rules\":0,\"shadowed\":[],\"redundant\":[],\"correlated_count\":0,\"correlated\":[]}");
+    EXPECT_THROW(a.analyze(0), std::invalid_argument);
+}
+
+TEST(AclAnalyzer, SameAsBruteForce) {
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+        auto rules = make_rules(1500, seed);
+        auto expected = brute_force(rules);
+        acl_analyzer a(rules);
+        for (size_t threads : {1, 4}) {
+            auto r = a.analyze(threads);
+            EXPECT_EQ(r.shadowed, expected.shadowed) << seed << " " << threads;
+            EXPECT_EQ(r.redundant, expected.redundant) << seed << " " << threads;
+            EXPECT_EQ(r.correlated, expected.correlated) << seed << " " << threads;
+            EXPECT_EQ(r.correlated_count, expected.correlated_count) << seed << " " << threads;
+        }
+        EXPECT_GT(expected.shadowed.size(), 0);
+        EXPECT_GT(expected.redundant.size(), 0);
+    }
+}
+
+TEST(AclAnalyzer, MaxCorrelated) {
+    auto rules = make_rules(3000, 7);
+    acl_analyzer a(rules);
+    auto full = a.analyze(1);
+    ASSERT_GT(full.correlated_count, 100);
+    auto one = a.analyze(1, 100);
+    auto four = a.analyze(4, 100);
+    EXPECT_EQ(one.correlated.size(), 100);
+    EXPECT_EQ(one.correlated_count, full.correlated_count);
+    EXPECT_EQ(one.correlated, four.correlated);
+}
+
+TEST(AclAnalyzer, LongSlices) {
+    // a few address pairs, so the slices are long and searched through their
+    // range indexes, with rules set apart by one range or another.
+    std::mt19937 rng(21);
+    std::vector<acl_rule> rules;
+    const char* addrs[] = {"0.0.0.0/0", "10.0.0.0/8", "10.1.0.0/16"};
+    for (int i = 0; i < 1500; i++) {
+        auto range = [&](uint16_t max) {
+            uint16_t lo = rng() % max, hi = std::min<uint32_t>(max, lo + rng() % (max / 8));
+            return rng() % 8 ? acl_rule::port_range(lo, hi) : acl_rule::port_range(0, max);
+        };
+        auto sp = range(65535);
+        auto dp = i % 3 ? acl_rule::port_range(80, 80) : range(65535);
+        auto proto = range(255);
+        rules.emplace_back(ipv4_prefix(addrs[rng() % 3]), ipv4_prefix(addrs[rng() % 3]), sp, dp,
+                           acl_rule::proto_range(proto.low, proto.high));
+    }
+    auto expected = brute_force(rules);
+    acl_analyzer a(rules);
+    for (size_t threads : {1, 4}) {
+        auto r = a.analyze(threads);
+        EXPECT_EQ(r.shadowed, expected.shadowed) << threads;
+        EXPECT_EQ(r.redundant, expected.redundant) << threads;
+        EXPECT_EQ(r.correlated, expected.correlated) << threads;
+    }
+    EXPECT_GT(expected.correlated.size(), 0);
+}
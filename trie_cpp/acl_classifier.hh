@@ -0,0 +1,45 @@
+#ifndef ACL_CLASSIFIER_HH
+#define ACL_CLASSIFIER_HH
+
+#include "hypercuts.hh"
+#include "linear_scan.hh"
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Picks the classifier for a rule set by its size: a linear_scan below
+// threshold rules, where a scan of a few cache lines beats any tree, and
+// hypercuts above it. The default threshold comes from BM_classify in
+// classifier_bench, where the scan stays ahead of hypercuts up to about 512
+// rules; half of that leaves room for packets that match late or not at all.
+class acl_classifier {
+public:
+    static constexpr size_t default_threshold = 256;
+
+    explicit acl_classifier(const std::vector<acl_rule>& rules, size_t threshold = default_threshold) {
+        if (rules.size() < threshold) {
+            scan = std::make_unique<linear_scan>(rules);
+        } else {
+            tree = std::make_unique<hypercuts>(rules);
+        }
+    }
+
+    // id of the highest priority rule matching t.
+    std::optional<uint32_t> classify(const five_tuple& t) const {
+        return scan ? scan->classify(t) : tree->classify(t);
+    }
+
+    bool linear() const {
+        return scan != nullptr;
+    }
+
+    size_t memory_usage() const {
+        return scan ? scan->memory_usage() : tree->memory_usage();
+    }
+
+private:
+    std::unique_ptr<linear_scan> scan;
+    std::unique_ptr<hypercuts> tree;
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef AGGREGATE_HH
+#define AGGREGATE_HH
+
+#include "trie.hh"
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// Route aggregation (Optimal Routing Table Constructor, Draves et al.): keeps
+// a RIB of prefix -> value and a FIB trie<T> that forwards every address to
+// the same value as the RIB longest match, with the fewest prefixes possible.
+//
+// ORTC sees the RIB as a binary tree where every node with a single child
+// gets the missing one as a leaf, each leaf carrying the value it inherits.
+// Pass 2, bottom up, gives every node the set of values worth forwarding at
+// it: a leaf its own value, an inner node the intersection of the sets of its
+// children, or their union when they have nothing in common. Pass 3, top
+// down, lets a node inherit the value forwarded above it if that value is in
+// its set, and adds a FIB prefix with one of its set otherwise.
+//
+// Addresses no RIB prefix covers must stay unmatched, and trie<T> cannot hold
+// a prefix forwarding to nothing, so a subtree with such a hole gets the set
+// {init_value<T>()} and is never covered from above.
+//
+// insert() updates the FIB incrementally: pass 2 reruns on the subtree of the
+// changed prefix and up its path until a set stays the same, pass 3 from
+// there along the path, on the subtree of the prefix, and below the nodes
+// whose forwarded value changed.
+template <typename T, typename P>
+class trie_aggregator {
+public:
+    static constexpr unsigned width = sizeof(P) * 8;
+
+    trie_aggregator() : root{std::make_unique<node>()} {
+        compute_sets(root.get(), init_value<T>());
+    }
+
+    explicit trie_aggregator(const trie<T>& rib) : root{std::make_unique<node>()} {
+        mirror(&rib.root, root.get());
+        compute_sets(root.get(), init_value<T>());
+        choose(root.get(), prefix<P>(0, 0), init_value<T>(), init_value<T>(), prefix<P>(0, 0), true);
+    }
+
+    trie_aggregator(const trie_aggregator&) = delete;
+    trie_aggregator& operator=(const trie_aggregator&) = delete;
+
+    // the aggregated table of rib into out, replacing its contents.
+    static void aggregate(const trie<T>& rib, trie<T>& out) {
+        trie_aggregator a(rib);
+        out.root.left = std::move(a.out.root.left);
+        out.root.right = std::move(a.out.root.right);
+        out.root.set(a.out.root.value);
+    }
+
+    // sets the RIB value of p, init_value<T>() removes p.
+    void insert(prefix<P> p, T value) {
+        // path[d] is the node of p truncated to d bits, inherited[d] the RIB
+        // value above it.
+        node* path[width + 1];
+        T inherited[width + 1];
+        path[0] = root.get();
+        inherited[0] = init_value<T>();
+        for (unsigned d = 0; d < p.len; d++) {
+            node* n = path[d];
+            inherited[d + 1] = has_info(n->value) ? n->value : inherited[d];
+            unsigned s = bit(p.v, d);
+            if (!n->child[s]) {
+                // the new child takes over the FIB prefix of the leaf it
+                // replaces.
+                n->child[s] = std::make_unique<node>();
+                n->child[s]->entry = n->leaf_entry[s];
+                n->child[s]->eff = n->leaf_entry[s] ? inherited[d + 1] : n->eff;
+                n->leaf_entry[s] = false;
+            }
+            path[d + 1] = n->child[s].get();
+        }
+        if (has_info(path[p.len]->value)) {
+            rib_count--;
+        }
+        path[p.len]->value = value;
+        if (has_info(value)) {
+            rib_count++;
+        }
+
+        // pass 2: the whole subtree of p sees another inherited value, its
+        // ancestors only another child set. Nodes left empty are pruned, the
+        // FIB entry of one becoming the one of the leaf replacing it.
+        unsigned deepest = p.len;
+        while (deepest > 0 && !has_info(path[deepest]->value) && is_leaf(path[deepest])) {
+            node* n = path[deepest - 1];
+            unsigned s = bit(p.v, deepest - 1);
+            n->leaf_entry[s] = n->child[s]->entry;
+            n->child[s].reset();
+            if (is_leaf(n)) {
+                // no leaves of its own now, n forwards its whole prefix.
+                for (unsigned k = 0; k < 2; k++) {
+                    set_entry(n->leaf_entry[k], child_prefix(truncate(p, deepest - 1), k), init_value<T>());
+                }
+            }
+            deepest--;
+        }
+        unsigned top = deepest;
+        if (deepest == p.len) {
+            compute_sets(path[p.len], inherited[p.len]);
+        } else {
+            merge(path[deepest], own_value(path[deepest], inherited[deepest]));
+        }
+        while (top > 0) {
+            node* n = path[top - 1];
+            auto old = n->set;
+            merge(n, own_value(n, inherited[top - 1]));
+            top--;
+            if (n->set == old) {
+                break;
+            }
+        }
+
+        // pass 3 from the highest node whose set may have changed, all of the
+        // subtree of p when it is still there.
+        T above = top ? path[top - 1]->eff : init_value<T>();
+        choose(path[top], truncate(p, top), above, inherited[top], truncate(p, deepest), deepest == p.len);
+    }
+
+    // the aggregated table, lookups on it match the ones on the RIB.
+    const trie<T>& fib() const {
+        return out;
+    }
+
+    std::optional<T> lookup(P key) const {
+        return out.lookup(key);
+    }
+
+    // prefixes with a value in the RIB and in the FIB.
+    size_t rib_size() const {
+        return rib_count;
+    }
+
+    size_t size() const {
+        return fib_count;
+    }
+
+private:
+    struct node {
+        std::unique_ptr<node> child[2];
+        T value = init_value<T>();
+        // pass 2 result, sorted.
+        std::vector<T> set;
+        // value the FIB forwards at this prefix.
+        T eff = init_value<T>();
+        // whether the FIB has a prefix here, and at the leaf standing for a
+        // missing child.
+        bool entry = false;
+        bool leaf_entry[2] = {false, false};
+    };
+
+    static bool has_info(const T& v) {
+        return v != init_value<T>();
+    }
+
+    static bool is_leaf(const node* n) {
+        return !n->child[0] && !n->child[1];
+    }
+
+    static bool is_hole(const std::vector<T>& s) {
+        return s.size() == 1 && !has_info(s[0]);
+    }
+
+    static unsigned bit(P v, unsigned d) {
+        return (v >> (width - 1 - d)) & 1;
+    }
+
+    static prefix<P> truncate(prefix<P> p, unsigned len) {
+        return prefix<P>(len ? P(p.v & ~((P(1) << (width - len)) - 1)) : P(0), len);
+    }
+
+    static prefix<P> child_prefix(prefix<P> p, unsigned s) {
+        return prefix<P>(P(p.v | (P(s) << (width - 1 - p.len))), p.len + 1);
+    }
+
+    static T own_value(const node* n, T inherited) {
+        return has_info(n->value) ? n->value : inherited;
+    }
+
+    void mirror(const trie_node_base* from, node* to) {
+        to->value = static_cast<const trie_node<T>*>(from)->value;
+        if (has_info(to->value)) {
+            rib_count++;
+        }
+        const trie_node_base* children[2] = {from->left.get(), from->right.get()};
+        for (unsigned s = 0; s < 2; s++) {
+            if (children[s]) {
+                to->child[s] = std::make_unique<node>();
+                mirror(children[s], to->child[s].get());
+            }
+        }
+    }
+
+    // pass 2 over the subtree of n, inherited being the RIB value above it.
+    void compute_sets(node* n, T inherited) {
+        T v = own_value(n, inherited);
+        for (auto& c : n->child) {
+            if (c) {
+                compute_sets(c.get(), v);
+            }
+        }
+        merge(n, v);
+    }
+
+    // the set of n out of the ones of its children, v being its RIB value.
+    void merge(node* n, T v) {
+        if (is_leaf(n)) {
+            n->set.assign(1, v);
+            return;
+        }
+        const std::vector<T> leaf(1, v);
+        const auto& a = n->child[0] ? n->child[0]->set : leaf;
+        const auto& b = n->child[1] ? n->child[1]->set : leaf;
+        std::vector<T> s;
+        if (is_hole(a) || is_hole(b)) {
+            s.assign(1, init_value<T>());
+        } else {
+            std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(s));
+            if (s.empty()) {
+                std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(s));
+            }
+        }
+        n->set = std::move(s);
+    }
+
+    // pass 3 over n at p, above being the value the FIB forwards above it and
+    // inherited the RIB one. Children are revisited on the way to target,
+    // under a node whose forwarded value changed, and below target if all.
+    void choose(node* n, prefix<P> p, T above, T inherited, prefix<P> target, bool all) {
+        T v = own_value(n, inherited);
+        T eff = above;
+        if (!std::binary_search(n->set.begin(), n->set.end(), above)) {
+            // the RIB value when it will do, fewer FIB changes on updates.
+            eff = std::binary_search(n->set.begin(), n->set.end(), v) ? v : n->set.front();
+        }
+        bool changed = eff != n->eff;
+        if (changed || n->entry != (eff != above)) {
+            set_entry(n->entry, p, eff == above ? init_value<T>() : eff);
+        }
+        n->eff = eff;
+
+        if (is_leaf(n)) {
+            return;
+        }
+        bool full = all && p.len >= target.len;
+        for (unsigned s = 0; s < 2; s++) {
+            if (n->child[s]) {
+                bool on_path = target.len > p.len && bit(target.v, p.len) == s;
+                if (full || on_path || changed) {
+                    choose(n->child[s].get(), child_prefix(p, s), eff, v, target, all);
+                }
+            } else {
+                set_entry(n->leaf_entry[s], child_prefix(p, s), v == eff ? init_value<T>() : v);
+            }
+        }
+    }
+
+    // adds, updates or, for init_value<T>(), removes the FIB prefix p.
+    void set_entry(bool& entry, prefix<P> p, T value) {
+        if (has_info(value)) {
+            fib_count += !entry;
+            entry = true;
+            out.insert(p, value);
+        } else if (entry) {
+            fib_count--;
+            entry = false;
+            out.erase(p);
+        }
+    }
+
+    std::unique_ptr<node> root;
+    trie<T> out;
+    size_t rib_count = 0;
+    size_t fib_count = 0;
+};
+
+#endif
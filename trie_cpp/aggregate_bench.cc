@@ -0,0 +1,96 @@
+#include "aggregate.hh"
+#include "bench_util.hh"
+#include <benchmark/benchmark.h>
+#include <iterator>
+#include <map>
+
+namespace {
+
+// the BGP-like table with next hops mostly following the /8, as when a few
+// upstreams announce whole blocks, and random for one prefix in five.
+const std::vector<std::pair<prefix<uint32_t>, uint32_t>>& routes(size_t next_hops) {
+    static std::map<size_t, std::vector<std::pair<prefix<uint32_t>, uint32_t>>> sets;
+    auto [it, inserted] = sets.try_emplace(next_hops);
+    if (inserted) {
+        std::mt19937 rng(7);
+        for (const auto& p : random_prefixes(table_size)) {
+            uint32_t hop = rng() % 5 ? (p.v >> 24) * 2654435761u >> 7 : rng();
+            it->second.emplace_back(p, 1 + hop % next_hops);
+        }
+    }
+    return it->second;
+}
+
+const trie<uint32_t>& rib(size_t next_hops) {
+    static std::map<size_t, std::unique_ptr<trie<uint32_t>>> tries;
+    auto& t = tries[next_hops];
+    if (!t) {
+        t = std::make_unique<trie<uint32_t>>();
+        for (const auto& [p, v] : routes(next_hops)) {
+            t->insert(p, v);
+        }
+    }
+    return *t;
+}
+
+const trie<uint32_t>& fib(size_t next_hops) {
+    static std::map<size_t, std::unique_ptr<trie<uint32_t>>> tries;
+    auto& t = tries[next_hops];
+    if (!t) {
+        t = std::make_unique<trie<uint32_t>>();
+        rib(next_hops).aggregate<uint32_t>(*t);
+    }
+    return *t;
+}
+
+void BM_trie_aggregate(benchmark::State& state) {
+    const auto& r = rib(state.range(0));
+    for (auto _ : state) {
+        trie<uint32_t> f;
+        r.aggregate<uint32_t>(f);
+        benchmark::DoNotOptimize(&f);
+    }
+    const auto& f = fib(state.range(0));
+    auto count = [](const trie<uint32_t>& t) {
+        return std::ranges::distance(t.entries<uint32_t>());
+    };
+    state.counters["prefixes_before"] = count(r);
+    state.counters["prefixes_after"] = count(f);
+    state.counters["bytes_before"] = r.node_count() * sizeof(trie_node<uint32_t>);
+    state.counters["bytes_after"] = f.node_count() * sizeof(trie_node<uint32_t>);
+}
+
+// one route withdrawn and announced again with another next hop, two
+// updates per iteration.
+void BM_aggregator_update(benchmark::State& state) {
+    const auto& table = routes(state.range(0));
+    trie_aggregator<uint32_t, uint32_t> a(rib(state.range(0)));
+    std::mt19937 rng(5);
+    for (auto _ : state) {
+        const auto& [p, v] = table[rng() % table.size()];
+        a.insert(p, 0);
+        a.insert(p, 1 + rng() % state.range(0));
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    state.counters["per_update"] = benchmark::Counter(
+        2, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.counters["prefixes_after"] = a.size();
+    state.counters["bytes_after"] = a.fib().node_count() * sizeof(trie_node<uint32_t>);
+}
+
+// lookups on the table as given and aggregated.
+void BM_aggregated_lookup(benchmark::State& state) {
+    const auto& t = state.range(1) ? fib(state.range(0)) : rib(state.range(0));
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(t.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_trie_aggregate)->ArgName("next_hops")->Arg(4)->Arg(16)->Arg(64)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_aggregator_update)->ArgName("next_hops")->Arg(4)->Arg(16)->Arg(64);
+BENCHMARK(BM_aggregated_lookup)->ArgNames({"next_hops", "aggregated"})->ArgsProduct({{4, 16, 64}, {0, 1}});
@@ -0,0 +1,141 @@
+#include "aggregate.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+template <typename T, typename P>
+std::vector<std::pair<prefix<P>, T>> entries(const trie<T>& t) {
+    auto e = t.template entries<P>();
+    return {e.begin(), e.end()};
+}
+
+// every 8-bit address forwarded the same way.
+void expect_same_lookups(const trie<uint32_t>& a, const trie<uint32_t>& b) {
+    for (unsigned k = 0; k < 256; k++) {
+        EXPECT_EQ(a.lookup(uint8_t(k)), b.lookup(uint8_t(k))) << k;
+    }
+}
+
+prefix<uint8_t> random_prefix(std::mt19937& rng) {
+    uint8_t len = rng() % 9;
+    return prefix<uint8_t>(len ? uint8_t(rng() & ~((1u << (8 - len)) - 1)) : 0, len);
+}
+
+}
+
+TEST(Aggregate, Test1) {
+    trie<uint32_t> rib;
+    // siblings with the same value merge, a more specific repeating its
+    // covering value goes.
+    rib.insert(ipv4_prefix("10.0.0.0/9"), 1);
+    rib.insert(ipv4_prefix("10.128.0.0/9"), 1);
+    rib.insert(ipv4_prefix("10.1.0.0/16"), 1);
+    rib.insert(ipv4_prefix("10.2.0.0/16"), 2);
+    // no route for 192.168.128.0/17, the /17 cannot be covered by a /16.
+    rib.insert(ipv4_prefix("192.168.0.0/17"), 3);
+
+    trie<uint32_t> fib;
+    rib.aggregate<uint32_t>(fib);
+    using e = std::pair<prefix<uint32_t>, uint32_t>;
+    EXPECT_THAT((entries<uint32_t, uint32_t>(fib)),
+                testing::ElementsAre(e{ipv4_prefix("10.0.0.0/8"), 1}, e{ipv4_prefix("10.2.0.0/16"), 2},
+                                     e{ipv4_prefix("192.168.0.0/17"), 3}));
+}
+
+TEST(Aggregate, Ortc) {
+    // the ORTC paper example: three of four /2s go to 1, one to 2, and a
+    // default to 2. The minimum is a default to 1 and one /2 to 2.
+    trie<uint32_t> rib;
+    rib.insert(prefix<uint8_t>(0x00, 0), 2);
+    rib.insert(prefix<uint8_t>(0x00, 2), 1);
+    rib.insert(prefix<uint8_t>(0x40, 2), 1);
+    rib.insert(prefix<uint8_t>(0x80, 2), 1);
+
+    trie<uint32_t> fib;
+    rib.aggregate<uint8_t>(fib);
+    using e = std::pair<prefix<uint8_t>, uint32_t>;
+    EXPECT_THAT((entries<uint32_t, uint8_t>(fib)), testing::ElementsAre(e{{0x00, 0}, 1}, e{{0xc0, 2}, 2}));
+    expect_same_lookups(rib, fib);
+}
+
+TEST(Aggregate, SameLookups) {
+    std::mt19937 rng(1);
+    for (int round = 0; round < 200; round++) {
+        trie<uint32_t> rib;
+        size_t n = 1 + rng() % 40;
+        for (size_t i = 0; i < n; i++) {
+            rib.insert(random_prefix(rng), 1 + rng() % 3);
+        }
+        trie<uint32_t> fib;
+        rib.aggregate<uint8_t>(fib);
+        expect_same_lookups(rib, fib);
+
+        trie_aggregator<uint32_t, uint8_t> a(rib);
+        auto e = entries<uint32_t, uint8_t>(fib);
+        EXPECT_EQ(a.size(), e.size());
+        EXPECT_LE(a.size(), a.rib_size());
+        // aggregating again finds nothing more.
+        trie<uint32_t> again;
+        fib.aggregate<uint8_t>(again);
+        EXPECT_EQ((entries<uint32_t, uint8_t>(again)), e);
+    }
+}
+
+TEST(Aggregate, Incremental) {
+    std::mt19937 rng(2);
+    for (int round = 0; round < 20; round++) {
+        trie<uint32_t> rib;
+        trie_aggregator<uint32_t, uint8_t> a;
+        std::vector<prefix<uint8_t>> added;
+        for (int op = 0; op < 200; op++) {
+            // withdraws a third of the time, sometimes of a prefix not there.
+            if (rng() % 3 == 0 && !added.empty()) {
+                auto p = rng() % 4 ? added[rng() % added.size()] : random_prefix(rng);
+                rib.insert(p, 0);
+                a.insert(p, 0);
+            } else {
+                auto p = random_prefix(rng);
+                uint32_t v = 1 + rng() % 3;
+                rib.insert(p, v);
+                a.insert(p, v);
+                added.push_back(p);
+            }
+            expect_same_lookups(rib, a.fib());
+            // the same table aggregating from scratch would give.
+            trie<uint32_t> fib;
+            rib.aggregate<uint8_t>(fib);
+            ASSERT_EQ((entries<uint32_t, uint8_t>(a.fib())), (entries<uint32_t, uint8_t>(fib))) << round << " " << op;
+            ASSERT_EQ(a.size(), (entries<uint32_t, uint8_t>(fib)).size());
+            // withdrawn FIB prefixes leave no nodes behind.
+            ASSERT_EQ(a.fib().node_count(), fib.node_count()) << round << " " << op;
+            ASSERT_EQ(a.rib_size(), (entries<uint32_t, uint8_t>(rib)).size());
+        }
+    }
+}
+
+TEST(Aggregate, Ipv4) {
+    std::mt19937 rng(3);
+    trie<uint32_t> rib;
+    std::vector<prefix<uint32_t>> prefixes;
+    for (int i = 0; i < 20000; i++) {
+        uint8_t len = 8 + rng() % 25;
+        uint32_t v = (rng() & 0x0f0fffff) & ~((uint64_t(1) << (32 - len)) - 1);
+        prefixes.emplace_back(v, len);
+        rib.insert(prefixes.back(), 1 + rng() % 4);
+    }
+    trie<uint32_t> fib;
+    rib.aggregate<uint32_t>(fib);
+    trie_aggregator<uint32_t, uint32_t> a(rib);
+    EXPECT_LT(a.size(), a.rib_size() * 3 / 4);
+    // addresses at and around the edges of every prefix.
+    for (const auto& p : prefixes) {
+        uint32_t last = p.v | uint32_t((uint64_t(1) << (32 - p.len)) - 1);
+        for (uint32_t k : {p.v, p.v - 1, last, last + 1, p.v + (last - p.v) / 2}) {
+            ASSERT_EQ(rib.lookup(k), fib.lookup(k)) << k;
+        }
+    }
+}
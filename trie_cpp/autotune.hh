@@ -0,0 +1,330 @@
+#ifndef AUTOTUNE_HH
+#define AUTOTUNE_HH
+
+#include "dir24_8.hh"
+#include "hash_lpm.hh"
+#include "lc_trie.hh"
+#include "tbm.hh"
+#include "trie.hh"
+#include <typelist.hh>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Picks the longest prefix match engine for a table at load time. The
+// candidates are a TypeList of engine types, built at compile time with the
+// metafunctions of typelist.hh; every one of them is built on a sample of
+// the table and timed on lookups, and the fastest one whose memory, projected
+// to the whole table, fits a budget is built on the whole table and handed
+// back behind lpm_engine<T, P>, the same find() and lookup() for all.
+//
+//   lpm_autotuner<uint32_t, uint32_t, ipv4_lpm_configs<uint32_t>> tuner;
+//   auto engine = tuner.tune(table);
+//   engine->lookup(key);
+
+// the type-erased engine.
+template <typename T, typename P>
+class lpm_engine {
+public:
+    virtual ~lpm_engine() = default;
+
+    // the value of p, std::nullopt for a prefix without one.
+    virtual std::optional<T> find(prefix<P> p) const = 0;
+    // longest prefix match of key.
+    virtual std::optional<T> lookup(P key) const = 0;
+    virtual size_t memory_usage() const = 0;
+    virtual std::string name() const = 0;
+};
+
+// the name of an engine configuration in reports.
+template <typename Engine>
+struct lpm_config_name;
+
+template <typename T>
+struct lpm_config_name<trie<T>> {
+    static std::string get() {
+        return "binary";
+    }
+};
+
+template <typename T, unsigned STRIDE>
+struct lpm_config_name<tree_bitmap<T, STRIDE>> {
+    static std::string get() {
+        return fmt::format("stride {}", STRIDE);
+    }
+};
+
+template <typename T>
+struct lpm_config_name<dir24_8<T>> {
+    static std::string get() {
+        return "flat 24/8";
+    }
+};
+
+template <typename T, typename K>
+struct lpm_config_name<lc_trie<T, K>> {
+    static std::string get() {
+        return "lc";
+    }
+};
+
+template <typename T, typename K, bool Bloom>
+struct lpm_config_name<hash_lpm<T, K, Bloom>> {
+    static std::string get() {
+        return Bloom ? "hash per length, bloom" : "hash per length";
+    }
+};
+
+template <typename Engine, typename T, typename P>
+class lpm_engine_of : public lpm_engine<T, P> {
+public:
+    explicit lpm_engine_of(std::span<const std::pair<prefix<P>, T>> table) {
+        for (const auto& [p, value] : table) {
+            e.insert(p, value);
+        }
+    }
+
+    std::optional<T> find(prefix<P> p) const override {
+        auto v = e.find(p);
+        if (v && *v == init_value<T>()) {
+            return std::nullopt;
+        }
+        return v;
+    }
+
+    std::optional<T> lookup(P key) const override {
+        return e.lookup(key);
+    }
+
+    size_t memory_usage() const override {
+        if constexpr (requires { e.memory_usage(); }) {
+            return e.memory_usage();
+        } else {
+            return e.node_count() * sizeof(trie_node<T>);
+        }
+    }
+
+    std::string name() const override {
+        return lpm_config_name<Engine>::get();
+    }
+
+private:
+    Engine e;
+};
+
+template <typename List>
+struct typelist_size;
+
+template <template <class...> class L, typename... Args>
+struct typelist_size<L<Args...>> {
+    static constexpr size_t value = sizeof...(Args);
+};
+
+// the tree bitmaps of strides From to To.
+template <typename T, unsigned From, unsigned To>
+struct tbm_strides {
+    using Type = typename prependA<tree_bitmap<T, From>, typename tbm_strides<T, From + 1, To>::Type>::Type;
+};
+
+template <typename T, unsigned To>
+struct tbm_strides<T, To, To> {
+    using Type = TypeList<tree_bitmap<T, To>>;
+};
+
+// binary trie, strides 4 to 6, hashing per length and the flat table.
+template <typename T>
+using ipv4_lpm_configs = typename appendA<
+    dir24_8<T>,
+    typename appendA<hash_lpm<T, uint32_t>,
+                     typename prependA<trie<T>, typename tbm_strides<T, 4, 6>::Type>::Type>::Type>::Type;
+
+// no flat table for 128-bit keys, the level compressed trie instead.
+template <typename T>
+using ipv6_lpm_configs = typename appendA<
+    hash_lpm<T, uint128_t, true>,
+    typename appendA<hash_lpm<T, uint128_t>,
+                     typename appendA<lc_trie<T, uint128_t>,
+                                      typename prependA<trie<T>, typename tbm_strides<T, 4, 6>::Type>::Type>::Type>::Type>::Type;
+
+// what the autotuner measured of a candidate, memory projected to the
+// whole table.
+struct lpm_candidate {
+    std::string name;
+    double ns_per_lookup;
+    size_t memory;
+    bool fits;
+};
+
+template <typename T, typename P, typename Configs>
+class lpm_autotuner {
+public:
+    static constexpr size_t config_count = typelist_size<Configs>::value;
+
+    struct options {
+        // prefixes the candidates are built on, evenly spread over the table.
+        size_t sample_size = 1 << 16;
+        // lookups a measurement times, the best of rounds counts.
+        size_t probes = 1 << 16;
+        size_t rounds = 4;
+        // bytes the engine may take for the whole table. If no candidate
+        // fits, the smallest one wins.
+        size_t memory_budget = std::numeric_limits<size_t>::max();
+        uint32_t seed = 1;
+    };
+
+    lpm_autotuner() = default;
+    explicit lpm_autotuner(options o) : opts{o} {}
+
+    // measures every candidate and builds the winner on the whole table.
+    std::unique_ptr<lpm_engine<T, P>> tune(std::span<const std::pair<prefix<P>, T>> table) {
+        size_t s = std::min(table.size(), opts.sample_size);
+        std::vector<std::pair<prefix<P>, T>> sample;
+        for (size_t i = 0; i < s; i++) {
+            sample.push_back(table[i * table.size() / s]);
+        }
+        auto keys = probe_keys(sample);
+        std::span<const std::pair<prefix<P>, T>> half(sample.data(), s / 2);
+
+        std::vector<std::unique_ptr<lpm_engine<T, P>>> engines;
+        report.assign(config_count, {});
+        for_each_config<Configs>([&]<typename E>() {
+            auto& c = report[engines.size()];
+            // fixed size plus a cost per prefix, out of the sample and its
+            // first half.
+            size_t small = s == table.size() ? 0 : lpm_engine_of<E, T, P>(half).memory_usage();
+            engines.push_back(std::make_unique<lpm_engine_of<E, T, P>>(sample));
+            size_t full = engines.back()->memory_usage();
+            c.name = engines.back()->name();
+            c.memory = s == table.size() ? full : project(small, full, half.size(), s, table.size());
+            c.ns_per_lookup = std::numeric_limits<double>::infinity();
+        });
+
+        // every round times the candidates in list order, then reversed, so
+        // none of them always runs right after the same one.
+        for (size_t round = 0; round < opts.rounds; round++) {
+            auto measure = [&](size_t i) {
+                report[i].ns_per_lookup = std::min(report[i].ns_per_lookup, time(*engines[i], keys));
+            };
+            if (round % 2 == 0) {
+                for_each_config<Configs>(indexed(measure));
+            } else {
+                for_each_config<typename reverse<Configs>::Type>(indexed_reversed(measure));
+            }
+        }
+
+        best = 0;
+        bool any_fits = false;
+        for (size_t i = 0; i < config_count; i++) {
+            report[i].fits = report[i].memory <= opts.memory_budget;
+            any_fits |= report[i].fits;
+        }
+        for (size_t i = 1; i < config_count; i++) {
+            const auto& c = report[i];
+            const auto& b = report[best];
+            if (any_fits ? c.fits && (!b.fits || c.ns_per_lookup < b.ns_per_lookup) : c.memory < b.memory) {
+                best = i;
+            }
+        }
+
+        std::unique_ptr<lpm_engine<T, P>> winner;
+        size_t i = 0;
+        for_each_config<Configs>([&]<typename E>() {
+            if (i++ == best) {
+                winner = std::make_unique<lpm_engine_of<E, T, P>>(table);
+            }
+        });
+        return winner;
+    }
+
+    // the measurements of the last tune(), in the order of Configs.
+    const std::vector<lpm_candidate>& candidates() const {
+        return report;
+    }
+
+    // index in Configs of the last winner.
+    size_t winner() const {
+        return best;
+    }
+
+private:
+    template <typename List, typename F, size_t... I>
+    static void for_each_config(F&& f, std::index_sequence<I...>) {
+        (f.template operator()<typename atN<I, List>::Type>(), ...);
+    }
+
+    template <typename List, typename F>
+    static void for_each_config(F&& f) {
+        for_each_config<List>(f, std::make_index_sequence<typelist_size<List>::value>());
+    }
+
+    // f called with the index of every config in list order.
+    template <typename F>
+    static auto indexed(F& f) {
+        return [&f, i = size_t(0)]<typename E>() mutable {
+            f(i++);
+        };
+    }
+
+    template <typename F>
+    static auto indexed_reversed(F& f) {
+        return [&f, i = config_count]<typename E>() mutable {
+            f(--i);
+        };
+    }
+
+    static size_t project(size_t small, size_t full, size_t small_n, size_t full_n, size_t n) {
+        if (full <= small || full_n <= small_n) {
+            return full;
+        }
+        double per_prefix = double(full - small) / double(full_n - small_n);
+        return full + size_t(per_prefix * double(n - full_n));
+    }
+
+    // half inside sampled prefixes, half anywhere.
+    std::vector<P> probe_keys(const std::vector<std::pair<prefix<P>, T>>& sample) const {
+        std::mt19937_64 rng(opts.seed);
+        auto random_key = [&] {
+            if constexpr (sizeof(P) > sizeof(uint64_t)) {
+                return P(P(rng()) << 64 | rng());
+            } else {
+                return P(rng());
+            }
+        };
+        std::vector<P> keys(opts.probes);
+        for (size_t i = 0; i < keys.size(); i++) {
+            keys[i] = random_key();
+            if (i % 2 && !sample.empty()) {
+                const auto& p = sample[rng() % sample.size()].first;
+                P host = p.len < sizeof(P) * 8 ? P(keys[i] >> p.len) : P(0);
+                keys[i] = p.v | host;
+            }
+        }
+        return keys;
+    }
+
+    static double time(const lpm_engine<T, P>& e, const std::vector<P>& keys) {
+        auto start = std::chrono::steady_clock::now();
+        size_t found = 0;
+        for (P k : keys) {
+            found += e.lookup(k).has_value();
+        }
+        std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - start;
+        // keeps the loop from being optimized out.
+        asm volatile("" : : "r"(found));
+        return keys.empty() ? 0 : d.count() / keys.size();
+    }
+
+    options opts;
+    std::vector<lpm_candidate> report;
+    size_t best = 0;
+};
+
+#endif
@@ -0,0 +1,51 @@
+#include "autotune.hh"
+#include "bench_util.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// one tune() of the BGP-like table, the winner as the label and what every
+// candidate measured as counters.
+void BM_autotune(benchmark::State& state) {
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+    uint32_t value = 1;
+    for (const auto& p : random_prefixes(table_size)) {
+        table.emplace_back(p, value++);
+    }
+    lpm_autotuner<uint32_t, uint32_t, ipv4_lpm_configs<uint32_t>> tuner;
+    for (auto _ : state) {
+        auto e = tuner.tune(table);
+        benchmark::DoNotOptimize(e.get());
+    }
+    const auto& c = tuner.candidates();
+    state.SetLabel(c[tuner.winner()].name);
+    for (const auto& x : c) {
+        state.counters[x.name + " ns"] = x.ns_per_lookup;
+        state.counters[x.name + " MB"] = double(x.memory) / (1 << 20);
+    }
+}
+
+// lookups through lpm_engine, against the same engine called directly in
+// the other benchmarks.
+void BM_autotuned_lookup(benchmark::State& state) {
+    static auto engine = [] {
+        std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            table.emplace_back(p, value++);
+        }
+        return lpm_autotuner<uint32_t, uint32_t, ipv4_lpm_configs<uint32_t>>().tune(table);
+    }();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(engine->lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(engine->name());
+}
+
+}
+
+BENCHMARK(BM_autotune)->Unit(benchmark::kMillisecond)->Iterations(1);
+BENCHMARK(BM_autotuned_lookup);
@@ -0,0 +1,123 @@
+#include "autotune.hh"
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+using v4 = ipv4_lpm_configs<uint32_t>;
+static_assert(typelist_size<v4>::value == 6);
+static_assert(std::is_same_v<atN<0, v4>::Type, trie<uint32_t>>);
+static_assert(std::is_same_v<atN<2, v4>::Type, tree_bitmap<uint32_t, 5>>);
+static_assert(std::is_same_v<atN<5, v4>::Type, dir24_8<uint32_t>>);
+static_assert(std::is_same_v<atN<0, reverse<v4>::Type>::Type, dir24_8<uint32_t>>);
+static_assert(typelist_size<ipv6_lpm_configs<uint32_t>>::value == 7);
+
+template <typename P>
+std::vector<std::pair<prefix<P>, uint32_t>> random_table(size_t n, unsigned min_len, unsigned seed) {
+    constexpr unsigned width = sizeof(P) * 8;
+    std::mt19937_64 rng(seed);
+    std::vector<std::pair<prefix<P>, uint32_t>> table;
+    for (uint32_t i = 1; i <= n; i++) {
+        uint8_t len = min_len + rng() % (width / 2 + 1 - min_len);
+        P v = P(uint128_t(rng()) << 64 | rng());
+        v = len ? P(v & ~((P(1) << (width - len)) - 1)) : P(0);
+        table.emplace_back(prefix<P>(v, len), i);
+    }
+    return table;
+}
+
+template <typename P>
+void expect_same_as_trie(const lpm_engine<uint32_t, P>& e, const std::vector<std::pair<prefix<P>, uint32_t>>& table) {
+    trie<uint32_t> t;
+    for (const auto& [p, value] : table) {
+        t.insert(p, value);
+    }
+    std::mt19937_64 rng(9);
+    for (const auto& [p, value] : table) {
+        ASSERT_EQ(e.find(p), t.find(p)) << p.show();
+        P k = P(p.v | P(uint128_t(rng()) << 64 | rng()) >> p.len);
+        ASSERT_EQ(e.lookup(k), t.lookup(k)) << e.name();
+    }
+}
+
+}
+
+TEST(Autotune, Ipv4) {
+    auto table = random_table<uint32_t>(20000, 8, 1);
+    lpm_autotuner<uint32_t, uint32_t, v4>::options o;
+    o.sample_size = 4000;
+    o.probes = 4096;
+    lpm_autotuner<uint32_t, uint32_t, v4> tuner(o);
+    auto e = tuner.tune(table);
+    ASSERT_TRUE(e);
+    const auto& c = tuner.candidates();
+    std::vector<std::string> names;
+    for (const auto& x : c) {
+        names.push_back(x.name);
+        EXPECT_GT(x.ns_per_lookup, 0) << x.name;
+        EXPECT_GT(x.memory, 0) << x.name;
+        EXPECT_TRUE(x.fits);
+    }
+    EXPECT_THAT(names, testing::ElementsAre("binary", "stride 4", "stride 5", "stride 6", "hash per length", "flat 24/8"));
+    EXPECT_EQ(e->name(), c[tuner.winner()].name);
+    for (const auto& x : c) {
+        EXPECT_LE(c[tuner.winner()].ns_per_lookup, x.ns_per_lookup);
+    }
+    expect_same_as_trie(*e, table);
+}
+
+TEST(Autotune, MemoryBudget) {
+    auto table = random_table<uint32_t>(20000, 8, 2);
+    lpm_autotuner<uint32_t, uint32_t, v4>::options o;
+    o.sample_size = 4000;
+    o.probes = 1024;
+    // the flat table alone takes 64M.
+    o.memory_budget = 32 << 20;
+    lpm_autotuner<uint32_t, uint32_t, v4> tuner(o);
+    auto e = tuner.tune(table);
+    EXPECT_NE(e->name(), "flat 24/8");
+    EXPECT_FALSE(tuner.candidates().back().fits);
+    EXPECT_LE(e->memory_usage(), o.memory_budget);
+
+    // none fits, the smallest wins.
+    o.memory_budget = 0;
+    lpm_autotuner<uint32_t, uint32_t, v4> none(o);
+    e = none.tune(table);
+    const auto& c = none.candidates();
+    for (const auto& x : c) {
+        EXPECT_LE(c[none.winner()].memory, x.memory);
+    }
+    expect_same_as_trie(*e, table);
+
+    // the memory projected out of the sample is about the one of the
+    // engine on the whole table.
+    double projected = c[none.winner()].memory;
+    EXPECT_NEAR(e->memory_usage() / projected, 1.0, 0.25);
+}
+
+TEST(Autotune, Ipv6) {
+    auto table = random_table<uint128_t>(5000, 16, 3);
+    using v6 = ipv6_lpm_configs<uint32_t>;
+    lpm_autotuner<uint32_t, uint128_t, v6>::options o;
+    o.sample_size = 1000;
+    o.probes = 1024;
+    lpm_autotuner<uint32_t, uint128_t, v6> tuner(o);
+    auto e = tuner.tune(table);
+    EXPECT_EQ(tuner.candidates().size(), 7);
+    expect_same_as_trie(*e, table);
+}
+
+TEST(Autotune, Small) {
+    // smaller than the sample, and empty.
+    auto table = random_table<uint32_t>(100, 0, 4);
+    lpm_autotuner<uint32_t, uint32_t, v4>::options o;
+    o.probes = 256;
+    lpm_autotuner<uint32_t, uint32_t, v4> tuner(o);
+    expect_same_as_trie(*tuner.tune(table), table);
+    auto e = tuner.tune({});
+    EXPECT_EQ(e->lookup(1234), std::nullopt);
+}
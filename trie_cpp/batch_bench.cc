@@ -0,0 +1,41 @@
+#include "bench_util.hh"
+#include "tbm.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// items_per_second against the batch size, batch 1 is the one-at-a-time cost.
+template <typename Table>
+void BM_lookup_batch(benchmark::State& state) {
+    const Table& table = build_table<Table>();
+    auto keys = random_keys(key_count);
+    size_t batch = state.range(0);
+    std::vector<std::optional<uint32_t>> values(batch);
+    size_t i = 0;
+    for (auto _ : state) {
+        table.template lookup_batch<uint32_t>(std::span(keys).subspan(i, batch), values);
+        benchmark::DoNotOptimize(values.data());
+        i = (i + batch) & (key_count - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+void BM_find_batch(benchmark::State& state) {
+    const auto& table = build_table<trie<uint32_t>>();
+    auto prefixes = random_prefixes(key_count);
+    size_t batch = state.range(0);
+    std::vector<std::optional<uint32_t>> values(batch);
+    size_t i = 0;
+    for (auto _ : state) {
+        table.find_batch<uint32_t>(std::span(prefixes).subspan(i, batch), values);
+        benchmark::DoNotOptimize(values.data());
+        i = (i + batch) & (key_count - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+
+}
+
+BENCHMARK_TEMPLATE(BM_lookup_batch, trie<uint32_t>)->RangeMultiplier(2)->Range(1, 256);
+BENCHMARK_TEMPLATE(BM_lookup_batch, tree_bitmap<uint32_t, 5>)->RangeMultiplier(2)->Range(1, 256);
+BENCHMARK(BM_find_batch)->RangeMultiplier(2)->Range(1, 256);
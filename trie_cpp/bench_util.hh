@@ -0,0 +1,186 @@
+#ifndef BENCH_UTIL_HH
+#define BENCH_UTIL_HH
+
+#include "trie.hh"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Prefix tables shared by the benchmarks. Lengths follow the rough shape of a
+// BGP table: most prefixes are /24, then /22-/23, /16-/21, and a few short ones.
+inline std::vector<prefix<uint32_t>> random_prefixes(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    std::discrete_distribution<int> lens({
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 3, 4, 4,     // 0 - 15
+        10, 5, 7, 12, 20, 25, 60, 60, 500, 2, 2, 2, 2, 2, 2, 2, 2 // 16 - 32
+    });
+
+    std::vector<prefix<uint32_t>> prefixes;
+    prefixes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t len = lens(rng);
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        prefixes.emplace_back(v, len);
+    }
+    return prefixes;
+}
+
+// every length 0-32 equally likely, addresses uniform.
+inline std::vector<prefix<uint32_t>> uniform_prefixes(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    std::vector<prefix<uint32_t>> prefixes;
+    prefixes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        prefixes.emplace_back(v, len);
+    }
+    return prefixes;
+}
+
+// worst case for a binary trie: /28-/32 packed under a few /12s, so every
+// walk goes 28 levels or more and the low levels are dense.
+inline std::vector<prefix<uint32_t>> deep_prefixes(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    uint32_t roots[4];
+    for (auto& r : roots) {
+        r = rng() & 0xfff00000;
+    }
+    std::vector<prefix<uint32_t>> prefixes;
+    prefixes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t len = 28 + rng() % 5;
+        uint32_t v = (roots[rng() % 4] | (rng() & 0xfffff)) & ~((uint64_t(1) << (32 - len)) - 1);
+        prefixes.emplace_back(v, len);
+    }
+    return prefixes;
+}
+
+inline std::vector<uint32_t> random_keys(size_t n, uint32_t seed = 2) {
+    std::mt19937 rng(seed);
+    std::vector<uint32_t> keys(n);
+    for (auto& k : keys) {
+        k = rng();
+    }
+    return keys;
+}
+
+// IPv6 table: lengths 32-64 weighted toward /48, all under 2000::/3.
+inline std::vector<prefix<uint128_t>> random_ipv6_prefixes(size_t n, uint32_t seed = 1) {
+    std::mt19937_64 rng(seed);
+    std::discrete_distribution<int> lens({1, 2, 4, 1, 1, 2, 2, 10, 3, 2, 2, 2, 2, 2, 3, 1, 6});
+
+    std::vector<prefix<uint128_t>> prefixes;
+    prefixes.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        uint8_t len = 32 + 2 * lens(rng);
+        uint128_t v = (uint128_t(rng()) << 64 | rng()) >> 3 | (uint128_t(1) << 125);
+        prefixes.emplace_back(v & ~((uint128_t(1) << (128 - len)) - 1), len);
+    }
+    return prefixes;
+}
+
+inline std::vector<uint128_t> random_ipv6_keys(const std::vector<prefix<uint128_t>>& prefixes, size_t n, uint32_t seed = 2) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint128_t> keys(n);
+    for (auto& k : keys) {
+        // mostly covered by some prefix, like real traffic.
+        k = prefixes[rng() % prefixes.size()].v | (rng() & 0xffffffffffff);
+    }
+    return keys;
+}
+
+// ACL rules shaped loosely after ClassBench seeds: addresses from /8 to /32
+// with many wildcards, ports mostly wildcard, exact or 1024-65535, protocols
+// mostly tcp or udp.
+inline std::vector<acl_rule> random_rules(size_t n, uint32_t seed = 1) {
+    std::mt19937 rng(seed);
+    std::discrete_distribution<int> lens({30, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 0, 2, 0, 0, 0,
+                                          6, 0, 0, 0, 4, 0, 0, 0, 20, 0, 0, 0, 6, 0, 0, 0, 30});
+    auto addr = [&] {
+        uint8_t len = lens(rng);
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        return ipv4_prefix(v, len);
+    };
+    auto port = [&] {
+        switch (rng() % 10) {
+        case 0: case 1: case 2: case 3: case 4:
+            return acl_rule::port_range(0, 65535);
+        case 5: case 6: case 7: {
+            uint16_t p = rng() % 1024;
+            return acl_rule::port_range(p, p);
+        }
+        case 8:
+            return acl_rule::port_range(1024, 65535);
+        default: {
+            uint16_t lo = rng(), hi = rng();
+            return acl_rule::port_range(std::min(lo, hi), std::max(lo, hi));
+        }
+        }
+    };
+    auto proto = [&] {
+        switch (rng() % 10) {
+        case 0: case 1: case 2:
+            return acl_rule::proto_range(0, 255);
+        case 3: case 4: case 5: case 6: case 7:
+            return acl_rule::proto_range(6, 6);
+        default:
+            return acl_rule::proto_range(17, 17);
+        }
+    };
+
+    std::vector<acl_rule> rules;
+    rules.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        auto src = addr();
+        auto dst = addr();
+        // a rule wildcarding both addresses would shadow most of the rest.
+        while (src.len == 0 && dst.len == 0) {
+            dst = addr();
+        }
+        auto sp = port();
+        auto dp = port();
+        rules.emplace_back(src, dst, sp, dp, proto());
+    }
+    return rules;
+}
+
+// packets inside the box of a random rule, so most of them match something
+// and the rule they match is not always the first candidate.
+inline std::vector<five_tuple> random_tuples(const std::vector<acl_rule>& rules, size_t n, uint32_t seed = 2) {
+    std::mt19937 rng(seed);
+    auto in = [&](uint32_t lo, uint32_t hi) {
+        return uint32_t(lo + (uint64_t(rng()) % (uint64_t(hi) - lo + 1)));
+    };
+    auto addr = [&](const ipv4_prefix& p) -> uint32_t {
+        return p.len ? p.v | (rng() & uint32_t((uint64_t(1) << (32 - p.len)) - 1)) : uint32_t(rng());
+    };
+
+    std::vector<five_tuple> tuples(n);
+    for (auto& t : tuples) {
+        const auto& r = rules[rng() % rules.size()];
+        t = {addr(r.src), addr(r.dst), uint16_t(in(r.src_port.low, r.src_port.high)),
+             uint16_t(in(r.dst_port.low, r.dst_port.high)), uint8_t(in(r.proto.low, r.proto.high))};
+    }
+    return tuples;
+}
+
+constexpr size_t table_size = 1 << 20;
+constexpr size_t key_count = 1 << 16;
+
+// table_size random prefixes, built once per table type.
+template <typename Table>
+const Table& build_table() {
+    static const auto table = [] {
+        auto t = std::make_unique<Table>();
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            t->insert(p, value++);
+        }
+        return t;
+    }();
+    return *table;
+}
+
+#endif
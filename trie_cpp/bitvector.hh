@@ -0,0 +1,172 @@
+#ifndef BITVECTOR_HH
+#define BITVECTOR_HH
+
+#include "classifier.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <immintrin.h>
+
+// Bit vector (Lakshman and Stiliadis, Lucent) classifier for acl_rule.
+//
+// Every field is cut into the elementary intervals delimited by the rule
+// boundaries in that field, and every interval holds a bitset of the rules
+// covering it, bit i for rule i. A packet finds its interval in each field by
+// binary search and ANDs the five bitsets; the first set bit is the highest
+// priority match. Port and protocol ranges cost one interval boundary each
+// instead of a range to prefix expansion, at N bits per interval and field.
+//
+// The AND runs in the widest kernel the CPU supports, chosen at runtime, and
+// stops at the first non-zero block, so matches on early rules are cheap.
+class bitvector {
+public:
+    explicit bitvector(const std::vector<acl_rule>& rules, simd_kernel k = best_simd_kernel()) {
+        if (!simd_supported(k)) {
+            throw std::invalid_argument("bit vector kernel not supported by this cpu");
+        }
+        and_first = k == simd_kernel::avx512 ? &and_first_avx512 : k == simd_kernel::avx2 ? &and_first_avx2 : &and_first_scalar;
+
+        // whole blocks, so every kernel runs without a tail.
+        blocks = std::max<size_t>(1, (rules.size() + 511) / 512);
+        words = blocks * block_words;
+        std::vector<acl_box> boxes(rules.begin(), rules.end());
+        for (size_t d = 0; d < acl_fields; d++) {
+            build_field(fields[d], boxes, d);
+        }
+    }
+
+    bitvector(const bitvector&) = delete;
+    bitvector& operator=(const bitvector&) = delete;
+
+    // id of the highest priority rule matching t.
+    std::optional<uint32_t> classify(const five_tuple& t) const {
+        acl_point f = tuple_fields(t);
+        const uint64_t* sets[acl_fields];
+        for (size_t d = 0; d < acl_fields; d++) {
+            const auto& fd = fields[d];
+            size_t k = std::upper_bound(fd.starts.begin(), fd.starts.end(), f[d]) - fd.starts.begin() - 1;
+            sets[d] = fd.bits[k * blocks].w;
+        }
+        uint32_t id = and_first(sets, words);
+        return id == no_rule ? std::nullopt : std::optional<uint32_t>(id);
+    }
+
+    size_t memory_usage() const {
+        size_t bytes = 0;
+        for (const auto& fd : fields) {
+            bytes += fd.starts.capacity() * sizeof(uint32_t) + fd.bits.capacity() * sizeof(block);
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t no_rule = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t block_words = 8;
+
+    // 512 rules, one cache line and one avx-512 register.
+    struct alignas(64) block {
+        uint64_t w[block_words];
+    };
+
+    struct field {
+        // first value of every elementary interval, starts[0] == 0.
+        std::vector<uint32_t> starts;
+        // the rule bitset of interval k is blocks [k * blocks, (k + 1) * blocks).
+        std::vector<block> bits;
+    };
+
+    void build_field(field& fd, const std::vector<acl_box>& boxes, size_t d) {
+        uint32_t max = uint32_t((uint64_t(1) << acl_field_bits[d]) - 1);
+        fd.starts.push_back(0);
+        for (const auto& b : boxes) {
+            fd.starts.push_back(b.lo[d]);
+            if (b.hi[d] < max) {
+                fd.starts.push_back(b.hi[d] + 1);
+            }
+        }
+        std::sort(fd.starts.begin(), fd.starts.end());
+        fd.starts.erase(std::unique(fd.starts.begin(), fd.starts.end()), fd.starts.end());
+
+        // sweep the intervals keeping the set of rules covering the current
+        // one: a rule enters at its low interval and leaves after its high.
+        size_t n = fd.starts.size();
+        std::vector<std::vector<uint32_t>> enter(n), leave(n + 1);
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            auto at = [&](uint32_t v) {
+                return std::upper_bound(fd.starts.begin(), fd.starts.end(), v) - fd.starts.begin() - 1;
+            };
+            enter[at(boxes[i].lo[d])].push_back(i);
+            leave[at(boxes[i].hi[d]) + 1].push_back(i);
+        }
+
+        fd.bits.assign(n * blocks, block{});
+        std::vector<uint64_t> active(words, 0);
+        for (size_t k = 0; k < n; k++) {
+            for (uint32_t i : leave[k]) {
+                active[i / 64] &= ~(uint64_t(1) << (i % 64));
+            }
+            for (uint32_t i : enter[k]) {
+                active[i / 64] |= uint64_t(1) << (i % 64);
+            }
+            std::copy(active.begin(), active.end(), fd.bits[k * blocks].w);
+        }
+    }
+
+    static uint32_t and_first_scalar(const uint64_t* const* s, size_t words) {
+        for (size_t w = 0; w < words; w++) {
+            uint64_t x = s[0][w] & s[1][w] & s[2][w] & s[3][w] & s[4][w];
+            if (x) {
+                return w * 64 + __builtin_ctzll(x);
+            }
+        }
+        return no_rule;
+    }
+
+    __attribute__((target("avx2")))
+    static uint32_t and_first_avx2(const uint64_t* const* s, size_t words) {
+        for (size_t w = 0; w < words; w += 4) {
+            __m256i x = _mm256_load_si256(reinterpret_cast<const __m256i*>(s[0] + w));
+            for (size_t d = 1; d < acl_fields; d++) {
+                x = _mm256_and_si256(x, _mm256_load_si256(reinterpret_cast<const __m256i*>(s[d] + w)));
+            }
+            if (!_mm256_testz_si256(x, x)) {
+                alignas(32) uint64_t out[4];
+                _mm256_store_si256(reinterpret_cast<__m256i*>(out), x);
+                size_t lane = 0;
+                while (!out[lane]) {
+                    lane++;
+                }
+                return (w + lane) * 64 + __builtin_ctzll(out[lane]);
+            }
+        }
+        return no_rule;
+    }
+
+    __attribute__((target("avx512f")))
+    static uint32_t and_first_avx512(const uint64_t* const* s, size_t words) {
+        for (size_t w = 0; w < words; w += 8) {
+            __m512i x = _mm512_load_si512(s[0] + w);
+            for (size_t d = 1; d < acl_fields; d++) {
+                x = _mm512_and_si512(x, _mm512_load_si512(s[d] + w));
+            }
+            __mmask8 nz = _mm512_test_epi64_mask(x, x);
+            if (nz) {
+                unsigned lane = __builtin_ctz(nz);
+                alignas(64) uint64_t out[8];
+                _mm512_store_si512(out, x);
+                return (w + lane) * 64 + __builtin_ctzll(out[lane]);
+            }
+        }
+        return no_rule;
+    }
+
+    size_t blocks = 0;
+    size_t words = 0;
+    field fields[acl_fields];
+    uint32_t (*and_first)(const uint64_t* const*, size_t) = nullptr;
+};
+
+#endif
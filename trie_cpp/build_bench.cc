@@ -0,0 +1,94 @@
+#include "bench_util.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+std::vector<std::pair<prefix<uint32_t>, uint32_t>> build_input(bool sorted) {
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+    uint32_t value = 1;
+    for (const auto& p : random_prefixes(table_size)) {
+        table.emplace_back(p, value++);
+    }
+    if (sorted) {
+        std::stable_sort(table.begin(), table.end(), [](const auto& a, const auto& b) {
+            return a.first.v != b.first.v ? a.first.v < b.first.v : a.first.len < b.first.len;
+        });
+    }
+    return table;
+}
+
+void BM_insert_all(benchmark::State& state) {
+    auto table = build_input(false);
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        for (const auto& [p, v] : table) {
+            t.insert(p, v);
+        }
+        benchmark::DoNotOptimize(t.root.left.get());
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+
+// range(0): the input is already sorted.
+void BM_build(benchmark::State& state) {
+    auto table = build_input(state.range(0));
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        t.build<uint32_t>(table, state.range(0));
+        benchmark::DoNotOptimize(t.root.left.get());
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+
+// range(0): threads, range(1): partition bits.
+void BM_build_parallel(benchmark::State& state) {
+    auto table = build_input(false);
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        t.build_parallel<uint32_t>(table, state.range(0), false, state.range(1));
+        benchmark::DoNotOptimize(t.root.left.get());
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+
+std::vector<std::pair<prefix<uint128_t>, uint32_t>> build_ipv6_input() {
+    std::vector<std::pair<prefix<uint128_t>, uint32_t>> table;
+    uint32_t value = 1;
+    for (const auto& p : random_ipv6_prefixes(table_size)) {
+        table.emplace_back(p, value++);
+    }
+    return table;
+}
+
+void BM_insert_all_ipv6(benchmark::State& state) {
+    auto table = build_ipv6_input();
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        for (const auto& [p, v] : table) {
+            t.insert(p, v);
+        }
+        benchmark::DoNotOptimize(t.root.left.get());
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+
+// the table is all under 2000::/3, 12 bits give 512 partitions.
+void BM_build_parallel_ipv6(benchmark::State& state) {
+    auto table = build_ipv6_input();
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        t.build_parallel<uint128_t>(table, state.range(0), false, 12);
+        benchmark::DoNotOptimize(t.root.left.get());
+    }
+    state.SetItemsProcessed(state.iterations() * table.size());
+}
+
+}
+
+BENCHMARK(BM_insert_all)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_build)->ArgName("sorted")->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_build_parallel)->ArgNames({"threads", "bits"})->ArgsProduct({{1, 2, 4, 8, 16, 32}, {8, 12}})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_insert_all_ipv6)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_build_parallel_ipv6)->ArgName("threads")->RangeMultiplier(2)->Range(1, 32)
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
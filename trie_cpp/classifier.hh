@@ -0,0 +1,94 @@
+#ifndef CLASSIFIER_HH
+#define CLASSIFIER_HH
+
+#include "trie.hh"
+#include <array>
+#include <cstdint>
+
+// Common ground of the acl_rule classifiers: a rule seen as a box in the five
+// dimensional field space, each field a closed interval of uint32_t, in the
+// order src, dst, src port, dst port, proto. Rules are prioritized by their
+// position in the rule vector, the first matching one wins and its index is
+// the rule id.
+constexpr size_t acl_fields = 5;
+constexpr unsigned acl_field_bits[acl_fields] = {32, 32, 16, 16, 8};
+
+using acl_point = std::array<uint32_t, acl_fields>;
+
+inline acl_point tuple_fields(const five_tuple& t) {
+    return {t.src, t.dst, t.src_port, t.dst_port, t.proto};
+}
+
+// vector instruction sets the classifiers pick from at runtime, all of them
+// built into the binary through target attributes.
+enum class simd_kernel { scalar, avx2, avx512 };
+
+inline bool simd_supported(simd_kernel k) {
+    switch (k) {
+    case simd_kernel::avx512:
+        return __builtin_cpu_supports("avx512f");
+    case simd_kernel::avx2:
+        return __builtin_cpu_supports("avx2");
+    default:
+        return true;
+    }
+}
+
+inline simd_kernel best_simd_kernel() {
+    return simd_supported(simd_kernel::avx512) ? simd_kernel::avx512
+           : simd_supported(simd_kernel::avx2) ? simd_kernel::avx2
+                                                 : simd_kernel::scalar;
+}
+
+struct acl_box {
+    acl_point lo;
+    acl_point hi;
+
+    acl_box() = default;
+
+    explicit acl_box(const acl_rule& r) {
+        auto prefix_range = [](const ipv4_prefix& p) {
+            uint32_t host = p.len ? uint32_t((uint64_t(1) << (32 - p.len)) - 1) : 0xffffffff;
+            return std::pair<uint32_t, uint32_t>(p.v, p.v | host);
+        };
+        std::tie(lo[0], hi[0]) = prefix_range(r.src);
+        std::tie(lo[1], hi[1]) = prefix_range(r.dst);
+        lo[2] = r.src_port.low;
+        hi[2] = r.src_port.high;
+        lo[3] = r.dst_port.low;
+        hi[3] = r.dst_port.high;
+        lo[4] = r.proto.low;
+        hi[4] = r.proto.high;
+    }
+
+    // one unsigned compare per field: f - lo wraps above hi - lo when f < lo.
+    bool match(const acl_point& f) const {
+        bool m = true;
+        for (size_t d = 0; d < acl_fields; d++) {
+            m &= f[d] - lo[d] <= hi[d] - lo[d];
+        }
+        return m;
+    }
+
+    bool overlaps(const acl_box& o) const {
+        for (size_t d = 0; d < acl_fields; d++) {
+            if (o.hi[d] < lo[d] || hi[d] < o.lo[d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool contains(const acl_box& o) const {
+        for (size_t d = 0; d < acl_fields; d++) {
+            if (o.lo[d] < lo[d] || hi[d] < o.hi[d]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator==(const acl_box&) const = default;
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "acl_analyzer.hh"
+#include "acl_classifier.hh"
+#include "bench_util.hh"
+#include "bitvector.hh"
+#include "hypercuts.hh"
+#include "tuple_space.hh"
+#include <benchmark/benchmark.h>
+#include <map>
+
+namespace {
+
+constexpr size_t tuple_count = 1 << 16;
+
+const std::vector<acl_rule>& rule_set(size_t n) {
+    static std::map<size_t, std::vector<acl_rule>> sets;
+    auto [it, inserted] = sets.try_emplace(n);
+    if (inserted) {
+        it->second = random_rules(n);
+    }
+    return it->second;
+}
+
+const std::vector<five_tuple>& tuple_set(size_t n) {
+    static std::map<size_t, std::vector<five_tuple>> sets;
+    auto [it, inserted] = sets.try_emplace(n);
+    if (inserted) {
+        it->second = random_tuples(rule_set(n), tuple_count);
+    }
+    return it->second;
+}
+
+template <typename Classifier>
+const Classifier& classifier(size_t n) {
+    static std::map<size_t, std::unique_ptr<Classifier>> built;
+    auto& c = built[n];
+    if (!c) {
+        c = std::make_unique<Classifier>(rule_set(n));
+    }
+    return *c;
+}
+
+template <typename Classifier>
+void BM_classifier_build(benchmark::State& state) {
+    const auto& rules = rule_set(state.range(0));
+    for (auto _ : state) {
+        Classifier c(rules);
+        benchmark::DoNotOptimize(&c);
+    }
+    const auto& c = classifier<Classifier>(state.range(0));
+    state.counters["bytes_per_rule"] = double(c.memory_usage()) / rules.size();
+}
+
+template <typename Classifier>
+void BM_classify(benchmark::State& state) {
+    const auto& c = classifier<Classifier>(state.range(0));
+    const auto& tuples = tuple_set(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(c.classify(tuples[i++ & (tuple_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Classifier>
+void BM_classify_batch(benchmark::State& state) {
+    const auto& c = classifier<Classifier>(state.range(0));
+    const auto& tuples = tuple_set(state.range(0));
+    constexpr size_t burst = 64;
+    std::vector<std::optional<uint32_t>> ids(burst);
+    size_t i = 0;
+    for (auto _ : state) {
+        c.classify_batch(std::span(tuples).subspan(i, burst), std::span(ids));
+        benchmark::DoNotOptimize(ids.data());
+        i = (i + burst) & (tuple_count - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+
+// one rule leaves and comes back, two updates per iteration.
+void BM_tuple_space_update(benchmark::State& state) {
+    const auto& rules = rule_set(state.range(0));
+    tuple_space ts(rules);
+    std::mt19937 rng(5);
+    for (auto _ : state) {
+        uint32_t id = rng() % rules.size();
+        ts.remove(id);
+        ts.insert(id, rules[id]);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+    state.counters["per_update"] = benchmark::Counter(
+        2, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    state.counters["tuples"] = ts.tuple_count();
+}
+
+// the same lookups through every and kernel the cpu has.
+void BM_bitvector_kernel(benchmark::State& state) {
+    auto k = simd_kernel(state.range(1));
+    if (!simd_supported(k)) {
+        state.SkipWithError("kernel not supported");
+        return;
+    }
+    bitvector bv(rule_set(state.range(0)), k);
+    const auto& tuples = tuple_set(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(bv.classify(tuples[i++ & (tuple_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// index build and analysis, per thread count.
+void BM_acl_analyze(benchmark::State& state) {
+    const auto& rules = rule_set(state.range(0));
+    acl_report r;
+    for (auto _ : state) {
+        acl_analyzer a(rules);
+        r = a.analyze(state.range(1));
+    }
+    state.SetItemsProcessed(state.iterations() * rules.size());
+    state.counters["shadowed"] = r.shadowed.size();
+    state.counters["redundant"] = r.redundant.size();
+    state.counters["correlated"] = r.correlated_count;
+}
+
+void rule_counts(benchmark::internal::Benchmark* b) {
+    b->ArgName("rules")->Arg(1000)->Arg(10000)->Arg(100000);
+}
+
+// per-tenant acl sizes, around acl_classifier::default_threshold.
+void tenant_rule_counts(benchmark::internal::Benchmark* b) {
+    b->ArgName("rules")->RangeMultiplier(2)->Range(8, 1024);
+}
+
+// bit vectors take n^2 bits per field, 100000 rules would need gigabytes.
+void small_rule_counts(benchmark::internal::Benchmark* b) {
+    b->ArgName("rules")->Arg(1000)->Arg(10000);
+}
+
+}
+
+BENCHMARK_TEMPLATE(BM_classifier_build, hypercuts)->Apply(rule_counts)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_classify, hypercuts)->Apply(rule_counts);
+BENCHMARK_TEMPLATE(BM_classify_batch, hypercuts)->Apply(rule_counts);
+BENCHMARK_TEMPLATE(BM_classifier_build, tuple_space)->Apply(rule_counts)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_classify, tuple_space)->Apply(rule_counts);
+BENCHMARK(BM_tuple_space_update)->Apply(rule_counts);
+BENCHMARK_TEMPLATE(BM_classifier_build, bitvector)->Apply(small_rule_counts)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_classify, bitvector)->Apply(small_rule_counts);
+BENCHMARK(BM_bitvector_kernel)->ArgNames({"rules", "kernel"})->ArgsProduct({{1000, 10000}, {0, 1, 2}});
+BENCHMARK_TEMPLATE(BM_classify, linear_scan)->Apply(tenant_rule_counts);
+BENCHMARK_TEMPLATE(BM_classify, hypercuts)->Apply(tenant_rule_counts);
+BENCHMARK_TEMPLATE(BM_classify, acl_classifier)->Apply(tenant_rule_counts);
+BENCHMARK(BM_acl_analyze)->ArgNames({"rules", "threads"})->ArgsProduct({{1000, 10000, 100000}, {1, 4}})->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,204 @@
+#include "acl_classifier.hh"
+#include "bitvector.hh"
+#include "huge_pages.hh"
+#include "hypercuts.hh"
+#include "test_util.hh"
+#include "tuple_space.hh"
+#include <map>
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+std::vector<acl_rule> make_rules(size_t n, uint32_t seed) {
+    return nested_rules(n, seed, 0x0f0f0f0f, 2048);
+}
+
+std::vector<five_tuple> make_tuples(size_t n, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::vector<five_tuple> tuples(n);
+    for (auto& t : tuples) {
+        t = {uint32_t(rng() & 0x0f0f0f0f), uint32_t(rng() & 0x0f0f0f0f), uint16_t(rng() % 2400), uint16_t(rng() % 2400),
+             uint8_t(rng() % 2 ? 6 : 17)};
+    }
+    return tuples;
+}
+
+std::optional<uint32_t> linear_classify(const std::vector<acl_rule>& rules, const five_tuple& t) {
+    for (uint32_t i = 0; i < rules.size(); i++) {
+        if (rules[i].match(t)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+}
+
+TEST(HyperCuts, Test1) {
+    std::vector<acl_rule> rules = {
+        {"10.0.0.0/8", "0.0.0.0/0", "0-65535", "80-80", "6-6"},
+        {"10.1.0.0/16", "0.0.0.0/0", "0-65535", "0-65535", "0-255"},
+        {"0.0.0.0/0", "0.0.0.0/0", "0-65535", "0-65535", "0-255"},
+    };
+    hypercuts hc(rules, 1);
+    EXPECT_EQ(hc.classify({0x0a010101, 0x08080808, 1000, 80, 6}), 0);
+    EXPECT_EQ(hc.classify({0x0a010101, 0x08080808, 1000, 81, 6}), 1);
+    EXPECT_EQ(hc.classify({0x0b010101, 0x08080808, 1000, 80, 6}), 2);
+    EXPECT_EQ(hypercuts({}).classify({0, 0, 0, 0, 0}), std::nullopt);
+}
+
+TEST(HyperCuts, SameAsLinear) {
+    for (size_t binth : {1, 4, 16}) {
+        auto rules = make_rules(1500, binth);
+        auto tuples = make_tuples(20000, binth + 1);
+        hypercuts hc(rules, binth);
+
+        std::vector<std::optional<uint32_t>> ids(tuples.size());
+        hc.classify_batch(std::span<const five_tuple>(tuples), std::span(ids));
+        for (size_t i = 0; i < tuples.size(); i++) {
+            auto expected = linear_classify(rules, tuples[i]);
+            EXPECT_EQ(hc.classify(tuples[i]), expected) << tuples[i].show();
+            EXPECT_EQ(ids[i], expected) << tuples[i].show();
+        }
+    }
+}
+
+TEST(HyperCuts, HugePages) {
+    auto rules = make_rules(1500, 2);
+    auto tuples = make_tuples(5000, 3);
+    hypercuts hc(rules);
+    basic_hypercuts<huge_page_allocator> huge(rules);
+    EXPECT_EQ(huge.memory_usage(), hc.memory_usage());
+    for (const auto& t : tuples) {
+        EXPECT_EQ(huge.classify(t), hc.classify(t)) << t.show();
+    }
+}
+
+TEST(TupleSpace, Test1) {
+    tuple_space ts;
+    ts.insert(5, {"10.0.0.0/8", "0.0.0.0/0", "0-65535", "80-80", "6-6"});
+    ts.insert(7, {"10.1.0.0/16", "0.0.0.0/0", "1000-2000", "0-65535", "0-255"});
+    ts.insert(9, {"0.0.0.0/0", "0.0.0.0/0", "0-65535", "0-65535", "0-255"});
+    EXPECT_EQ(ts.tuple_count(), 3);
+    EXPECT_THROW(ts.insert(9, {"0.0.0.0/0", "0.0.0.0/0", "0-65535", "0-65535", "0-255"}), std::invalid_argument);
+
+    EXPECT_EQ(ts.classify({0x0a010101, 0x08080808, 1000, 80, 6}), 5);
+    EXPECT_EQ(ts.classify({0x0a010101, 0x08080808, 1000, 81, 6}), 7);
+    EXPECT_EQ(ts.classify({0x0a010101, 0x08080808, 999, 81, 6}), 9);
+
+    EXPECT_TRUE(ts.remove(5));
+    EXPECT_FALSE(ts.remove(5));
+    EXPECT_EQ(ts.classify({0x0a010101, 0x08080808, 1000, 80, 6}), 7);
+    ts.insert(1, {"10.1.1.1/32", "8.8.8.8/32", "1000-1000", "80-80", "6-6"});
+    EXPECT_EQ(ts.classify({0x0a010101, 0x08080808, 1000, 80, 6}), 1);
+    EXPECT_TRUE(ts.remove(9));
+    EXPECT_EQ(ts.classify({0x0b010101, 0x08080808, 1000, 80, 6}), std::nullopt);
+}
+
+TEST(TupleSpace, Updates) {
+    auto rules = make_rules(2000, 12);
+    auto tuples = make_tuples(5000, 13);
+    tuple_space ts;
+    std::map<uint32_t, acl_rule> active;
+    std::mt19937 rng(14);
+
+    auto check = [&] {
+        EXPECT_EQ(ts.size(), active.size());
+        for (const auto& t : tuples) {
+            std::optional<uint32_t> expected;
+            for (const auto& [id, r] : active) {
+                if (r.match(t)) {
+                    expected = id;
+                    break;
+                }
+            }
+            EXPECT_EQ(ts.classify(t), expected) << t.show();
+        }
+    };
+
+    for (uint32_t i = 0; i < rules.size(); i++) {
+        ts.insert(i, rules[i]);
+        active.emplace(i, rules[i]);
+    }
+    check();
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 500; i++) {
+            uint32_t id = rng() % rules.size();
+            EXPECT_EQ(ts.remove(id), active.erase(id) == 1);
+        }
+        check();
+        for (int i = 0; i < 300; i++) {
+            uint32_t id = rng() % rules.size();
+            if (!active.count(id)) {
+                ts.insert(id, rules[id]);
+                active.emplace(id, rules[id]);
+            }
+        }
+        check();
+    }
+}
+
+TEST(BitVector, Test1) {
+    std::vector<acl_rule> rules = {
+        {"10.0.0.0/8", "0.0.0.0/0", "0-65535", "80-80", "6-6"},
+        {"10.1.0.0/16", "0.0.0.0/0", "1000-2000", "0-65535", "0-255"},
+        {"0.0.0.0/0", "0.0.0.0/0", "0-65535", "0-65535", "17-17"},
+    };
+    bitvector bv(rules);
+    EXPECT_EQ(bv.classify({0x0a010101, 0x08080808, 1000, 80, 6}), 0);
+    EXPECT_EQ(bv.classify({0x0a010101, 0x08080808, 1000, 81, 6}), 1);
+    EXPECT_EQ(bv.classify({0x0a010101, 0x08080808, 999, 81, 17}), 2);
+    EXPECT_EQ(bv.classify({0x0a010101, 0x08080808, 999, 81, 6}), std::nullopt);
+    EXPECT_EQ(bitvector({}).classify({0, 0, 0, 0, 0}), std::nullopt);
+}
+
+TEST(BitVector, SameAsLinear) {
+    auto rules = make_rules(1500, 15);
+    auto tuples = make_tuples(20000, 16);
+    for (auto k : {simd_kernel::scalar, simd_kernel::avx2, simd_kernel::avx512}) {
+        if (!simd_supported(k)) {
+            EXPECT_THROW(bitvector(rules, k), std::invalid_argument);
+            continue;
+        }
+        bitvector bv(rules, k);
+        for (const auto& t : tuples) {
+            EXPECT_EQ(bv.classify(t), linear_classify(rules, t)) << t.show();
+        }
+    }
+}
+
+TEST(LinearScan, SameAsLinear) {
+    auto tuples = make_tuples(20000, 18);
+    for (size_t n : {0, 1, 15, 16, 17, 63, 200}) {
+        auto rules = make_rules(n, 17);
+        for (auto k : {simd_kernel::scalar, simd_kernel::avx2, simd_kernel::avx512}) {
+            if (!simd_supported(k)) {
+                EXPECT_THROW(linear_scan(rules, k), std::invalid_argument);
+                continue;
+            }
+            linear_scan ls(rules, k);
+            EXPECT_EQ(ls.size(), n);
+            for (const auto& t : tuples) {
+                EXPECT_EQ(ls.classify(t), linear_classify(rules, t)) << t.show();
+            }
+        }
+    }
+}
+
+TEST(AclClassifier, Threshold) {
+    auto rules = make_rules(300, 19);
+    auto tuples = make_tuples(5000, 20);
+    EXPECT_TRUE(acl_classifier(std::vector(rules.begin(), rules.begin() + 255)).linear());
+    EXPECT_FALSE(acl_classifier(std::vector(rules.begin(), rules.begin() + 256)).linear());
+    for (size_t threshold : {0, 1000}) {
+        acl_classifier c(rules, threshold);
+        EXPECT_EQ(c.linear(), threshold > 0);
+        for (const auto& t : tuples) {
+            EXPECT_EQ(c.classify(t), linear_classify(rules, t)) << t.show();
+        }
+    }
+}
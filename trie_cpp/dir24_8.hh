@@ -0,0 +1,260 @@
+#ifndef DIR24_8_HH
+#define DIR24_8_HH
+
+#include "trie.hh"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// DIR-24-8 (Gupta, Lin, McKeown) IPv4 longest prefix match: a 2^24 entry
+// table indexed by the top 24 bits of the address, and 256 entry tbl8 groups
+// for the /24s that hold longer prefixes. A lookup is at most two reads.
+//
+// Like DPDK's rte_lpm every entry remembers the length of the prefix that
+// wrote it, so an update only rewrites the entries the prefix covers and
+// that no longer prefix already owns. The prefixes themselves are kept in a
+// trie<T>, which answers find() and provides the covering prefix on removal.
+//
+// Entries hold a 24-bit index into a table of the distinct values. An index
+// counts the prefixes holding its value and is reused once none does, so
+// next hops replaced over and over neither grow the table nor run out of
+// indices.
+template <typename T>
+class dir24_8 {
+public:
+    static constexpr uint32_t tbl8_size = 256;
+
+    dir24_8() : tbl24(size_t(1) << 24, 0), values{init_value<T>()}, refs{0} {}
+
+    // compiles a populated trie.
+    explicit dir24_8(const trie<T>& t) : dir24_8() {
+        std::vector<prefix<uint32_t>> prefixes;
+        t.dump(prefixes);
+        std::stable_sort(prefixes.begin(), prefixes.end(), [](const auto& a, const auto& b) {
+            return a.len < b.len;
+        });
+        for (const auto& p : prefixes) {
+            insert(p, *t.find(p));
+        }
+    }
+
+    dir24_8(const dir24_8&) = delete;
+    dir24_8& operator=(const dir24_8&) = delete;
+
+    // inserting init_value<T>() removes the prefix, as in trie<T>.
+    void insert(prefix<uint32_t> p, T value) {
+        if (value == init_value<T>()) {
+            remove(p);
+            return;
+        }
+        auto old = rib.find(p);
+        rib.insert(p, value);
+        // the new value is taken before the old one is let go, an update to
+        // the same value keeps its index.
+        write(p, make_entry(acquire(value), p.len), [&](uint32_t e) {
+            return depth(e) <= p.len;
+        });
+        if (old && *old != init_value<T>()) {
+            release(*old);
+        }
+    }
+
+    // returns false if p was not inserted.
+    bool remove(prefix<uint32_t> p) {
+        auto old = rib.find(p);
+        if (!old || *old == init_value<T>()) {
+            return false;
+        }
+        rib.insert(p, init_value<T>());
+
+        // the entries p wrote fall back to the longest prefix covering p.
+        auto [value, len] = covering(p);
+        uint32_t entry = value == init_value<T>() ? 0 : make_entry(value_index.at(value), len);
+        write(p, entry, [&](uint32_t e) {
+            return depth(e) == p.len && index(e) != 0;
+        });
+        release(*old);
+
+        if (p.len > 24) {
+            collapse(p.v >> 8);
+        }
+        return true;
+    }
+
+    // exact match of p, same semantics as trie<T>::find.
+    std::optional<T> find(prefix<uint32_t> p) const {
+        return rib.find(p);
+    }
+
+    // longest prefix match, one read for a /24 without longer prefixes, two
+    // otherwise.
+    std::optional<T> lookup(uint32_t key) const {
+        uint32_t e = tbl24[key >> 8];
+        if (e & extended) {
+            e = tbl8[index(e) * tbl8_size + (key & 0xff)];
+        }
+        uint32_t i = index(e);
+        return i ? std::optional<T>(values[i]) : std::nullopt;
+    }
+
+    // distinct values held by prefixes.
+    size_t value_count() const {
+        return value_index.size();
+    }
+
+    size_t tbl8_groups() const {
+        return tbl8.size() / tbl8_size - free_groups.size();
+    }
+
+    // the lookup tables only, the rib and the value index are control plane.
+    size_t memory_usage() const {
+        return tbl24.capacity() * sizeof(uint32_t) + tbl8.capacity() * sizeof(uint32_t) +
+               free_groups.capacity() * sizeof(uint32_t) + values.capacity() * sizeof(T);
+    }
+
+private:
+    // entry: | extended:1 | unused:1 | depth:6 | index:24 |
+    // index is a value index, or the tbl8 group of an extended tbl24 entry.
+    static constexpr uint32_t extended = 1u << 31;
+    static constexpr uint32_t index_mask = (1u << 24) - 1;
+
+    static uint32_t make_entry(uint32_t idx, uint8_t len) {
+        return (uint32_t(len) << 24) | idx;
+    }
+
+    static uint8_t depth(uint32_t e) {
+        return (e >> 24) & 0x3f;
+    }
+
+    static uint32_t index(uint32_t e) {
+        return e & index_mask;
+    }
+
+    // the index of value for one more prefix.
+    uint32_t acquire(T value) {
+        auto [it, inserted] = value_index.emplace(value, 0);
+        if (inserted) {
+            if (!free_values.empty()) {
+                it->second = free_values.back();
+                free_values.pop_back();
+                values[it->second] = value;
+            } else if (values.size() > index_mask) {
+                value_index.erase(it);
+                throw std::runtime_error("dir24_8 out of value indices");
+            } else {
+                it->second = values.size();
+                values.push_back(value);
+                refs.push_back(0);
+            }
+        }
+        refs[it->second]++;
+        return it->second;
+    }
+
+    // one prefix less holds value; its index is free once no entry refers
+    // to it, which the caller has made sure of by rewriting the entries.
+    void release(T value) {
+        auto it = value_index.find(value);
+        if (--refs[it->second] == 0) {
+            free_values.push_back(it->second);
+            value_index.erase(it);
+        }
+    }
+
+    // writes entry over every entry of the range of p that pred accepts.
+    template <typename Pred>
+    void write(prefix<uint32_t> p, uint32_t entry, Pred pred) {
+        if (p.len <= 24) {
+            size_t first = p.v >> 8;
+            size_t count = size_t(1) << (24 - p.len);
+            for (size_t i = first; i < first + count; i++) {
+                uint32_t& e = tbl24[i];
+                if (e & extended) {
+                    uint32_t* group = &tbl8[index(e) * tbl8_size];
+                    for (uint32_t j = 0; j < tbl8_size; j++) {
+                        if (pred(group[j])) {
+                            group[j] = entry;
+                        }
+                    }
+                } else if (pred(e)) {
+                    e = entry;
+                }
+            }
+            return;
+        }
+
+        uint32_t& e = tbl24[p.v >> 8];
+        if (!(e & extended)) {
+            e = extended | alloc_group(e);
+        }
+        uint32_t* group = &tbl8[index(e) * tbl8_size];
+        uint32_t first = p.v & 0xff;
+        uint32_t count = 1u << (32 - p.len);
+        for (uint32_t j = first; j < first + count; j++) {
+            if (pred(group[j])) {
+                group[j] = entry;
+            }
+        }
+    }
+
+    // a group starting as a copy of the tbl24 entry it replaces.
+    uint32_t alloc_group(uint32_t fill) {
+        uint32_t g;
+        if (!free_groups.empty()) {
+            g = free_groups.back();
+            free_groups.pop_back();
+        } else {
+            g = tbl8.size() / tbl8_size;
+            if (g > index_mask) {
+                throw std::runtime_error("dir24_8 out of tbl8 groups");
+            }
+            tbl8.resize(tbl8.size() + tbl8_size);
+        }
+        std::fill_n(&tbl8[g * tbl8_size], tbl8_size, fill);
+        return g;
+    }
+
+    // folds a group back into tbl24 once no prefix longer than /24 is left.
+    void collapse(uint32_t i) {
+        uint32_t g = index(tbl24[i]);
+        const uint32_t* group = &tbl8[g * tbl8_size];
+        for (uint32_t j = 0; j < tbl8_size; j++) {
+            if (depth(group[j]) > 24 || group[j] != group[0]) {
+                return;
+            }
+        }
+        tbl24[i] = group[0];
+        free_groups.push_back(g);
+    }
+
+    // longest prefix in the rib strictly shorter than p and covering it.
+    std::pair<T, uint8_t> covering(prefix<uint32_t> p) const {
+        const trie_node_base* n = &rib.root;
+        std::pair<T, uint8_t> best{init_value<T>(), 0};
+        uint32_t v = p.v;
+        for (uint8_t len = 0; n && len < p.len; len++) {
+            const auto* tn = static_cast<const trie_node<T>*>(n);
+            if (tn->has_info()) {
+                best = {tn->value, len};
+            }
+            n = (v & 0x80000000u) ? n->right.get() : n->left.get();
+            v <<= 1;
+        }
+        return best;
+    }
+
+    std::vector<uint32_t> tbl24;
+    std::vector<uint32_t> tbl8;
+    std::vector<uint32_t> free_groups;
+    std::vector<T> values;
+    // prefixes holding each value, and the indices none holds.
+    std::vector<uint32_t> refs;
+    std::vector<uint32_t> free_values;
+    std::map<T, uint32_t> value_index;
+    trie<T> rib;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "dir24_8.hh"
+#include <cstdint>
+#include <random>
+#include <set>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(Dir24_8, Test1) {
+    dir24_8<uint32_t> d;
+    d.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    d.insert(ipv4_prefix("10.1.2.0/24"), 2);
+    d.insert(ipv4_prefix("10.1.2.128/25"), 3);
+    d.insert(ipv4_prefix("10.1.2.200/32"), 4);
+    EXPECT_EQ(d.tbl8_groups(), 1);
+
+    EXPECT_EQ(d.lookup(0x0a000001), 1);
+    EXPECT_EQ(d.lookup(0x0a010201), 2);
+    EXPECT_EQ(d.lookup(0x0a010281), 3);
+    EXPECT_EQ(d.lookup(0x0a0102c8), 4);
+    EXPECT_EQ(d.lookup(0x0b000000), std::nullopt);
+    EXPECT_EQ(d.find(ipv4_prefix("10.1.2.0/24")), 2);
+    EXPECT_EQ(d.find(ipv4_prefix("10.1.3.0/24")), std::nullopt);
+
+    // the /25 falls back to the /24 and the /32 keeps its entry.
+    EXPECT_TRUE(d.remove(ipv4_prefix("10.1.2.128/25")));
+    EXPECT_FALSE(d.remove(ipv4_prefix("10.1.2.128/25")));
+    EXPECT_EQ(d.lookup(0x0a010281), 2);
+    EXPECT_EQ(d.lookup(0x0a0102c8), 4);
+
+    // a shorter prefix does not override longer ones below it.
+    d.insert(ipv4_prefix("10.1.0.0/16"), 5);
+    EXPECT_EQ(d.lookup(0x0a010201), 2);
+    EXPECT_EQ(d.lookup(0x0a010301), 5);
+
+    // no prefix longer than /24 is left, the group goes back to tbl24.
+    EXPECT_TRUE(d.remove(ipv4_prefix("10.1.2.200/32")));
+    EXPECT_EQ(d.tbl8_groups(), 0);
+    EXPECT_EQ(d.lookup(0x0a0102c8), 2);
+    EXPECT_TRUE(d.remove(ipv4_prefix("10.1.2.0/24")));
+    EXPECT_EQ(d.lookup(0x0a0102c8), 5);
+}
+
+TEST(Dir24_8, SameAsTrie) {
+    std::mt19937 rng(8);
+    trie<uint32_t> bt;
+    std::vector<prefix<uint32_t>> inserted;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        // keep the prefixes close so that they nest.
+        uint32_t v = len ? (rng() & 0x0f0fffff) & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        bt.insert<uint32_t>({v, len}, i);
+        inserted.emplace_back(v, len);
+    }
+    std::sort(inserted.begin(), inserted.end(), [](const auto& a, const auto& b) {
+        return std::pair(a.v, a.len) < std::pair(b.v, b.len);
+    });
+    inserted.erase(std::unique(inserted.begin(), inserted.end()), inserted.end());
+
+    dir24_8<uint32_t> d(bt);
+    auto check = [&] {
+        for (const auto& p : inserted) {
+            EXPECT_EQ(d.find(p), bt.find(p)) << p.show();
+            EXPECT_EQ(d.lookup(p.v), bt.lookup(p.v)) << p.show();
+            EXPECT_EQ(d.lookup(p.v | 0xff), bt.lookup(p.v | 0xff)) << p.show();
+        }
+        for (int i = 0; i < 3000; i++) {
+            uint32_t key = rng() & 0x0f0fffff;
+            EXPECT_EQ(d.lookup(key), bt.lookup(key)) << key;
+        }
+    };
+    check();
+
+    // incremental updates, removals and re-inserts in random order.
+    std::shuffle(inserted.begin(), inserted.end(), rng);
+    for (size_t i = 0; i < inserted.size(); i += 2) {
+        EXPECT_TRUE(d.remove(inserted[i]));
+        bt.insert(inserted[i], 0u);
+    }
+    check();
+    for (size_t i = 0; i < inserted.size(); i += 4) {
+        d.insert(inserted[i], 7);
+        bt.insert(inserted[i], 7u);
+    }
+    check();
+
+    for (const auto& p : inserted) {
+        d.remove(p);
+    }
+    EXPECT_EQ(d.tbl8_groups(), 0);
+    EXPECT_EQ(d.lookup(0x0a000001), std::nullopt);
+}
+
+TEST(Dir24_8, ValueChurn) {
+    std::mt19937 rng(9);
+    std::vector<prefix<uint32_t>> prefixes;
+    for (int i = 0; i < 500; i++) {
+        uint8_t len = 16 + rng() % 17;
+        prefixes.emplace_back(rng() & ~((uint64_t(1) << (32 - len)) - 1), len);
+    }
+    std::sort(prefixes.begin(), prefixes.end(), [](const auto& a, const auto& b) {
+        return std::pair(a.v, a.len) < std::pair(b.v, b.len);
+    });
+    prefixes.erase(std::unique(prefixes.begin(), prefixes.end()), prefixes.end());
+
+    dir24_8<uint32_t> d;
+    trie<uint32_t> bt;
+    uint32_t next = 1;
+    for (const auto& p : prefixes) {
+        d.insert(p, next);
+        bt.insert(p, next++);
+    }
+    EXPECT_EQ(d.value_count(), prefixes.size());
+    size_t bytes = d.memory_usage();
+
+    // every next hop replaced by a fresh one, over and over, some prefixes
+    // withdrawn and some sharing a value.
+    for (int round = 0; round < 200; round++) {
+        for (const auto& p : prefixes) {
+            uint32_t value = rng() % 8 == 0 ? 0 : rng() % 8 == 0 ? 1 : next++;
+            d.insert(p, value);
+            bt.insert(p, value);
+        }
+    }
+    std::set<uint32_t> live;
+    for (auto [p, value] : bt.entries<uint32_t>()) {
+        live.insert(value);
+    }
+    EXPECT_EQ(d.value_count(), live.size());
+    // some 75000 values went through, the value table holds a few hundred.
+    EXPECT_GT(next, 70000u);
+    EXPECT_LT(d.memory_usage(), bytes + 4096);
+    for (const auto& p : prefixes) {
+        EXPECT_EQ(d.find(p).value_or(0), bt.find(p).value_or(0)) << p.show();
+        EXPECT_EQ(d.lookup(p.v), bt.lookup(p.v)) << p.show();
+    }
+
+    for (const auto& p : prefixes) {
+        d.remove(p);
+    }
+    EXPECT_EQ(d.value_count(), 0);
+}
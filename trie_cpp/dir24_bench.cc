@@ -0,0 +1,55 @@
+#include "bench_util.hh"
+#include "dir24_8.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+const dir24_8<uint32_t>& dir24_table() {
+    static const auto table = std::make_unique<dir24_8<uint32_t>>(build_table<trie<uint32_t>>());
+    return *table;
+}
+
+void BM_dir24_8_lookup(benchmark::State& state) {
+    const auto& table = dir24_table();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_prefix"] = double(table.memory_usage()) / table_size;
+    state.counters["tbl8_groups"] = table.tbl8_groups();
+}
+
+void BM_dir24_8_compile(benchmark::State& state) {
+    const auto& source = build_table<trie<uint32_t>>();
+    for (auto _ : state) {
+        dir24_8<uint32_t> d(source);
+        benchmark::DoNotOptimize(d.lookup(0));
+    }
+}
+
+// one route flap: a /24 and a /25 below it go away and come back.
+void BM_dir24_8_update(benchmark::State& state) {
+    auto table = std::make_unique<dir24_8<uint32_t>>();
+    for (const auto& p : random_prefixes(table_size)) {
+        table->insert(p, 1);
+    }
+    auto keys = random_keys(key_count, 3);
+    size_t i = 0;
+    for (auto _ : state) {
+        uint32_t k = keys[i++ & (key_count - 1)];
+        prefix<uint32_t> p24(k & 0xffffff00, 24), p25(k & 0xffffff80, 25);
+        table->insert(p24, 2);
+        table->insert(p25, 3);
+        table->remove(p25);
+        table->remove(p24);
+    }
+    state.SetItemsProcessed(state.iterations() * 4);
+}
+
+}
+
+BENCHMARK(BM_dir24_8_lookup);
+BENCHMARK(BM_dir24_8_compile)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_dir24_8_update);
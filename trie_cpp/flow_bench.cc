@@ -0,0 +1,83 @@
+#include "bench_util.hh"
+#include "flow_cache.hh"
+#include "hypercuts.hh"
+#include <benchmark/benchmark.h>
+#include <cmath>
+
+namespace {
+
+constexpr size_t rule_count = 10000;
+constexpr size_t flow_count = 1 << 17;
+constexpr size_t packet_count = 1 << 20;
+
+const std::vector<acl_rule>& rules() {
+    static const auto r = random_rules(rule_count);
+    return r;
+}
+
+const hypercuts& classifier() {
+    static const auto c = std::make_unique<hypercuts>(rules());
+    return *c;
+}
+
+// packets of flow_count flows with zipf-like popularity: flow ranks drawn
+// log-uniformly, so every doubling of the rank halves the packet share.
+const std::vector<five_tuple>& packets() {
+    static const auto p = [] {
+        auto flows = random_tuples(rules(), flow_count, 3);
+        std::mt19937 rng(4);
+        std::uniform_real_distribution<double> u(0, std::log(double(flow_count)));
+        std::vector<five_tuple> out(packet_count);
+        for (auto& t : out) {
+            t = flows[size_t(std::exp(u(rng))) - 1];
+        }
+        return out;
+    }();
+    return p;
+}
+
+void BM_flow_cache_classify(benchmark::State& state) {
+    const auto& c = classifier();
+    const auto& pkts = packets();
+    flow_cache cache(state.range(0));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.classify(pkts[i++ & (packet_count - 1)], c));
+    }
+    state.SetItemsProcessed(state.iterations());
+    const auto& s = cache.stats();
+    state.counters["hit_ratio"] = double(s.hits) / (s.hits + s.misses);
+    state.counters["evictions"] = s.evictions;
+}
+
+// the same packets without a cache.
+void BM_flow_cache_uncached(benchmark::State& state) {
+    const auto& c = classifier();
+    const auto& pkts = packets();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(c.classify(pkts[i++ & (packet_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// steady state hits: every packet's flow is cached.
+void BM_flow_cache_hit(benchmark::State& state) {
+    const auto& pkts = packets();
+    flow_cache cache(flow_count);
+    for (const auto& t : pkts) {
+        cache.insert(t, 0);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(cache.find(pkts[i++ & (packet_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_flow"] = double(cache.memory_usage()) / flow_count;
+}
+
+}
+
+BENCHMARK(BM_flow_cache_classify)->ArgName("capacity")->RangeMultiplier(8)->Range(1 << 10, 1 << 16);
+BENCHMARK(BM_flow_cache_uncached);
+BENCHMARK(BM_flow_cache_hit);
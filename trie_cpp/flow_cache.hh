@@ -0,0 +1,291 @@
+#ifndef FLOW_CACHE_HH
+#define FLOW_CACHE_HH
+
+#include "trie.hh"
+#include <IntrusiveList.h>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+#include <emmintrin.h>
+
+// Exact match cache of classification results keyed by the 5-tuple, to put
+// in front of an acl_rule classifier: the packets of a flow after the first
+// one cost a hash and a bucket probe instead of a classification.
+//
+// The table is a bucketized cuckoo hash (MemC3, DPDK rte_hash): every key has
+// two buckets of 8 slots, and every bucket keeps a 16-bit tag per slot so a
+// probe compares all 8 tags in one SSE2 instruction before touching a key. The
+// alternate bucket is derived from the bucket and the tag alone, so entries
+// are displaced without rehashing their key. The number of entries is bounded
+// by capacity; past it the least recently used entry is evicted, the LRU
+// order being an IntrusiveList through the slots.
+//
+// invalidate() drops every entry in O(1) by bumping the generation, stale
+// entries are freed as they are met. A flow_cache is not thread-safe, use one
+// per core.
+class flow_cache {
+public:
+    // rule stored for flows no rule matched.
+    static constexpr uint32_t no_match = std::numeric_limits<uint32_t>::max();
+    static constexpr size_t bucket_slots = 8;
+
+    struct counters {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    explicit flow_cache(size_t capacity) : cap{capacity} {
+        if (capacity == 0) {
+            throw std::invalid_argument("flow cache capacity must be positive");
+        }
+        // about 80% load at capacity, where 8-way cuckoo inserts rarely fail.
+        size_t buckets = std::bit_ceil(std::max<size_t>(2, (capacity * 5 / 4 + bucket_slots - 1) / bucket_slots));
+        mask = buckets - 1;
+        tags.assign(buckets, bucket_tags{});
+        slots.resize(buckets * bucket_slots);
+    }
+
+    flow_cache(const flow_cache&) = delete;
+    flow_cache& operator=(const flow_cache&) = delete;
+
+    // the cached rule of t, no_match included, and marks it recently used.
+    std::optional<uint32_t> find(const five_tuple& t) {
+        uint64_t h = hash(t);
+        uint16_t tag = tag_of(h);
+        size_t b1 = h & mask;
+        for (size_t b : {b1, alt(b1, tag)}) {
+            if (slot* s = probe(b, tag, t)) {
+                counts.hits++;
+                lru.erase(lru.iterator_to(*s));
+                lru.push_back(*s);
+                return s->rule;
+            }
+        }
+        counts.misses++;
+        return std::nullopt;
+    }
+
+    void insert(const five_tuple& t, uint32_t rule) {
+        uint64_t h = hash(t);
+        uint16_t tag = tag_of(h);
+        size_t b1 = h & mask;
+        size_t b2 = alt(b1, tag);
+        for (size_t b : {b1, b2}) {
+            if (slot* s = probe(b, tag, t)) {
+                s->rule = rule;
+                lru.erase(lru.iterator_to(*s));
+                lru.push_back(*s);
+                return;
+            }
+        }
+
+        if (count == cap) {
+            // after an invalidate() the oldest entry is likely stale, freeing
+            // it evicts nothing.
+            size_t oldest = slot_index(lru.front());
+            if (slots[oldest].generation != generation) {
+                release(oldest);
+            } else {
+                evict(oldest);
+            }
+        }
+        size_t i = free_slot(b1);
+        if (i == none) {
+            i = free_slot(b2);
+        }
+        if (i == none) {
+            i = make_room(b1, b2);
+        }
+        slot& s = slots[i];
+        s.key = t;
+        s.rule = rule;
+        s.generation = generation;
+        tags[i / bucket_slots].tag[i % bucket_slots] = tag;
+        lru.push_back(s);
+        count++;
+    }
+
+    // cached rule of t, classifying it with c on a miss.
+    template <typename Classifier>
+    std::optional<uint32_t> classify(const five_tuple& t, const Classifier& c) {
+        auto rule = find(t);
+        if (!rule) {
+            auto id = c.classify(t);
+            rule = id ? *id : no_match;
+            insert(t, *rule);
+        }
+        return *rule == no_match ? std::nullopt : rule;
+    }
+
+    // forgets every entry, for when the rules change.
+    void invalidate() {
+        generation++;
+    }
+
+    // entries held, stale ones not yet freed included.
+    size_t size() const {
+        return count;
+    }
+
+    size_t capacity() const {
+        return cap;
+    }
+
+    const counters& stats() const {
+        return counts;
+    }
+
+    size_t memory_usage() const {
+        return tags.capacity() * sizeof(bucket_tags) + slots.capacity() * sizeof(slot);
+    }
+
+private:
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+    // displacements tried before evicting from a full bucket pair.
+    static constexpr size_t max_path = 8;
+
+    struct slot {
+        five_tuple key{};
+        uint32_t rule = 0;
+        uint32_t generation = 0;
+        IntrusiveListHook lru_hook;
+    };
+
+    // tag 0 marks a free slot.
+    struct alignas(16) bucket_tags {
+        uint16_t tag[bucket_slots] = {};
+    };
+
+    using lru_list = IntrusiveList<slot, &slot::lru_hook>;
+
+    static uint64_t hash(const five_tuple& t) {
+        uint64_t h = (uint64_t(t.src) << 32 | t.dst) * 0x9e3779b97f4a7c15ull;
+        h ^= (uint64_t(t.src_port) << 24 | uint64_t(t.dst_port) << 8 | t.proto) * 0xff51afd7ed558ccdull;
+        return h ^ (h >> 29);
+    }
+
+    static uint16_t tag_of(uint64_t h) {
+        uint16_t tag = h >> 48;
+        return tag ? tag : 1;
+    }
+
+    size_t alt(size_t b, uint16_t tag) const {
+        return (b ^ (tag * 0x5bd1e995u)) & mask;
+    }
+
+    static bool same(const five_tuple& a, const five_tuple& b) {
+        return a.src == b.src && a.dst == b.dst && a.src_port == b.src_port && a.dst_port == b.dst_port &&
+               a.proto == b.proto;
+    }
+
+    // the live slot of bucket b holding t, freeing a stale one on the way.
+    slot* probe(size_t b, uint16_t tag, const five_tuple& t) {
+        __m128i eq = _mm_cmpeq_epi16(_mm_load_si128(reinterpret_cast<const __m128i*>(tags[b].tag)),
+                                     _mm_set1_epi16(int16_t(tag)));
+        unsigned hits = _mm_movemask_epi8(_mm_packs_epi16(eq, _mm_setzero_si128()));
+        for (; hits; hits &= hits - 1) {
+            size_t i = b * bucket_slots + std::countr_zero(hits);
+            slot& s = slots[i];
+            if (same(s.key, t)) {
+                if (s.generation != generation) {
+                    release(i);
+                    return nullptr;
+                }
+                return &s;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t slot_index(const slot& s) const {
+        return &s - slots.data();
+    }
+
+    // a free or stale slot of bucket b.
+    size_t free_slot(size_t b) {
+        for (size_t j = 0; j < bucket_slots; j++) {
+            size_t i = b * bucket_slots + j;
+            if (!tags[b].tag[j]) {
+                return i;
+            }
+            if (slots[i].generation != generation) {
+                release(i);
+                return i;
+            }
+        }
+        return none;
+    }
+
+    void release(size_t i) {
+        lru.erase(lru.iterator_to(slots[i]));
+        tags[i / bucket_slots].tag[i % bucket_slots] = 0;
+        count--;
+    }
+
+    void evict(size_t i) {
+        release(i);
+        counts.evictions++;
+    }
+
+    // frees a slot in b1 or b2 by moving entries along a random cuckoo path,
+    // evicting from b1 if no short path ends in a free slot.
+    size_t make_room(size_t b1, size_t b2) {
+        size_t path[max_path + 1];
+        size_t b = rng() & 1 ? b1 : b2;
+        for (size_t depth = 0; depth < max_path; depth++) {
+            size_t i = b * bucket_slots + rng() % bucket_slots;
+            if (std::find(path, path + depth, i) != path + depth) {
+                break;
+            }
+            path[depth] = i;
+            b = alt(b, tags[b].tag[i % bucket_slots]);
+            size_t to = free_slot(b);
+            if (to == none) {
+                continue;
+            }
+            // walk the path back, each entry moving into the slot freed by
+            // the one after it.
+            for (size_t k = depth + 1; k-- > 0;) {
+                move(path[k], to);
+                to = path[k];
+            }
+            return to;
+        }
+        size_t victim = b1 * bucket_slots + rng() % bucket_slots;
+        evict(victim);
+        return victim;
+    }
+
+    // moves the entry of slot from into the free slot to, keeping its place
+    // in the LRU order.
+    void move(size_t from, size_t to) {
+        slot& s = slots[from];
+        slot& d = slots[to];
+        d.key = s.key;
+        d.rule = s.rule;
+        d.generation = s.generation;
+        lru.insert(lru.iterator_to(s), d);
+        lru.erase(lru.iterator_to(s));
+        tags[to / bucket_slots].tag[to % bucket_slots] = tags[from / bucket_slots].tag[from % bucket_slots];
+        tags[from / bucket_slots].tag[from % bucket_slots] = 0;
+    }
+
+    size_t cap;
+    size_t mask = 0;
+    size_t count = 0;
+    uint32_t generation = 0;
+    counters counts;
+    std::vector<bucket_tags> tags;
+    std::vector<slot> slots;
+    // least recently used first, declared after slots to be destroyed first.
+    lru_list lru;
+    std::minstd_rand rng;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "flow_cache.hh"
+#include "hypercuts.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+five_tuple flow(uint32_t i) {
+    return {0x0a000000 | i, 0x08080808, uint16_t(1024 + i % 50000), 80, 6};
+}
+
+}
+
+TEST(FlowCache, Test1) {
+    flow_cache c(16);
+    EXPECT_EQ(c.find(flow(1)), std::nullopt);
+    c.insert(flow(1), 7);
+    c.insert(flow(2), flow_cache::no_match);
+    EXPECT_EQ(c.find(flow(1)), 7);
+    EXPECT_EQ(c.find(flow(2)), flow_cache::no_match);
+    c.insert(flow(1), 8);
+    EXPECT_EQ(c.find(flow(1)), 8);
+    EXPECT_EQ(c.size(), 2);
+    EXPECT_EQ(c.stats().hits, 3);
+    EXPECT_EQ(c.stats().misses, 1);
+    EXPECT_EQ(c.stats().evictions, 0);
+    EXPECT_THROW(flow_cache(0), std::invalid_argument);
+}
+
+TEST(FlowCache, Lru) {
+    flow_cache c(4);
+    for (uint32_t i = 0; i < 4; i++) {
+        c.insert(flow(i), i);
+    }
+    EXPECT_EQ(c.find(flow(0)), 0);
+    c.insert(flow(4), 4);
+    EXPECT_EQ(c.size(), 4);
+    EXPECT_EQ(c.stats().evictions, 1);
+    EXPECT_EQ(c.find(flow(1)), std::nullopt);
+    for (uint32_t i : {0, 2, 3, 4}) {
+        EXPECT_EQ(c.find(flow(i)), i);
+    }
+}
+
+TEST(FlowCache, Full) {
+    flow_cache c(4096);
+    for (uint32_t i = 0; i < 20000; i++) {
+        c.insert(flow(i), i);
+        ASSERT_LE(c.size(), c.capacity());
+    }
+    EXPECT_EQ(c.size(), c.capacity());
+    EXPECT_EQ(c.stats().evictions, 20000 - c.capacity());
+    size_t found = 0;
+    for (uint32_t i = 0; i < 20000; i++) {
+        auto rule = c.find(flow(i));
+        if (rule) {
+            EXPECT_EQ(*rule, i);
+            found++;
+        }
+    }
+    EXPECT_EQ(found, c.size());
+}
+
+TEST(FlowCache, Invalidate) {
+    flow_cache c(64);
+    for (uint32_t i = 0; i < 64; i++) {
+        c.insert(flow(i), i);
+    }
+    c.invalidate();
+    for (uint32_t i = 0; i < 32; i++) {
+        EXPECT_EQ(c.find(flow(i)), std::nullopt);
+    }
+    EXPECT_EQ(c.size(), 32);
+    for (uint32_t i = 0; i < 64; i++) {
+        c.insert(flow(i), i + 100);
+    }
+    EXPECT_EQ(c.size(), 64);
+    EXPECT_EQ(c.stats().evictions, 0);
+    for (uint32_t i = 0; i < 64; i++) {
+        EXPECT_EQ(c.find(flow(i)), i + 100);
+    }
+}
+
+TEST(FlowCache, InvalidateFull) {
+    flow_cache c(64);
+    for (uint32_t i = 0; i < 64; i++) {
+        c.insert(flow(i), i);
+    }
+    c.invalidate();
+    // other flows take the place of the stale entries, no live one goes.
+    for (uint32_t i = 64; i < 128; i++) {
+        c.insert(flow(i), i);
+    }
+    EXPECT_EQ(c.size(), 64);
+    EXPECT_EQ(c.stats().evictions, 0);
+    c.insert(flow(128), 128);
+    EXPECT_EQ(c.stats().evictions, 1);
+}
+
+TEST(FlowCache, SameAsClassifier) {
+    std::vector<acl_rule> rules = {
+        {"10.0.0.0/20", "0.0.0.0/0", "0-65535", "80-80", "6-6"},
+        {"10.0.0.0/8", "8.8.8.8/32", "1024-2047", "0-65535", "0-255"},
+        {"10.0.64.0/18", "0.0.0.0/0", "0-65535", "0-65535", "6-6"},
+    };
+    auto c1 = std::make_unique<hypercuts>(rules);
+    flow_cache c(1000);
+    std::mt19937 rng(1);
+    // few flows carry most of the packets.
+    std::geometric_distribution<uint32_t> flows(0.002);
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 50000; i++) {
+            five_tuple t = flow(flows(rng) & 0xfffff);
+            ASSERT_EQ(c.classify(t, *c1), c1->classify(t)) << t.show();
+        }
+        EXPECT_LE(c.size(), c.capacity());
+        rules.erase(rules.begin());
+        c1 = std::make_unique<hypercuts>(rules);
+        c.invalidate();
+    }
+    const auto& s = c.stats();
+    EXPECT_EQ(s.hits + s.misses, 100000);
+    EXPECT_GT(s.hits, s.misses);
+    EXPECT_GT(s.evictions, 0);
+}
@@ -0,0 +1,403 @@
+#ifndef HASH_LPM_HH
+#define HASH_LPM_HH
+
+#include "trie.hh"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Longest prefix match by binary search on prefix lengths (Waldvogel et al.,
+// "Scalable High Speed IP Routing Lookups"): one open addressing hash table
+// per prefix length in use, so a lookup costs about log2 of the number of
+// distinct lengths in probes, whatever the key width. That suits IPv6 tables,
+// 128-bit keys with a few dozen lengths.
+//
+// The search probes the middle length: a hit means a longer match may exist,
+// a miss that only shorter ones can. For a hit to mean that, every prefix
+// leaves a marker, its truncation, at each length the search probes on its
+// way to the prefix's own and goes longer from. Every entry, marker or real,
+// keeps the value of the longest real prefix covering it, so the search never
+// backtracks: the value of the last hit is the answer.
+//
+// With Bloom = true each length also has a blocked Bloom filter of the keys
+// of its table, the bits of a key all in one 64-bit word, checked before the
+// table: a miss in the filter skips the probe. Removed keys stay in the
+// filter until the table grows and the filter is rebuilt, costing only false
+// positives.
+//
+// Updates keep a trie<T> of the real prefixes: it gives the covering values
+// of the entries under a changed prefix, refreshed with one walk of its
+// subtree. A prefix of a new length, or the removal of the last one of a
+// length, changes the search order and rebuilds all markers.
+template <typename T, typename K = uint128_t, bool Bloom = false>
+class hash_lpm {
+public:
+    static_assert(std::is_unsigned_v<K>, "K must be unsigned");
+    static constexpr unsigned width = sizeof(K) * 8;
+
+    hash_lpm() {
+        std::fill(std::begin(level_of), std::end(level_of), no_level);
+    }
+
+    hash_lpm(const hash_lpm&) = delete;
+    hash_lpm& operator=(const hash_lpm&) = delete;
+
+    // sets the value of p, init_value<T>() removes it.
+    void insert(prefix<K> p, T value) {
+        bool was = has_info(rib.find(p).value_or(init_value<T>()));
+        bool now = has_info(value);
+        rib.insert(p, value);
+        if (!was && !now) {
+            return;
+        }
+        if (was != now) {
+            count[p.len] += now ? 1 : -1;
+            if (count[p.len] == (now ? 1 : 0)) {
+                rebuild();
+                return;
+            }
+        }
+        unsigned i = level_of[p.len];
+        if (now && !was) {
+            add(p, value);
+        } else if (!now) {
+            remove(p);
+        } else {
+            levels[i].get(p.v)->value = value;
+        }
+        const trie_node_base* n = &rib.root;
+        T best = rib.root.value;
+        for (unsigned d = 0; d < p.len; d++) {
+            n = bit(p.v, d) ? n->right.get() : n->left.get();
+            if (d + 1 < p.len && has_info(node_value(n))) {
+                best = node_value(n);
+            }
+        }
+        refresh(n, p, p.len ? best : init_value<T>());
+    }
+
+    // the whole table at once, as repeated insert() without the rebuilds.
+    void build(std::span<const std::pair<prefix<K>, T>> table) {
+        for (const auto& [p, value] : table) {
+            rib.insert(p, value);
+        }
+        std::fill(std::begin(count), std::end(count), 0);
+        for (const auto& [p, value] : rib.template entries<K>()) {
+            count[p.len]++;
+        }
+        rebuild();
+    }
+
+    std::optional<T> find(prefix<K> p) const {
+        if (level_of[p.len] == no_level) {
+            return std::nullopt;
+        }
+        const slot* s = levels[level_of[p.len]].get(p.v);
+        if (!s || !has_info(s->value)) {
+            return std::nullopt;
+        }
+        return s->value;
+    }
+
+    std::optional<T> lookup(K k) const {
+        T best = init_value<T>();
+        int lo = 0;
+        int hi = int(levels.size()) - 1;
+        while (lo <= hi) {
+            int mid = (lo + hi) / 2;
+            const level& l = levels[mid];
+            K v = k & l.mask;
+            uint64_t h = hash(v);
+            const slot* s = (!Bloom || l.may_contain(h)) ? l.get(v, h) : nullptr;
+            if (s) {
+                best = s->best;
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        if (!has_info(best)) {
+            return std::nullopt;
+        }
+        return best;
+    }
+
+    void dump(std::vector<prefix<K>>& prefixes) const {
+        rib.dump(prefixes);
+    }
+
+    // most probes a lookup makes.
+    size_t max_depth() const {
+        return std::bit_width(levels.size());
+    }
+
+    // distinct prefix lengths, each with its own table.
+    size_t length_count() const {
+        return levels.size();
+    }
+
+    // entries in the tables, markers included.
+    size_t entry_count() const {
+        size_t n = 0;
+        for (const auto& l : levels) {
+            n += l.used;
+        }
+        return n;
+    }
+
+    // bytes of the hash tables and filters, the trie kept for updates aside.
+    size_t memory_usage() const {
+        size_t bytes = levels.capacity() * sizeof(level);
+        for (const auto& l : levels) {
+            bytes += l.slots.capacity() * sizeof(slot) + l.bloom.capacity() * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+private:
+    struct slot {
+        K key;
+        // the value of the prefix when it is a real one.
+        T value;
+        // value of the longest real prefix covering key.
+        T best;
+        // markers left here, plus one for a real prefix; 0 is a free slot.
+        uint32_t refs;
+    };
+
+    struct level {
+        uint8_t len;
+        K mask;
+        size_t used = 0;
+        std::vector<slot> slots;
+        std::vector<uint64_t> bloom;
+
+        level(uint8_t len, size_t capacity) : len{len}, mask{mask_of(len)} {
+            resize(capacity);
+        }
+
+        size_t index(uint64_t h) const {
+            return h & (slots.size() - 1);
+        }
+
+        const slot* get(K k, uint64_t h) const {
+            for (size_t i = index(h);; i = (i + 1) & (slots.size() - 1)) {
+                const slot& s = slots[i];
+                if (!s.refs) {
+                    return nullptr;
+                }
+                if (s.key == k) {
+                    return &s;
+                }
+            }
+        }
+
+        const slot* get(K k) const {
+            return get(k, hash(k));
+        }
+
+        slot* get(K k) {
+            return const_cast<slot*>(std::as_const(*this).get(k, hash(k)));
+        }
+
+        // the slot of k, a fresh one with no refs if k is not there.
+        slot& get_or_add(K k) {
+            if (slot* s = get(k)) {
+                return *s;
+            }
+            if ((used + 1) * 2 > slots.size()) {
+                resize(slots.size() * 2);
+            }
+            uint64_t h = hash(k);
+            size_t i = index(h);
+            while (slots[i].refs) {
+                i = (i + 1) & (slots.size() - 1);
+            }
+            used++;
+            add_to_bloom(h);
+            slots[i] = slot{k, init_value<T>(), init_value<T>(), 0};
+            return slots[i];
+        }
+
+        // frees the slot of s, shifting back the ones of its probe run.
+        void erase(slot* s) {
+            size_t wrap = slots.size() - 1;
+            size_t hole = s - slots.data();
+            for (size_t i = (hole + 1) & wrap; slots[i].refs; i = (i + 1) & wrap) {
+                size_t home = index(hash(slots[i].key));
+                // moves back unless its home lies after the hole on the run.
+                if (((i - home) & wrap) >= ((i - hole) & wrap)) {
+                    slots[hole] = slots[i];
+                    hole = i;
+                }
+            }
+            slots[hole].refs = 0;
+            used--;
+        }
+
+        void resize(size_t capacity) {
+            std::vector<slot> old(capacity);
+            old.swap(slots);
+            if constexpr (Bloom) {
+                bloom.assign(capacity / 8, 0);
+            }
+            size_t wrap = slots.size() - 1;
+            for (const auto& s : old) {
+                if (s.refs) {
+                    uint64_t h = hash(s.key);
+                    size_t i = index(h);
+                    while (slots[i].refs) {
+                        i = (i + 1) & wrap;
+                    }
+                    slots[i] = s;
+                    add_to_bloom(h);
+                }
+            }
+        }
+
+        // two bits in one word picked by the high bits of the hash, the
+        // slot index uses the low ones. 8 bits a slot, 16 a key at least.
+        static uint64_t bloom_bits(uint64_t h) {
+            return uint64_t(1) << ((h >> 32) & 63) | uint64_t(1) << ((h >> 38) & 63);
+        }
+
+        size_t bloom_word(uint64_t h) const {
+            return (h >> 44) & (bloom.size() - 1);
+        }
+
+        void add_to_bloom(uint64_t h) {
+            if constexpr (Bloom) {
+                bloom[bloom_word(h)] |= bloom_bits(h);
+            }
+        }
+
+        bool may_contain(uint64_t h) const {
+            uint64_t b = bloom_bits(h);
+            return (bloom[bloom_word(h)] & b) == b;
+        }
+    };
+
+    static constexpr unsigned no_level = ~0u;
+    static constexpr size_t min_capacity = 8;
+
+    static bool has_info(const T& v) {
+        return v != init_value<T>();
+    }
+
+    static T node_value(const trie_node_base* n) {
+        return static_cast<const trie_node<T>*>(n)->value;
+    }
+
+    static K mask_of(unsigned len) {
+        return len ? K(~K(0) << (width - len)) : K(0);
+    }
+
+    static unsigned bit(K v, unsigned d) {
+        return (v >> (width - 1 - d)) & 1;
+    }
+
+    static uint64_t hash(K k) {
+        uint64_t h = uint64_t(k);
+        if constexpr (sizeof(K) > sizeof(uint64_t)) {
+            h ^= uint64_t(k >> 64) * 0x9e3779b97f4a7c15ull;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        return h ^ (h >> 33);
+    }
+
+    // calls f with the levels the search for level i goes longer from, the
+    // ones that need a marker of a prefix of level i.
+    template <typename F>
+    void markers(unsigned i, F f) {
+        int lo = 0;
+        int hi = int(levels.size()) - 1;
+        for (;;) {
+            int mid = (lo + hi) / 2;
+            if (unsigned(mid) == i) {
+                return;
+            }
+            if (unsigned(mid) < i) {
+                f(levels[mid]);
+                lo = mid + 1;
+            } else {
+                hi = mid - 1;
+            }
+        }
+    }
+
+    void add(prefix<K> p, T value) {
+        unsigned i = level_of[p.len];
+        slot& s = levels[i].get_or_add(p.v);
+        s.value = value;
+        s.refs++;
+        markers(i, [&](level& l) {
+            l.get_or_add(p.v & l.mask).refs++;
+        });
+    }
+
+    void remove(prefix<K> p) {
+        unsigned i = level_of[p.len];
+        slot* s = levels[i].get(p.v);
+        s->value = init_value<T>();
+        if (!--s->refs) {
+            levels[i].erase(s);
+        }
+        markers(i, [&](level& l) {
+            slot* m = l.get(p.v & l.mask);
+            if (!--m->refs) {
+                l.erase(m);
+            }
+        });
+    }
+
+    // sets best of the entries in the subtree of n, the node of p, best
+    // being the value of the longest real prefix above p.
+    void refresh(const trie_node_base* n, prefix<K> p, T best) {
+        if (has_info(node_value(n))) {
+            best = node_value(n);
+        }
+        if (level_of[p.len] != no_level) {
+            if (slot* s = levels[level_of[p.len]].get(p.v)) {
+                s->best = best;
+            }
+        }
+        if (p.len == width) {
+            return;
+        }
+        if (n->left) {
+            refresh(n->left.get(), prefix<K>(p.v, p.len + 1), best);
+        }
+        if (n->right) {
+            refresh(n->right.get(), prefix<K>(K(p.v | K(1) << (width - 1 - p.len)), p.len + 1), best);
+        }
+    }
+
+    void rebuild() {
+        levels.clear();
+        std::fill(std::begin(level_of), std::end(level_of), no_level);
+        for (unsigned len = 0; len <= width; len++) {
+            if (count[len]) {
+                level_of[len] = levels.size();
+                levels.emplace_back(len, std::max(min_capacity, std::bit_ceil(size_t(count[len]) * 2)));
+            }
+        }
+        for (const auto& [p, value] : rib.template entries<K>()) {
+            add(p, value);
+        }
+        refresh(&rib.root, prefix<K>(0, 0), init_value<T>());
+    }
+
+    // the real prefixes, for updates.
+    trie<T> rib;
+    std::vector<level> levels;
+    unsigned level_of[width + 1];
+    uint32_t count[width + 1] = {};
+};
+
+#endif
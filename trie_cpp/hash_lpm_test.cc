@@ -0,0 +1,99 @@
+#include "hash_lpm.hh"
+#include "test_util.hh"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(HashLpm, Test1) {
+    hash_lpm<uint32_t> h;
+    h.insert(ipv6_prefix("2001:db8::/32"), 1);
+    h.insert(ipv6_prefix("2001:db8:1::/48"), 2);
+    h.insert(ipv6_prefix("2001:db8:1:2::1/128"), 3);
+
+    EXPECT_EQ(h.find(ipv6_prefix("2001:db8::/32")), 1);
+    EXPECT_EQ(h.find(ipv6_prefix("2001:db8:1::/48")), 2);
+    EXPECT_EQ(h.find(ipv6_prefix("2001:db8::/47")), std::nullopt);
+
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db8:1:2::1/128").v), 3);
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db8:1:2::2/128").v), 2);
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db8:2::/128").v), 1);
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db9::/128").v), std::nullopt);
+
+    // three lengths, two probes at the most; the /48 search starts there, the
+    // /128 one leaves a marker at the /48.
+    EXPECT_EQ(h.length_count(), 3);
+    EXPECT_EQ(h.max_depth(), 2);
+    EXPECT_EQ(h.entry_count(), 3);
+
+    // a marker alone matches nothing.
+    h.insert(ipv6_prefix("2001:db8:1::/48"), 0);
+    EXPECT_EQ(h.find(ipv6_prefix("2001:db8:1::/48")), std::nullopt);
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db8:1:2::1/128").v), 3);
+    EXPECT_EQ(h.lookup(ipv6_prefix("2001:db8:1:2::2/128").v), 1);
+
+    std::vector<prefix<uint128_t>> prefixes;
+    h.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::UnorderedElementsAre(ipv6_prefix("2001:db8::/32"),
+                                                        ipv6_prefix("2001:db8:1:2::1/128")));
+}
+
+template <typename K, bool Bloom>
+void same_as_trie(int n, unsigned seed) {
+    constexpr unsigned width = sizeof(K) * 8;
+    lpm_differential<K> d(seed);
+    // a handful of lengths, as in real tables, and a few odd ones.
+    std::vector<uint8_t> lengths = {0, uint8_t(width / 4), uint8_t(width / 2), uint8_t(width * 3 / 4), uint8_t(width)};
+    for (int i = 0; i < 6; i++) {
+        lengths.push_back(d.rng() % (width + 1));
+    }
+
+    hash_lpm<uint32_t, K, Bloom> h;
+    for (int i = 1; i <= n; i++) {
+        // updates and removals of prefixes already there a fifth of the time.
+        if (i % 5 == 0) {
+            auto p = d.inserted[d.rng() % d.inserted.size()];
+            d.update(h, p, d.rng() % 2 ? 0 : i);
+            continue;
+        }
+        // cluster half of the prefixes to get nested ones.
+        d.insert(h, d.random_prefix(lengths[d.rng() % lengths.size()], i & 1), i);
+        if (i % 500 == 0) {
+            d.check(h, 1000);
+        }
+    }
+    d.check(h, 1000);
+
+    // every prefix of a length gone, the search order changes.
+    uint8_t gone = lengths[1];
+    for (const auto& p : d.inserted) {
+        if (p.len == gone) {
+            d.update(h, p, 0);
+        }
+    }
+    d.check(h, 1000);
+    d.check_dump(h);
+
+    // the same table built at once.
+    std::vector<std::pair<prefix<K>, uint32_t>> table;
+    for (const auto& [p, value] : d.reference.template entries<K>()) {
+        table.emplace_back(p, value);
+    }
+    hash_lpm<uint32_t, K, Bloom> built;
+    built.build(table);
+    EXPECT_EQ(built.entry_count(), h.entry_count());
+    d.check(built, 1000);
+}
+
+TEST(HashLpm, SameAsTrie32) {
+    same_as_trie<uint32_t, false>(5000, 1);
+}
+
+TEST(HashLpm, SameAsTrie128) {
+    same_as_trie<uint128_t, false>(5000, 2);
+}
+
+TEST(HashLpm, Bloom) {
+    same_as_trie<uint32_t, true>(5000, 3);
+    same_as_trie<uint128_t, true>(5000, 4);
+}
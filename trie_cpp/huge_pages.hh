@@ -0,0 +1,128 @@
+#ifndef HUGE_PAGES_HH
+#define HUGE_PAGES_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+
+// Memory for large lookup tables on 2M pages. A table of a million prefixes
+// spreads its nodes over hundreds of megabytes, far more 4K pages than the
+// dTLB covers, and random lookups pay a page walk on most node loads; one
+// 2M TLB entry covers 512 4K ones.
+//
+// huge_page_map() first asks for pages of the hugetlbfs pool (MAP_HUGETLB),
+// which only exist if the admin reserved some (vm.nr_hugepages). Failing
+// that it maps 2M aligned memory and asks for transparent huge pages with
+// madvise(MADV_HUGEPAGE). Failing both, the memory is plain 4K pages.
+// huge_page_stats() counts which of these every mapping got.
+//
+// Only hugetlb is a guarantee. thp_requested means the advice was taken, not
+// that any 2M page backs the range: the kernel uses them when THP is in
+// "always" or "madvise" mode and it finds free 2M frames at fault time, and
+// may split them later. AnonHugePages in /proc/self/smaps tells what it did.
+enum class page_backing { plain, thp_requested, hugetlb };
+
+constexpr size_t huge_page_size = size_t(2) << 20;
+
+struct huge_page_counters {
+    std::atomic<uint64_t> hugetlb{0};
+    std::atomic<uint64_t> thp_requested{0};
+    std::atomic<uint64_t> plain{0};
+    // bytes mapped now, all backings.
+    std::atomic<uint64_t> bytes{0};
+};
+
+inline huge_page_counters& huge_page_stats() {
+    static huge_page_counters counters;
+    return counters;
+}
+
+inline size_t huge_page_round(size_t bytes) {
+    return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+}
+
+// maps bytes rounded up to 2M, zero filled. Throws std::bad_alloc when even
+// 4K pages cannot be had.
+inline void* huge_page_map(size_t bytes, page_backing* got = nullptr) {
+    size_t len = huge_page_round(bytes);
+    auto& stats = huge_page_stats();
+    page_backing backing = page_backing::hugetlb;
+    void* p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+        // 2M more to cut an aligned range out of, THP only backs aligned
+        // 2M ranges.
+        void* raw = mmap(nullptr, len + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uintptr_t start = uintptr_t(raw);
+        uintptr_t aligned = (start + huge_page_size - 1) & ~uintptr_t(huge_page_size - 1);
+        if (aligned > start) {
+            munmap(raw, aligned - start);
+        }
+        munmap(reinterpret_cast<void*>(aligned + len), start + huge_page_size - aligned);
+        p = reinterpret_cast<void*>(aligned);
+        backing = madvise(p, len, MADV_HUGEPAGE) == 0 ? page_backing::thp_requested : page_backing::plain;
+    }
+    switch (backing) {
+    case page_backing::hugetlb:
+        stats.hugetlb++;
+        break;
+    case page_backing::thp_requested:
+        stats.thp_requested++;
+        break;
+    default:
+        stats.plain++;
+    }
+    stats.bytes += len;
+    if (got) {
+        *got = backing;
+    }
+    return p;
+}
+
+inline void huge_page_unmap(void* p, size_t bytes) {
+    size_t len = huge_page_round(bytes);
+    munmap(p, len);
+    huge_page_stats().bytes -= len;
+}
+
+// std allocator putting blocks of huge_page_min_bytes and more on 2M pages,
+// for the node storage of slab_trie and hypercuts. Smaller blocks come from
+// operator new: a 2M mapping for each would waste more than it saves.
+template <typename T>
+class huge_page_allocator {
+public:
+    using value_type = T;
+    static constexpr size_t huge_page_min_bytes = huge_page_size / 2;
+
+    huge_page_allocator() = default;
+
+    template <typename U>
+    huge_page_allocator(const huge_page_allocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n * sizeof(T) < huge_page_min_bytes) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(huge_page_map(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        if (n * sizeof(T) < huge_page_min_bytes) {
+            std::allocator<T>().deallocate(p, n);
+        } else {
+            huge_page_unmap(p, n * sizeof(T));
+        }
+    }
+
+    template <typename U>
+    bool operator==(const huge_page_allocator<U>&) const {
+        return true;
+    }
+};
+
+#endif
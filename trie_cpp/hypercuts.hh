@@ -0,0 +1,439 @@
+#ifndef HYPERCUTS_HH
+#define HYPERCUTS_HH
+
+#include "classifier.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <optional>
+#include <span>
+#include <vector>
+
+// HyperCuts (Singh, Baboescu, Varghese, Wang) decision tree classifier.
+//
+// Every node covers a box of the field space and cuts it along one or more
+// dimensions at once into 2^bits equal slices per dimension; a rule is copied
+// into every child its box overlaps. The tree stops at leaves of at most
+// binth rules, which are scanned in priority order. Boxes stay aligned to
+// their power of two size, so a child index is a handful of shifts and masks
+// of the packet fields.
+//
+// Cut selection: the dimensions with at least the mean number of distinct
+// rule projections are cut, each as finely as the space factor allows, and
+// the combined cut is held to spfac * rules copies plus children and to
+// spfac * sqrt(rules) children. Also from the paper: rules behind one that
+// covers a whole box are dropped, and children ending in leaves with the same
+// rules share one leaf.
+//
+// Rules wildcarding an address get copied into every slice of that address,
+// and copies multiply level after level. As in EffiCuts (Vamanan et al.),
+// rules are therefore split by which of src and dst cover more than half of
+// their space, with one tree per group. A lookup walks the trees in the order
+// of their highest priority rule and skips those that cannot beat the best
+// match found so far.
+//
+// Alloc is the allocator of the node and child arrays, huge_page_allocator
+// puts large trees on 2M pages.
+template <template <typename> class Alloc = std::allocator>
+class basic_hypercuts {
+public:
+    explicit basic_hypercuts(const std::vector<acl_rule>& rules, size_t binth = 8, double spfac = 4.0)
+        : binth{std::max<size_t>(binth, 1)}, spfac{std::max(spfac, 1.0)} {
+        boxes.reserve(rules.size());
+        for (const auto& r : rules) {
+            boxes.emplace_back(r);
+        }
+        // node 0 is the empty leaf every empty child points to.
+        nodes.push_back(node{});
+
+        region all;
+        for (size_t d = 0; d < acl_fields; d++) {
+            all.lo[d] = 0;
+            all.w[d] = acl_field_bits[d];
+        }
+        std::vector<uint32_t> groups[4];
+        for (uint32_t i = 0; i < rules.size(); i++) {
+            groups[(large(boxes[i], 0) ? 1 : 0) | (large(boxes[i], 1) ? 2 : 0)].push_back(i);
+        }
+        for (auto& ids : groups) {
+            if (!ids.empty()) {
+                uint32_t first_id = ids.front();
+                trees.push_back({build(all, std::move(ids), 0), first_id});
+            }
+        }
+        std::sort(trees.begin(), trees.end(), [](const auto& a, const auto& b) {
+            return a.first_id < b.first_id;
+        });
+    }
+
+    basic_hypercuts(const basic_hypercuts&) = delete;
+    basic_hypercuts& operator=(const basic_hypercuts&) = delete;
+
+    // id of the highest priority rule matching t.
+    std::optional<uint32_t> classify(const five_tuple& t) const {
+        acl_point f = tuple_fields(t);
+        uint32_t best = no_rule;
+        for (const auto& tr : trees) {
+            if (tr.first_id >= best) {
+                break;
+            }
+            uint32_t n = tr.root;
+            while (nodes[n].cut_bits) {
+                n = children[nodes[n].first + child_index(nodes[n], f)];
+            }
+            best = match_leaf(nodes[n], f, best);
+        }
+        return best == no_rule ? std::nullopt : std::optional<uint32_t>(best);
+    }
+
+    // classify() for a burst of packets. In every tree the walks advance one
+    // level at a time in lockstep and the next node of every walk is
+    // prefetched, like trie<T>::lookup_batch().
+    void classify_batch(std::span<const five_tuple> tuples, std::span<std::optional<uint32_t>> ids) const {
+        if (ids.size() < tuples.size()) {
+            throw std::invalid_argument(fmt::format("batch output too small {} < {}", ids.size(), tuples.size()));
+        }
+
+        for (size_t base = 0; base < tuples.size(); base += batch_group) {
+            size_t n = std::min(batch_group, tuples.size() - base);
+            uint32_t best[batch_group];
+            acl_point fields[batch_group];
+            for (size_t i = 0; i < n; i++) {
+                best[i] = no_rule;
+                fields[i] = tuple_fields(tuples[base + i]);
+            }
+
+            for (const auto& tr : trees) {
+                uint32_t curr[batch_group];
+                uint8_t lanes[batch_group];
+                size_t active = 0;
+                for (size_t i = 0; i < n; i++) {
+                    if (tr.first_id < best[i]) {
+                        curr[i] = tr.root;
+                        lanes[active++] = i;
+                    }
+                }
+
+                while (active) {
+                    size_t still = 0;
+                    for (size_t l = 0; l < active; l++) {
+                        uint8_t i = lanes[l];
+                        const node& nd = nodes[curr[i]];
+                        if (!nd.cut_bits) {
+                            best[i] = match_leaf(nd, fields[i], best[i]);
+                            continue;
+                        }
+                        uint32_t next = children[nd.first + child_index(nd, fields[i])];
+                        __builtin_prefetch(&nodes[next]);
+                        curr[i] = next;
+                        lanes[still++] = i;
+                    }
+                    active = still;
+                }
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                ids[base + i] = best[i] == no_rule ? std::nullopt : std::optional<uint32_t>(best[i]);
+            }
+        }
+    }
+
+    size_t tree_count() const {
+        return trees.size();
+    }
+
+    size_t node_count() const {
+        return nodes.size();
+    }
+
+    size_t max_depth() const {
+        return depth;
+    }
+
+    size_t memory_usage() const {
+        return nodes.capacity() * sizeof(node) + children.capacity() * sizeof(uint32_t) +
+               leaf_rules.capacity() * sizeof(uint32_t) + boxes.capacity() * sizeof(acl_box);
+    }
+
+private:
+    static constexpr uint32_t no_rule = std::numeric_limits<uint32_t>::max();
+
+    struct tree {
+        uint32_t root;
+        // highest priority rule of the tree.
+        uint32_t first_id;
+    };
+
+    struct node {
+        // internal: first child in children, leaf: first rule in leaf_rules.
+        uint32_t first = 0;
+        uint32_t count = 0;
+        uint8_t cut_bits = 0;
+        uint8_t shift[acl_fields] = {};
+        uint8_t bits[acl_fields] = {};
+        uint8_t offset[acl_fields] = {};
+    };
+
+    // lo is aligned to the box size 2^w in every dimension.
+    struct region {
+        acl_point lo;
+        uint8_t w[acl_fields];
+
+        uint32_t hi(size_t d) const {
+            return uint32_t(lo[d] + ((uint64_t(1) << w[d]) - 1));
+        }
+    };
+
+    static uint32_t child_index(const node& n, const acl_point& f) {
+        uint32_t idx = 0;
+        for (size_t d = 0; d < acl_fields; d++) {
+            idx |= ((f[d] >> n.shift[d]) & ((1u << n.bits[d]) - 1)) << n.offset[d];
+        }
+        return idx;
+    }
+
+    // the first rule of the leaf matching f if it beats best, else best.
+    uint32_t match_leaf(const node& n, const acl_point& f, uint32_t best) const {
+        for (uint32_t i = n.first; i < n.first + n.count; i++) {
+            uint32_t id = leaf_rules[i];
+            if (id >= best) {
+                break;
+            }
+            if (boxes[id].match(f)) {
+                return id;
+            }
+        }
+        return best;
+    }
+
+    // the rule covers more than half of the field.
+    static bool large(const acl_box& b, size_t d) {
+        return b.hi[d] - b.lo[d] >= (uint64_t(1) << (acl_field_bits[d] - 1));
+    }
+
+    bool covers(const acl_box& b, const region& r) const {
+        for (size_t d = 0; d < acl_fields; d++) {
+            if (b.lo[d] > r.lo[d] || b.hi[d] < r.hi(d)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // rules behind one covering the whole box can never match in it.
+    void drop_shadowed(const region& r, std::vector<uint32_t>& ids) const {
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (covers(boxes[ids[i]], r)) {
+                ids.resize(i + 1);
+                return;
+            }
+        }
+    }
+
+    uint32_t make_leaf(const std::vector<uint32_t>& ids) {
+        if (ids.empty()) {
+            return 0;
+        }
+        node n;
+        n.first = leaf_rules.size();
+        n.count = ids.size();
+        leaf_rules.insert(leaf_rules.end(), ids.begin(), ids.end());
+        nodes.push_back(n);
+        return nodes.size() - 1;
+    }
+
+    // slices of a dimension cut into 2^b that the rule overlaps, the first
+    // and the last one.
+    std::pair<uint32_t, uint32_t> slices(const acl_box& b, const region& r, size_t d, unsigned bits) const {
+        unsigned s = r.w[d] - bits;
+        uint32_t lo = std::max(b.lo[d], r.lo[d]) - r.lo[d];
+        uint32_t hi = std::min(b.hi[d], r.hi(d)) - r.lo[d];
+        return {lo >> s, hi >> s};
+    }
+
+    uint32_t build(const region& r, std::vector<uint32_t> ids, unsigned level) {
+        depth = std::max<size_t>(depth, level);
+
+        drop_shadowed(r, ids);
+        if (ids.size() <= binth) {
+            return make_leaf(ids);
+        }
+
+        uint8_t bits[acl_fields] = {};
+        if (!choose_cuts(r, ids, bits)) {
+            return make_leaf(ids);
+        }
+
+        unsigned total = 0;
+        uint8_t shift[acl_fields], offset[acl_fields];
+        for (size_t d = 0; d < acl_fields; d++) {
+            shift[d] = bits[d] ? r.w[d] - bits[d] : 0;
+            offset[d] = total;
+            total += bits[d];
+        }
+
+        // spread the rules over the children, each list stays in priority order.
+        std::vector<std::vector<uint32_t>> lists(size_t(1) << total);
+        for (uint32_t id : ids) {
+            uint32_t first[acl_fields], last[acl_fields], at[acl_fields];
+            for (size_t d = 0; d < acl_fields; d++) {
+                std::tie(first[d], last[d]) = bits[d] ? slices(boxes[id], r, d, bits[d]) : std::pair<uint32_t, uint32_t>(0, 0);
+                at[d] = first[d];
+            }
+            while (true) {
+                uint32_t idx = 0;
+                for (size_t d = 0; d < acl_fields; d++) {
+                    idx |= at[d] << offset[d];
+                }
+                lists[idx].push_back(id);
+                size_t d = 0;
+                for (; d < acl_fields; d++) {
+                    if (at[d] < last[d]) {
+                        at[d]++;
+                        break;
+                    }
+                    at[d] = first[d];
+                }
+                if (d == acl_fields) {
+                    break;
+                }
+            }
+        }
+        if (std::all_of(lists.begin(), lists.end(), [&](const auto& l) { return l.size() == ids.size(); })) {
+            return make_leaf(ids);
+        }
+
+        uint32_t self = nodes.size();
+        nodes.push_back(node{});
+        uint32_t first = children.size();
+        children.resize(children.size() + lists.size());
+
+        // leaves are scanned whole, so children ending in the same rules can
+        // share one; a subtree depends on its box and cannot be shared.
+        std::map<std::vector<uint32_t>, uint32_t> leaves;
+        for (uint32_t idx = 0; idx < lists.size(); idx++) {
+            region c;
+            for (size_t d = 0; d < acl_fields; d++) {
+                uint32_t slice = (idx >> offset[d]) & ((1u << bits[d]) - 1);
+                c.w[d] = r.w[d] - bits[d];
+                c.lo[d] = r.lo[d] + uint32_t(uint64_t(slice) << c.w[d]);
+            }
+            drop_shadowed(c, lists[idx]);
+            uint32_t child;
+            if (lists[idx].size() <= binth) {
+                auto [it, inserted] = leaves.emplace(std::move(lists[idx]), 0);
+                if (inserted) {
+                    it->second = make_leaf(it->first);
+                }
+                child = it->second;
+            } else {
+                child = build(c, std::move(lists[idx]), level + 1);
+            }
+            children[first + idx] = child;
+        }
+
+        node& n = nodes[self];
+        n.first = first;
+        n.cut_bits = total;
+        std::copy_n(shift, acl_fields, n.shift);
+        std::copy_n(bits, acl_fields, n.bits);
+        std::copy_n(offset, acl_fields, n.offset);
+        return self;
+    }
+
+    bool choose_cuts(const region& r, const std::vector<uint32_t>& ids, uint8_t* bits) const {
+        size_t distinct[acl_fields] = {};
+        size_t candidates = 0, sum = 0;
+        for (size_t d = 0; d < acl_fields; d++) {
+            if (r.w[d] == 0) {
+                continue;
+            }
+            std::vector<std::pair<uint32_t, uint32_t>> proj;
+            proj.reserve(ids.size());
+            for (uint32_t id : ids) {
+                proj.emplace_back(std::max(boxes[id].lo[d], r.lo[d]), std::min(boxes[id].hi[d], r.hi(d)));
+            }
+            std::sort(proj.begin(), proj.end());
+            distinct[d] = std::unique(proj.begin(), proj.end()) - proj.begin();
+            if (distinct[d] > 1) {
+                candidates++;
+                sum += distinct[d];
+            }
+        }
+        if (!candidates) {
+            return false;
+        }
+
+        double budget = spfac * ids.size();
+        for (size_t d = 0; d < acl_fields; d++) {
+            if (distinct[d] <= 1 || distinct[d] * candidates < sum) {
+                continue;
+            }
+            bits[d] = 1;
+            for (unsigned b = 2; b <= std::min<unsigned>(r.w[d], max_cut_bits); b++) {
+                double cost = double(uint64_t(1) << b);
+                for (uint32_t id : ids) {
+                    auto [lo, hi] = slices(boxes[id], r, d, b);
+                    cost += hi - lo + 1;
+                }
+                if (cost > budget) {
+                    break;
+                }
+                bits[d] = b;
+            }
+        }
+
+        // the combined cut is held to the same budget, coarsened one bit at
+        // a time in its finest dimension.
+        unsigned limit = std::clamp<unsigned>(std::log2(spfac * std::sqrt(double(ids.size()))), 1, max_cut_bits);
+        while (true) {
+            unsigned total = 0;
+            size_t widest = 0;
+            for (size_t d = 0; d < acl_fields; d++) {
+                total += bits[d];
+                widest = bits[d] > bits[widest] ? d : widest;
+            }
+            if (total == 0) {
+                return false;
+            }
+            if (total <= limit && copies(r, ids, bits) + (uint64_t(1) << total) <= budget) {
+                return true;
+            }
+            bits[widest]--;
+        }
+    }
+
+    // rule copies over all the children of a cut.
+    uint64_t copies(const region& r, const std::vector<uint32_t>& ids, const uint8_t* bits) const {
+        uint64_t total = 0;
+        for (uint32_t id : ids) {
+            uint64_t c = 1;
+            for (size_t d = 0; d < acl_fields; d++) {
+                if (bits[d]) {
+                    auto [lo, hi] = slices(boxes[id], r, d, bits[d]);
+                    c *= hi - lo + 1;
+                }
+            }
+            total += c;
+        }
+        return total;
+    }
+
+    static constexpr size_t batch_group = 16;
+    static constexpr unsigned max_cut_bits = 16;
+
+    size_t binth;
+    double spfac;
+    std::vector<acl_box> boxes;
+    std::vector<node, Alloc<node>> nodes;
+    std::vector<uint32_t, Alloc<uint32_t>> children;
+    std::vector<uint32_t> leaf_rules;
+    std::vector<tree> trees;
+    size_t depth = 0;
+};
+
+using hypercuts = basic_hypercuts<>;
+
+#endif
@@ -0,0 +1,60 @@
+#include "bench_util.hh"
+#include "hash_lpm.hh"
+#include "lc_trie.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+constexpr size_t ipv6_table_size = 1 << 18;
+
+template <typename Table>
+const Table& build_ipv6_table() {
+    static const auto table = [] {
+        auto t = std::make_unique<Table>();
+        uint32_t value = 1;
+        for (const auto& p : random_ipv6_prefixes(ipv6_table_size)) {
+            t->insert(p, value++);
+        }
+        return t;
+    }();
+    return *table;
+}
+
+template <typename Table>
+void BM_ipv6_lookup(benchmark::State& state) {
+    const Table& table = build_ipv6_table<Table>();
+    auto keys = random_ipv6_keys(random_ipv6_prefixes(ipv6_table_size), key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["max_depth"] = table.max_depth();
+}
+
+// a full-size BGP-like IPv4 table, dense enough that level compression takes
+// the top of the trie to max_bits wide nodes holding every short prefix.
+template <typename Table>
+void BM_ipv4_lookup(benchmark::State& state) {
+    const Table& table = build_table<Table>();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["max_depth"] = table.max_depth();
+    if constexpr (requires { table.memory_usage(); }) {
+        state.counters["bytes"] = table.memory_usage();
+    }
+}
+
+}
+
+BENCHMARK_TEMPLATE(BM_ipv4_lookup, trie<uint32_t>);
+BENCHMARK_TEMPLATE(BM_ipv4_lookup, lc_trie<uint32_t, uint32_t>);
+
+BENCHMARK_TEMPLATE(BM_ipv6_lookup, trie<uint32_t>);
+BENCHMARK_TEMPLATE(BM_ipv6_lookup, lc_trie<uint32_t>);
+BENCHMARK_TEMPLATE(BM_ipv6_lookup, hash_lpm<uint32_t>);
+BENCHMARK_TEMPLATE(BM_ipv6_lookup, hash_lpm<uint32_t, uint128_t, true>);
@@ -0,0 +1,357 @@
+#ifndef LC_TRIE_HH
+#define LC_TRIE_HH
+
+#include "trie.hh"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Path and level compressed trie (Nilsson-Karlsson LC-trie made dynamic, in
+// the spirit of the Linux fib_trie) for wide keys such as IPv6.
+//
+// A node stands for the key prefix (key, len) and branches on the next `bits`
+// key bits into 2^bits children. Path compression: a child only exists where
+// the keys below actually diverge, so single-child chains are skipped and the
+// child's len can be far below its parent's branch point. Level compression:
+// once every slot of a node is in use the node doubles its branching factor,
+// absorbing the level below it, so dense regions are crossed in one step.
+// Prefixes ending inside a node's branch bits are kept in its entries list,
+// and every slot records the longest of them covering it (controlled prefix
+// expansion over an index), so a lookup does constant work per node.
+
+template <typename K>
+struct lc_key {
+    static_assert(std::is_unsigned_v<K>, "K must be unsigned");
+    static constexpr unsigned width = sizeof(K) * 8;
+
+    static K mask(unsigned len) {
+        return len == 0 ? K(0) : K(~K(0) << (width - len));
+    }
+
+    // n bits of k starting at bit pos, counted from the most significant bit.
+    static unsigned extract(K k, unsigned pos, unsigned n) {
+        return n == 0 ? 0 : unsigned(K(k << pos) >> (width - n));
+    }
+
+    // length of the common prefix of a and b, capped to limit.
+    static unsigned common(K a, K b, unsigned limit) {
+        K diff = a ^ b;
+        unsigned c = 0;
+        if constexpr (sizeof(K) > sizeof(uint64_t)) {
+            uint64_t hi = uint64_t(diff >> 64);
+            c = hi ? __builtin_clzll(hi) : (uint64_t(diff) ? 64 + __builtin_clzll(uint64_t(diff)) : width);
+        } else {
+            c = diff ? __builtin_clzll(uint64_t(diff)) - (64 - width) : width;
+        }
+        return std::min(c, limit);
+    }
+};
+
+template <typename T, typename K>
+struct lc_node {
+    struct entry {
+        K v;
+        uint8_t len;
+        T value;
+    };
+
+    K key;
+    uint8_t len;
+    uint8_t bits = 0;
+    uint32_t filled = 0;
+    std::vector<entry> entries;
+    std::unique_ptr<std::unique_ptr<lc_node>[]> children;
+    // per slot, the index of the longest entry covering it. Only allocated
+    // once a branching node has entries.
+    std::unique_ptr<uint32_t[]> slot_entry;
+
+    static constexpr uint32_t no_entry = UINT32_MAX;
+
+    lc_node(K key, uint8_t len) : key{key}, len{len} {}
+
+    // prefixes of length [len, entry_limit()) are stored in this node.
+    unsigned entry_limit() const {
+        return len + std::max<unsigned>(bits, 1);
+    }
+
+    size_t slots() const {
+        return bits ? size_t(1) << bits : 0;
+    }
+
+    void set_entry(K v, uint8_t l, T value) {
+        for (auto& e : entries) {
+            if (e.len == l && e.v == v) {
+                e.value = value;
+                return;
+            }
+        }
+        entries.push_back(entry{v, l, value});
+        index_entry(entries.size() - 1);
+    }
+
+    // longest entry matching k, the caller has checked k against key.
+    const entry* match(K k) const {
+        if (!bits) {
+            // a leaf holds at most its own prefix.
+            return entries.empty() ? nullptr : &entries.front();
+        }
+        if (!slot_entry) {
+            return nullptr;
+        }
+        uint32_t i = slot_entry[lc_key<K>::extract(k, len, bits)];
+        return i == no_entry ? nullptr : &entries[i];
+    }
+
+    void branch(uint8_t b) {
+        bits = b;
+        filled = 0;
+        children = std::make_unique<std::unique_ptr<lc_node>[]>(slots());
+        slot_entry.reset();
+        for (size_t i = 0; i < entries.size(); i++) {
+            index_entry(i);
+        }
+    }
+
+    // points the slots entry i covers at it, unless a longer entry does.
+    void index_entry(size_t i) {
+        if (!bits) {
+            return;
+        }
+        if (!slot_entry) {
+            slot_entry = std::make_unique<uint32_t[]>(slots());
+            std::fill_n(slot_entry.get(), slots(), no_entry);
+        }
+        const entry& e = entries[i];
+        unsigned rest = bits - (e.len - len);
+        size_t first = size_t(lc_key<K>::extract(e.v, len, e.len - len)) << rest;
+        for (size_t s = first; s < first + (size_t(1) << rest); s++) {
+            if (slot_entry[s] == no_entry || entries[slot_entry[s]].len < e.len) {
+                slot_entry[s] = uint32_t(i);
+            }
+        }
+    }
+
+    size_t max_depth() const {
+        size_t depth = 0;
+        for (size_t i = 0; i < slots(); i++) {
+            if (children[i]) {
+                depth = std::max(depth, 1 + children[i]->max_depth());
+            }
+        }
+        return depth;
+    }
+
+    // bytes of this node and everything below it.
+    size_t memory_usage() const {
+        size_t bytes = sizeof(lc_node) + entries.capacity() * sizeof(entry) + slots() * sizeof(children[0]);
+        if (slot_entry) {
+            bytes += slots() * sizeof(slot_entry[0]);
+        }
+        for (size_t i = 0; i < slots(); i++) {
+            if (children[i]) {
+                bytes += children[i]->memory_usage();
+            }
+        }
+        return bytes;
+    }
+};
+
+template <typename T, typename K = uint128_t>
+class lc_trie {
+public:
+    using node = lc_node<T, K>;
+    using key = lc_key<K>;
+
+    // cap of the branching factor a node can grow to by level compression.
+    static constexpr unsigned max_bits = 16;
+
+    std::unique_ptr<node> root = std::make_unique<node>(K(0), 0);
+    lc_trie() = default;
+
+    void insert(prefix<K> p, T value) {
+        insert(root, p.v, p.len, value);
+    }
+
+    // exact match of p, a prefix that was never inserted gives std::nullopt.
+    std::optional<T> find(prefix<K> p) const {
+        const node* n = root.get();
+        while (n) {
+            if (p.len < n->len || ((p.v ^ n->key) & key::mask(n->len))) {
+                return std::nullopt;
+            }
+            if (p.len < n->entry_limit()) {
+                for (const auto& e : n->entries) {
+                    if (e.len == p.len && e.v == p.v) {
+                        return e.value;
+                    }
+                }
+                return std::nullopt;
+            }
+            if (!n->bits) {
+                return std::nullopt;
+            }
+            n = n->children[key::extract(p.v, n->len, n->bits)].get();
+        }
+        return std::nullopt;
+    }
+
+    // longest prefix match of the key.
+    std::optional<T> lookup(K k) const {
+        const node* n = root.get();
+        const typename node::entry* best = nullptr;
+        while (n) {
+            if ((k ^ n->key) & key::mask(n->len)) {
+                break;
+            }
+            if (const auto* e = n->match(k)) {
+                best = e;
+            }
+            if (!n->bits) {
+                break;
+            }
+            n = n->children[key::extract(k, n->len, n->bits)].get();
+        }
+        return best ? std::optional<T>(best->value) : std::nullopt;
+    }
+
+    void dump(std::vector<prefix<K>>& prefixes) const {
+        dump(root.get(), prefixes);
+    }
+
+    // depth in compressed nodes, not in bits.
+    size_t max_depth() const {
+        return root->max_depth();
+    }
+
+    size_t memory_usage() const {
+        return root->memory_usage();
+    }
+
+private:
+    void insert(std::unique_ptr<node>& slot, K v, uint8_t len, T value) {
+        node* n = slot.get();
+        unsigned c = key::common(v, n->key, std::min(len, n->len));
+
+        if (c < n->len) {
+            // the new prefix leaves the compressed path of n: split it at c.
+            auto m = std::make_unique<node>(K(v & key::mask(c)), c);
+            m->branch(1);
+            unsigned old_slot = key::extract(n->key, c, 1);
+            m->children[old_slot] = std::move(slot);
+            m->filled = 1;
+            if (len == c) {
+                m->set_entry(v, len, value);
+            } else {
+                m->children[old_slot ^ 1] = make_leaf(v, len, value);
+                m->filled = 2;
+            }
+            slot = std::move(m);
+            inflate_full(*slot);
+            return;
+        }
+
+        if (len < n->entry_limit()) {
+            n->set_entry(v, len, value);
+            return;
+        }
+
+        if (!n->bits) {
+            n->branch(1);
+        }
+        auto& child = n->children[key::extract(v, n->len, n->bits)];
+        if (!child) {
+            child = make_leaf(v, len, value);
+            n->filled++;
+            inflate_full(*n);
+        } else {
+            insert(child, v, len, value);
+        }
+    }
+
+    static std::unique_ptr<node> make_leaf(K v, uint8_t len, T value) {
+        auto leaf = std::make_unique<node>(v, len);
+        leaf->set_entry(v, len, value);
+        return leaf;
+    }
+
+    // level compression: a node whose slots are all in use doubles, which
+    // keeps it at least half full.
+    static void inflate_full(node& n) {
+        while (n.bits && n.bits < max_bits && n.filled == n.slots()) {
+            inflate(n);
+        }
+    }
+
+    static void inflate(node& n) {
+        unsigned pos = n.len + n.bits;
+        auto old = std::move(n.children);
+        size_t count = n.slots();
+        n.branch(n.bits + 1);
+
+        for (size_t i = 0; i < count; i++) {
+            auto c = std::move(old[i]);
+            if (!c) {
+                continue;
+            }
+            if (c->len > pos) {
+                n.children[2 * i + key::extract(c->key, pos, 1)] = std::move(c);
+                continue;
+            }
+
+            // c sits right at the new branch bit, split it in two halves.
+            for (const auto& e : c->entries) {
+                if (e.len == pos) {
+                    n.set_entry(e.v, e.len, e.value);
+                }
+            }
+            if (c->bits == 1) {
+                n.children[2 * i] = std::move(c->children[0]);
+                n.children[2 * i + 1] = std::move(c->children[1]);
+            } else if (c->bits > 1) {
+                n.children[2 * i] = half(*c, 0);
+                n.children[2 * i + 1] = half(*c, 1);
+            }
+        }
+
+        for (size_t i = 0; i < n.slots(); i++) {
+            n.filled += n.children[i] != nullptr;
+        }
+    }
+
+    // the half of c whose bit at c.len equals b, one bit narrower than c.
+    static std::unique_ptr<node> half(node& c, unsigned b) {
+        K hk = c.key | (K(b) << (key::width - 1 - c.len));
+        auto h = std::make_unique<node>(hk, c.len + 1);
+        h->branch(c.bits - 1);
+        size_t count = h->slots();
+        for (size_t i = 0; i < count; i++) {
+            h->children[i] = std::move(c.children[b * count + i]);
+            h->filled += h->children[i] != nullptr;
+        }
+        for (const auto& e : c.entries) {
+            if (e.len > c.len && key::extract(e.v, c.len, 1) == b) {
+                h->set_entry(e.v, e.len, e.value);
+            }
+        }
+        if (!h->filled && h->entries.empty()) {
+            return nullptr;
+        }
+        return h;
+    }
+
+    static void dump(const node* n, std::vector<prefix<K>>& prefixes) {
+        for (const auto& e : n->entries) {
+            prefixes.push_back(prefix<K>(e.v, e.len));
+        }
+        for (size_t i = 0; i < n->slots(); i++) {
+            if (n->children[i]) {
+                dump(n->children[i].get(), prefixes);
+            }
+        }
+    }
+};
+
+#endif
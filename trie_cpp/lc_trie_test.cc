@@ -0,0 +1,65 @@
+#include "lc_trie.hh"
+#include "test_util.hh"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(LcTrie, Test1) {
+    lc_trie<uint32_t> lt;
+    lt.insert(ipv6_prefix("2001:db8::/32"), 1);
+    lt.insert(ipv6_prefix("2001:db8:1::/48"), 2);
+    lt.insert(ipv6_prefix("2001:db8:1:2::1/128"), 3);
+
+    EXPECT_EQ(lt.find(ipv6_prefix("2001:db8::/32")), 1);
+    EXPECT_EQ(lt.find(ipv6_prefix("2001:db8:1::/48")), 2);
+    EXPECT_EQ(lt.find(ipv6_prefix("2001:db8::/47")), std::nullopt);
+
+    EXPECT_EQ(lt.lookup(ipv6_prefix("2001:db8:1:2::1/128").v), 3);
+    EXPECT_EQ(lt.lookup(ipv6_prefix("2001:db8:1:2::2/128").v), 2);
+    EXPECT_EQ(lt.lookup(ipv6_prefix("2001:db8:2::/128").v), 1);
+    EXPECT_EQ(lt.lookup(ipv6_prefix("2001:db9::/128").v), std::nullopt);
+
+    // three prefixes, each on its own compressed level.
+    EXPECT_EQ(lt.max_depth(), 3);
+
+    std::vector<prefix<uint128_t>> prefixes;
+    lt.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::UnorderedElementsAre(
+        ipv6_prefix("2001:db8::/32"),
+        ipv6_prefix("2001:db8:1::/48"),
+        ipv6_prefix("2001:db8:1:2::1/128")
+    ));
+}
+
+TEST(LcTrie, LevelCompression) {
+    lc_trie<uint32_t> lt;
+    // 256 /56 siblings under one /48: the /48 level fans out in one node.
+    for (uint32_t i = 0; i < 256; i++) {
+        lt.insert(ipv6_prefix(uint128_t(0x20010db8) << 96 | uint128_t(i) << 72, 56), i + 1);
+    }
+    EXPECT_EQ(lt.max_depth(), 1);
+    for (uint32_t i = 0; i < 256; i++) {
+        EXPECT_EQ(lt.lookup(uint128_t(0x20010db8) << 96 | uint128_t(i) << 72 | 1), i + 1);
+    }
+}
+
+template <typename K>
+void same_as_trie(int n, unsigned seed) {
+    lpm_differential<K> d(seed);
+    lc_trie<uint32_t, K> lt;
+    for (int i = 1; i <= n; i++) {
+        // cluster half of the prefixes to get dense regions.
+        d.insert(lt, d.random_prefix(d.rng() % (d.width + 1), i & 1), i);
+    }
+    d.check(lt, n);
+    d.check_dump(lt);
+}
+
+TEST(LcTrie, SameAsTrie32) {
+    same_as_trie<uint32_t>(5000, 1);
+}
+
+TEST(LcTrie, SameAsTrie128) {
+    same_as_trie<uint128_t>(5000, 2);
+}
@@ -0,0 +1,170 @@
+#ifndef LINEAR_SCAN_HH
+#define LINEAR_SCAN_HH
+
+#include "classifier.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+#include <immintrin.h>
+
+// Linear scan of a small acl_rule set, vectorized over the rules.
+//
+// Rules are stored as structure of arrays in blocks of 16: addresses as
+// (value, mask) pairs, ports and protocol as low and high bounds, every field
+// in a 32-bit lane. A packet is broadcast and compared against 8 rules per
+// AVX2 instruction or 16 per AVX-512 one, block after block, and the scan
+// stops at the first block with a match. For a few dozen rules this beats
+// any tree or hash: no pointer chasing and only a few cache lines per lookup.
+class linear_scan {
+public:
+    static constexpr size_t block_rules = 16;
+
+    explicit linear_scan(const std::vector<acl_rule>& rules, simd_kernel k = best_simd_kernel()) : count{rules.size()} {
+        if (!simd_supported(k)) {
+            throw std::invalid_argument("linear scan kernel not supported by this cpu");
+        }
+        first_match = k == simd_kernel::avx512 ? &first_match_avx512
+                      : k == simd_kernel::avx2 ? &first_match_avx2
+                                                : &first_match_scalar;
+
+        // padding lanes get an address that cannot equal its masked value.
+        blocks.assign((rules.size() + block_rules - 1) / block_rules, block{});
+        for (auto& b : blocks) {
+            std::fill_n(b.src_val, block_rules, 1);
+        }
+        for (size_t i = 0; i < rules.size(); i++) {
+            const auto& r = rules[i];
+            block& b = blocks[i / block_rules];
+            size_t j = i % block_rules;
+            b.src_mask[j] = prefix_mask(r.src.len);
+            b.src_val[j] = r.src.v & b.src_mask[j];
+            b.dst_mask[j] = prefix_mask(r.dst.len);
+            b.dst_val[j] = r.dst.v & b.dst_mask[j];
+            b.src_port_lo[j] = r.src_port.low;
+            b.src_port_hi[j] = r.src_port.high;
+            b.dst_port_lo[j] = r.dst_port.low;
+            b.dst_port_hi[j] = r.dst_port.high;
+            b.proto_lo[j] = r.proto.low;
+            b.proto_hi[j] = r.proto.high;
+        }
+    }
+
+    // id of the highest priority rule matching t.
+    std::optional<uint32_t> classify(const five_tuple& t) const {
+        uint32_t id = first_match(blocks.data(), blocks.size(), tuple_fields(t));
+        return id == no_rule ? std::nullopt : std::optional<uint32_t>(id);
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t memory_usage() const {
+        return blocks.capacity() * sizeof(block);
+    }
+
+private:
+    static constexpr uint32_t no_rule = std::numeric_limits<uint32_t>::max();
+
+    struct alignas(64) block {
+        uint32_t src_val[block_rules];
+        uint32_t src_mask[block_rules];
+        uint32_t dst_val[block_rules];
+        uint32_t dst_mask[block_rules];
+        uint32_t src_port_lo[block_rules];
+        uint32_t src_port_hi[block_rules];
+        uint32_t dst_port_lo[block_rules];
+        uint32_t dst_port_hi[block_rules];
+        uint32_t proto_lo[block_rules];
+        uint32_t proto_hi[block_rules];
+    };
+
+    static uint32_t prefix_mask(uint8_t len) {
+        return len ? uint32_t(~((uint64_t(1) << (32 - len)) - 1)) : 0u;
+    }
+
+    static uint32_t first_match_scalar(const block* blocks, size_t n, const acl_point& f) {
+        for (size_t k = 0; k < n; k++) {
+            const block& b = blocks[k];
+            for (size_t j = 0; j < block_rules; j++) {
+                if ((f[0] & b.src_mask[j]) == b.src_val[j] && (f[1] & b.dst_mask[j]) == b.dst_val[j] &&
+                    b.src_port_lo[j] <= f[2] && f[2] <= b.src_port_hi[j] &&
+                    b.dst_port_lo[j] <= f[3] && f[3] <= b.dst_port_hi[j] &&
+                    b.proto_lo[j] <= f[4] && f[4] <= b.proto_hi[j]) {
+                    return k * block_rules + j;
+                }
+            }
+        }
+        return no_rule;
+    }
+
+    __attribute__((target("avx2")))
+    static __m256i load(const uint32_t* p) {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(p));
+    }
+
+    // ports and protocol fit in 16 bits, so the signed compare is exact.
+    __attribute__((target("avx2")))
+    static uint32_t first_match_avx2(const block* blocks, size_t n, const acl_point& f) {
+        __m256i src = _mm256_set1_epi32(int32_t(f[0]));
+        __m256i dst = _mm256_set1_epi32(int32_t(f[1]));
+        __m256i src_port = _mm256_set1_epi32(int32_t(f[2]));
+        __m256i dst_port = _mm256_set1_epi32(int32_t(f[3]));
+        __m256i proto = _mm256_set1_epi32(int32_t(f[4]));
+        for (size_t k = 0; k < n; k++) {
+            const block& b = blocks[k];
+            for (size_t h = 0; h < block_rules; h += 8) {
+                __m256i m = _mm256_and_si256(
+                    _mm256_cmpeq_epi32(_mm256_and_si256(src, load(b.src_mask + h)), load(b.src_val + h)),
+                    _mm256_cmpeq_epi32(_mm256_and_si256(dst, load(b.dst_mask + h)), load(b.dst_val + h)));
+                __m256i out = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpgt_epi32(load(b.src_port_lo + h), src_port),
+                                    _mm256_cmpgt_epi32(src_port, load(b.src_port_hi + h))),
+                    _mm256_or_si256(_mm256_cmpgt_epi32(load(b.dst_port_lo + h), dst_port),
+                                    _mm256_cmpgt_epi32(dst_port, load(b.dst_port_hi + h))));
+                out = _mm256_or_si256(out, _mm256_or_si256(_mm256_cmpgt_epi32(load(b.proto_lo + h), proto),
+                                                           _mm256_cmpgt_epi32(proto, load(b.proto_hi + h))));
+                unsigned hits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(out, m)));
+                if (hits) {
+                    return k * block_rules + h + __builtin_ctz(hits);
+                }
+            }
+        }
+        return no_rule;
+    }
+
+    __attribute__((target("avx512f")))
+    static uint32_t first_match_avx512(const block* blocks, size_t n, const acl_point& f) {
+        __m512i src = _mm512_set1_epi32(int32_t(f[0]));
+        __m512i dst = _mm512_set1_epi32(int32_t(f[1]));
+        __m512i src_port = _mm512_set1_epi32(int32_t(f[2]));
+        __m512i dst_port = _mm512_set1_epi32(int32_t(f[3]));
+        __m512i proto = _mm512_set1_epi32(int32_t(f[4]));
+        for (size_t k = 0; k < n; k++) {
+            const block& b = blocks[k];
+            __mmask16 m = _mm512_cmpeq_epi32_mask(_mm512_and_si512(src, _mm512_load_si512(b.src_mask)),
+                                                  _mm512_load_si512(b.src_val));
+            m = _mm512_mask_cmpeq_epi32_mask(m, _mm512_and_si512(dst, _mm512_load_si512(b.dst_mask)),
+                                             _mm512_load_si512(b.dst_val));
+            m = _mm512_mask_cmple_epu32_mask(m, _mm512_load_si512(b.src_port_lo), src_port);
+            m = _mm512_mask_cmple_epu32_mask(m, src_port, _mm512_load_si512(b.src_port_hi));
+            m = _mm512_mask_cmple_epu32_mask(m, _mm512_load_si512(b.dst_port_lo), dst_port);
+            m = _mm512_mask_cmple_epu32_mask(m, dst_port, _mm512_load_si512(b.dst_port_hi));
+            m = _mm512_mask_cmple_epu32_mask(m, _mm512_load_si512(b.proto_lo), proto);
+            m = _mm512_mask_cmple_epu32_mask(m, proto, _mm512_load_si512(b.proto_hi));
+            if (m) {
+                return k * block_rules + __builtin_ctz(m);
+            }
+        }
+        return no_rule;
+    }
+
+    size_t count;
+    std::vector<block> blocks;
+    uint32_t (*first_match)(const block*, size_t, const acl_point&) = nullptr;
+};
+
+#endif
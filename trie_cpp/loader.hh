@@ -0,0 +1,72 @@
+#ifndef LOADER_HH
+#define LOADER_HH
+
+#include "trie.hh"
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reads the prefix file layout of load_rangelist in tbm/src/iprange.c3: an
+// address line followed by a prefix length line, repeated. Host bits below
+// the length are masked off like Cidr.from does. Blank lines are skipped.
+//
+// Prefix is ipv4_prefix or ipv6_prefix.
+template <typename Prefix>
+std::vector<Prefix> load_prefixes(const std::string& filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        throw std::runtime_error(fmt::format("cannot open {}", filename));
+    }
+
+    constexpr unsigned width = sizeof(Prefix::v) * 8;
+    std::vector<Prefix> prefixes;
+    std::string line, addr;
+    size_t lineno = 0;
+    bool want_addr = true;
+
+    while (std::getline(in, line)) {
+        lineno++;
+        std::string_view l = line;
+        while (!l.empty() && std::isspace(static_cast<unsigned char>(l.back()))) {
+            l.remove_suffix(1);
+        }
+        while (!l.empty() && std::isspace(static_cast<unsigned char>(l.front()))) {
+            l.remove_prefix(1);
+        }
+        if (l.empty()) {
+            continue;
+        }
+
+        if (want_addr) {
+            addr = l;
+            want_addr = false;
+            continue;
+        }
+
+        try {
+            if (l.size() > 3 || l.find_first_not_of("0123456789") != std::string_view::npos) {
+                throw std::invalid_argument(fmt::format("invalid prefix length {}", l));
+            }
+            unsigned len = std::stoul(std::string(l));
+            if (len > width) {
+                throw std::invalid_argument(fmt::format("invalid prefix length {}", len));
+            }
+            Prefix host(fmt::format("{}/{}", addr, width));
+            auto mask = len ? decltype(host.v)(~decltype(host.v)(0) << (width - len)) : decltype(host.v)(0);
+            prefixes.emplace_back(decltype(host.v)(host.v & mask), uint8_t(len));
+        } catch (const std::exception& e) {
+            throw std::invalid_argument(fmt::format("{}:{}: {}", filename, lineno, e.what()));
+        }
+        want_addr = true;
+    }
+
+    if (!want_addr) {
+        throw std::invalid_argument(fmt::format("{}:{}: missing prefix length for {}", filename, lineno, addr));
+    }
+    return prefixes;
+}
+
+#endif
@@ -0,0 +1,306 @@
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include "trie.hh"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+// Bounded lock-free ring for one producer thread and one consumer thread.
+//
+// Positions only grow, the slot is the position modulo the power of two
+// size. Each side keeps a private copy of the other side's position and only
+// reloads it when the ring looks full or empty, so the shared cache lines
+// move once per burst rather than once per element.
+template <typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity)
+        : buf(std::bit_ceil(std::max<size_t>(capacity, 2))), mask{buf.size() - 1} {}
+
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    // producer side, returns the number of elements pushed.
+    size_t push(std::span<const T> in) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (buf.size() - (t - cached_head) < in.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(in.size(), buf.size() - (t - cached_head));
+        for (size_t i = 0; i < n; i++) {
+            buf[(t + i) & mask] = in[i];
+        }
+        tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+    bool try_push(const T& v) {
+        return push(std::span<const T>(&v, 1)) == 1;
+    }
+
+    // producer side, whether the next push would fail.
+    bool full() {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head == buf.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+        }
+        return t - cached_head == buf.size();
+    }
+
+    // consumer side, returns the number of elements popped.
+    size_t pop(std::span<T> out) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail - h < out.size()) {
+            cached_tail = tail.load(std::memory_order_acquire);
+        }
+        size_t n = std::min(out.size(), cached_tail - h);
+        for (size_t i = 0; i < n; i++) {
+            out[i] = std::move(buf[(h + i) & mask]);
+        }
+        head.store(h + n, std::memory_order_release);
+        return n;
+    }
+
+    bool try_pop(T& v) {
+        return pop(std::span<T>(&v, 1)) == 1;
+    }
+
+    // consumer side, the oldest element without popping it.
+    const T* front() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail == h) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (cached_tail == h) {
+                return nullptr;
+            }
+        }
+        return &buf[h & mask];
+    }
+
+    // consumer side, drops the element front() returned.
+    void pop_front() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t capacity() const {
+        return buf.size();
+    }
+
+private:
+    std::vector<T> buf;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cached_tail = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cached_head = 0;
+};
+
+inline uint64_t flow_hash(const five_tuple& t) {
+    uint64_t h = (uint64_t(t.src) << 32 | t.dst) * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t(t.src_port) << 24 | uint64_t(t.dst_port) << 8 | t.proto) * 0xff51afd7ed558ccdull;
+    return h ^ (h >> 29);
+}
+
+inline uint64_t flow_hash(uint32_t key) {
+    uint64_t h = key * 0x9e3779b97f4a7c15ull;
+    return h ^ (h >> 29);
+}
+
+// Classification spread over worker threads that share no mutable state.
+//
+// The input stage, the thread calling push(), hashes every key to a worker
+// so the packets of a flow stay on one core, and appends the worker to a
+// dispatch log. Each worker drains its input ring in bursts, runs lookup on
+// every key against the read-only table and pushes the results onto its own
+// output ring. A collector thread follows the dispatch log, taking the next
+// result from the worker the next key went to, which restores the input
+// order without a reorder buffer, and hands the results to the thread
+// calling pop() through the output ring.
+//
+// lookup must be safe to call from several threads at once: a classifier or
+// trie that is not modified while the pipeline runs.
+template <typename Key, typename Lookup>
+class pipeline {
+public:
+    using result_type = std::invoke_result_t<const Lookup&, const Key&>;
+    static constexpr size_t burst = 32;
+
+    // workers are pinned to cpus first_cpu, first_cpu + 1, ... where the OS
+    // allows it.
+    pipeline(Lookup lookup, size_t workers, size_t ring_size = 1024, size_t first_cpu = 0)
+        : lookup{std::move(lookup)}, log{ring_size * std::max<size_t>(workers, 1) * 2}, output{ring_size} {
+        if (workers == 0 || workers > max_workers) {
+            throw std::invalid_argument(fmt::format("invalid worker count {}, max {}", workers, max_workers));
+        }
+        for (size_t i = 0; i < workers; i++) {
+            lanes.push_back(std::make_unique<lane>(ring_size));
+        }
+        for (size_t i = 0; i < workers; i++) {
+            lanes[i]->thread = std::thread([this, i] {
+                work(*lanes[i]);
+            });
+            pin(lanes[i]->thread, first_cpu + i);
+        }
+        collector = std::thread([this] {
+            collect();
+        });
+    }
+
+    pipeline(const pipeline&) = delete;
+    pipeline& operator=(const pipeline&) = delete;
+
+    // keys and results still in flight are dropped.
+    ~pipeline() {
+        stop.store(true, std::memory_order_relaxed);
+        for (auto& l : lanes) {
+            l->thread.join();
+        }
+        collector.join();
+    }
+
+    // input stage, one thread only. Returns the number of keys accepted, in
+    // order, fewer than keys.size() when a ring is full.
+    size_t push(std::span<const Key> keys) {
+        size_t n = 0;
+        for (; n < keys.size(); n++) {
+            uint16_t w = flow_hash(keys[n]) % lanes.size();
+            // both or neither: the collector waits on the worker of every
+            // log entry.
+            if (lanes[w]->input.full() || log.full()) {
+                break;
+            }
+            lanes[w]->input.try_push(keys[n]);
+            log.try_push(w);
+        }
+        return n;
+    }
+
+    // output stage, one thread only. Returns the number of results popped,
+    // in the order of their keys.
+    size_t pop(std::span<result_type> results) {
+        return output.pop(results);
+    }
+
+    size_t workers() const {
+        return lanes.size();
+    }
+
+    // whether every worker got pinned to its cpu.
+    bool pinned() const {
+        return all_pinned;
+    }
+
+private:
+    static constexpr size_t max_workers = 1 << 16;
+
+    struct lane {
+        explicit lane(size_t ring_size) : input{ring_size}, output{ring_size} {}
+        spsc_ring<Key> input;
+        spsc_ring<result_type> output;
+        std::thread thread;
+    };
+
+    void pin(std::thread& t, size_t cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu % std::max(1u, std::thread::hardware_concurrency()), &set);
+        if (pthread_setaffinity_np(t.native_handle(), sizeof(set), &set) != 0) {
+            all_pinned = false;
+        }
+#else
+        all_pinned = false;
+#endif
+    }
+
+    void work(lane& l) {
+        Key keys[burst];
+        result_type results[burst];
+        unsigned spin = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t n = l.input.pop(keys);
+            if (n == 0) {
+                spin_wait(spin);
+                continue;
+            }
+            spin = 0;
+            for (size_t i = 0; i < n; i++) {
+                results[i] = lookup(keys[i]);
+            }
+            for (size_t done = 0; done < n && !stop.load(std::memory_order_relaxed);) {
+                size_t k = l.output.push(std::span<const result_type>(results + done, n - done));
+                if (k == 0) {
+                    spin_wait(spin);
+                }
+                done += k;
+            }
+        }
+    }
+
+    void collect() {
+        result_type results[burst];
+        unsigned spin = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t n = 0;
+            while (n < burst) {
+                const uint16_t* w = log.front();
+                if (!w || !lanes[*w]->output.try_pop(results[n])) {
+                    break;
+                }
+                log.pop_front();
+                n++;
+            }
+            if (n == 0) {
+                spin_wait(spin);
+                continue;
+            }
+            spin = 0;
+            for (size_t done = 0; done < n && !stop.load(std::memory_order_relaxed);) {
+                size_t k = output.push(std::span<const result_type>(results + done, n - done));
+                if (k == 0) {
+                    spin_wait(spin);
+                }
+                done += k;
+            }
+        }
+    }
+
+    // busy polling for a while, then yielding so idle threads do not starve
+    // the others on an oversubscribed machine. spin is reset on work.
+    static void spin_wait(unsigned& spin) {
+        if (spin++ < 64) {
+#ifdef __x86_64__
+            _mm_pause();
+#endif
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    Lookup lookup;
+    std::vector<std::unique_ptr<lane>> lanes;
+    // worker of every key pushed and not yet collected, in input order.
+    spsc_ring<uint16_t> log;
+    spsc_ring<result_type> output;
+    std::thread collector;
+    std::atomic<bool> stop{false};
+    bool all_pinned = true;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "bench_util.hh"
+#include "hypercuts.hh"
+#include "pipeline.hh"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+const std::vector<acl_rule>& pipeline_rules() {
+    static const auto r = random_rules(10000);
+    return r;
+}
+
+const hypercuts& pipeline_classifier() {
+    static const auto c = std::make_unique<hypercuts>(pipeline_rules());
+    return *c;
+}
+
+// Pushes bursts of keys through a pipeline of state.range(0) workers and
+// pops whatever came out in between, from the benchmark thread. Reports the
+// packet rate and the push to pop latency percentiles of one result in 16.
+template <typename Key, typename Lookup>
+void run_pipeline(benchmark::State& state, Lookup lookup, const std::vector<Key>& keys) {
+    constexpr size_t burst = 32;
+    constexpr size_t sample = 16;
+    pipeline<Key, Lookup> p(lookup, state.range(0));
+    using result_type = typename pipeline<Key, Lookup>::result_type;
+
+    // push time of every key in flight, indexed by its sequence number.
+    std::vector<bench_clock::time_point> pushed_at(keys.size());
+    std::vector<result_type> results(burst);
+    std::vector<double> latencies;
+    size_t pushed = 0, popped = 0;
+    for (auto _ : state) {
+        auto now = bench_clock::now();
+        size_t room = std::min(burst, keys.size() - (pushed - popped));
+        size_t at = pushed % keys.size();
+        size_t n = p.push(std::span(keys).subspan(at, std::min(room, keys.size() - at)));
+        for (size_t i = 0; i < n; i++) {
+            pushed_at[(pushed + i) % keys.size()] = now;
+        }
+        pushed += n;
+
+        size_t m = p.pop(results);
+        if (n == 0 && m == 0) {
+            // let the workers run when they share our cpu.
+            std::this_thread::yield();
+        }
+        if (m) {
+            now = bench_clock::now();
+            for (size_t i = 0; i < m; i++) {
+                size_t seq = popped + i;
+                if (seq % sample == 0) {
+                    latencies.push_back(std::chrono::duration<double, std::micro>(now - pushed_at[seq % keys.size()]).count());
+                }
+            }
+            popped += m;
+        }
+        benchmark::DoNotOptimize(results.data());
+    }
+    state.SetItemsProcessed(popped);
+    state.counters["Mpps"] = benchmark::Counter(double(popped) / 1e6, benchmark::Counter::kIsRate);
+    state.counters["pinned"] = p.pinned();
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto pct = [&](double q) {
+            return latencies[std::min(latencies.size() - 1, size_t(q * latencies.size()))];
+        };
+        state.counters["p50_us"] = pct(0.5);
+        state.counters["p99_us"] = pct(0.99);
+        state.counters["p999_us"] = pct(0.999);
+    }
+}
+
+void BM_pipeline_classify(benchmark::State& state) {
+    static const auto tuples = random_tuples(pipeline_rules(), 1 << 16);
+    const auto& c = pipeline_classifier();
+    run_pipeline(state, [&c](const five_tuple& t) { return c.classify(t); }, tuples);
+}
+
+void BM_pipeline_lookup(benchmark::State& state) {
+    static const auto keys = random_keys(key_count);
+    const auto& t = build_table<trie<uint32_t>>();
+    run_pipeline(state, [&t](uint32_t key) { return t.lookup(key); }, keys);
+}
+
+// 1 to N workers, N the number of cpus and at least 2.
+void worker_counts(benchmark::internal::Benchmark* b) {
+    b->ArgName("workers")->DenseRange(1, std::max(2u, std::thread::hardware_concurrency()));
+}
+
+}
+
+BENCHMARK(BM_pipeline_classify)->Apply(worker_counts)->UseRealTime();
+BENCHMARK(BM_pipeline_lookup)->Apply(worker_counts)->UseRealTime();
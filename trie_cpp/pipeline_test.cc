@@ -0,0 +1,121 @@
+#include "pipeline.hh"
+#include "hypercuts.hh"
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(SpscRing, Test1) {
+    spsc_ring<int> r(3);
+    EXPECT_EQ(r.capacity(), 4);
+    int v = 0;
+    EXPECT_FALSE(r.try_pop(v));
+    EXPECT_EQ(r.front(), nullptr);
+    std::vector<int> in = {1, 2, 3, 4, 5};
+    EXPECT_EQ(r.push(in), 4);
+    EXPECT_TRUE(r.full());
+    EXPECT_EQ(*r.front(), 1);
+    r.pop_front();
+    EXPECT_TRUE(r.try_push(5));
+    std::vector<int> out(8);
+    EXPECT_EQ(r.pop(out), 4);
+    EXPECT_THAT(std::vector(out.begin(), out.begin() + 4), testing::ElementsAre(2, 3, 4, 5));
+}
+
+TEST(SpscRing, Threads) {
+    spsc_ring<uint64_t> r(64);
+    constexpr uint64_t count = 1 << 20;
+    std::thread producer([&] {
+        std::vector<uint64_t> burst(16);
+        for (uint64_t next = 0; next < count;) {
+            for (size_t i = 0; i < burst.size(); i++) {
+                burst[i] = next + i;
+            }
+            size_t n = r.push(std::span(burst).first(std::min<uint64_t>(burst.size(), count - next)));
+            if (n == 0) {
+                std::this_thread::yield();
+            }
+            next += n;
+        }
+    });
+    std::vector<uint64_t> out(16);
+    for (uint64_t expected = 0; expected < count;) {
+        size_t n = r.pop(out);
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            ASSERT_EQ(out[i], expected++);
+        }
+    }
+    producer.join();
+}
+
+namespace {
+
+// pushes every key through p and returns the results in pop order.
+template <typename P, typename Key>
+std::vector<typename P::result_type> run(P& p, const std::vector<Key>& keys) {
+    std::vector<typename P::result_type> results(keys.size());
+    size_t pushed = 0, popped = 0;
+    while (popped < keys.size()) {
+        pushed += p.push(std::span(keys).subspan(pushed, std::min<size_t>(64, keys.size() - pushed)));
+        size_t n = p.pop(std::span(results).subspan(popped));
+        if (n == 0) {
+            std::this_thread::yield();
+        }
+        popped += n;
+    }
+    return results;
+}
+
+}
+
+TEST(Pipeline, SameAsSequential) {
+    std::vector<acl_rule> rules = {
+        {"10.0.0.0/20", "0.0.0.0/0", "0-65535", "80-80", "6-6"},
+        {"10.0.0.0/8", "8.8.8.0/24", "1024-2047", "0-65535", "0-255"},
+        {"10.0.64.0/18", "0.0.0.0/0", "0-65535", "0-65535", "6-6"},
+    };
+    hypercuts hc(rules);
+    std::mt19937 rng(1);
+    std::vector<five_tuple> tuples(100000);
+    for (auto& t : tuples) {
+        t = {uint32_t(0x0a000000 | (rng() & 0xffff)), uint32_t(0x08080800 | (rng() & 0x1ff)), uint16_t(1000 + rng() % 2000),
+             uint16_t(rng() % 100), uint8_t(rng() % 2 ? 6 : 17)};
+    }
+    auto classify = [&hc](const five_tuple& t) {
+        return hc.classify(t);
+    };
+    for (size_t workers : {1, 2, 4}) {
+        pipeline<five_tuple, decltype(classify)> p(classify, workers, 256);
+        EXPECT_EQ(p.workers(), workers);
+        auto results = run(p, tuples);
+        for (size_t i = 0; i < tuples.size(); i++) {
+            ASSERT_EQ(results[i], hc.classify(tuples[i])) << i << " " << tuples[i].show();
+        }
+    }
+}
+
+TEST(Pipeline, TrieLookup) {
+    trie<uint32_t> t;
+    t.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    t.insert(ipv4_prefix("10.1.0.0/16"), 2);
+    t.insert(ipv4_prefix("10.1.2.0/24"), 3);
+    auto lookup = [&t](uint32_t key) {
+        return t.lookup(key);
+    };
+    pipeline<uint32_t, decltype(lookup)> p(lookup, 3, 16);
+    std::mt19937 rng(2);
+    std::vector<uint32_t> keys(50000);
+    for (auto& k : keys) {
+        k = 0x0a000000 | (rng() & 0x0103ffff);
+    }
+    auto results = run(p, keys);
+    for (size_t i = 0; i < keys.size(); i++) {
+        ASSERT_EQ(results[i], t.lookup(keys[i]));
+    }
+    EXPECT_THROW((pipeline<uint32_t, decltype(lookup)>(lookup, 0)), std::invalid_argument);
+}
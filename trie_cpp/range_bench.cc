@@ -0,0 +1,68 @@
+#include "bench_util.hh"
+#include "range_index.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// the /20 and longer prefixes of the BGP-like table, the short ones would
+// merge the whole table into a few ranges.
+const trie<uint32_t>& range_trie() {
+    static const auto table = [] {
+        auto t = std::make_unique<trie<uint32_t>>();
+        for (const auto& p : random_prefixes(table_size)) {
+            if (p.len >= 20) {
+                t->insert(p, 1u);
+            }
+        }
+        return t;
+    }();
+    return *table;
+}
+
+const range_index<uint32_t>& range_table() {
+    static const range_index<uint32_t> table = range_index<uint32_t>::from_trie(range_trie());
+    return table;
+}
+
+void BM_range_index(benchmark::State& state) {
+    const auto& table = range_table();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.contains(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["ranges"] = table.merged().size();
+    state.counters["bytes_per_range"] = double(table.memory_usage()) / table.merged().size();
+}
+
+// plain binary search over the sorted merged ranges, as in iprange.c3.
+void BM_range_binary_search(benchmark::State& state) {
+    const auto& ranges = range_table().merged();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        uint32_t key = keys[i++ & (key_count - 1)];
+        auto it = std::upper_bound(ranges.begin(), ranges.end(), key, [](uint32_t k, const auto& r) {
+            return k < r.low;
+        });
+        benchmark::DoNotOptimize(it != ranges.begin() && std::prev(it)->high >= key);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_range_trie(benchmark::State& state) {
+    const auto& table = range_trie();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]).has_value());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_range_index);
+BENCHMARK(BM_range_binary_search);
+BENCHMARK(BM_range_trie);
@@ -0,0 +1,192 @@
+#ifndef RANGE_INDEX_HH
+#define RANGE_INDEX_HH
+
+#include "trie.hh"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <vector>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Static index over a set of address ranges, the C++ counterpart of
+// IpRangeList in tbm/src/iprange.c3.
+//
+// Overlapping and adjacent ranges are merged at build time, so a key is in
+// the set iff the last range starting at or below it also ends at or above
+// it. The range starts are laid out as an S-tree (a static B-tree stored
+// implicitly, Algorithmica): blocks of one cache line, block k has children
+// k * (B + 1) + i + 1. A query reads one block per level, ranks the key in it
+// with a SIMD compare and a popcount, and descends without a data dependent
+// branch.
+template <typename K = uint32_t>
+class range_index {
+public:
+    static_assert(std::is_unsigned_v<K> && sizeof(K) <= sizeof(uint64_t), "K must be unsigned and at most 64-bit");
+    static constexpr unsigned width = sizeof(K) * 8;
+    // keys per block, one 64-byte cache line.
+    static constexpr size_t B = 64 / sizeof(K);
+
+    range_index() = default;
+
+    explicit range_index(std::vector<range<K>> input) {
+        std::sort(input.begin(), input.end(), [](const auto& a, const auto& b) {
+            return a.low < b.low;
+        });
+        for (const auto& r : input) {
+            if (r.low > r.high) {
+                throw std::invalid_argument(fmt::format("invalid range {}", r.show()));
+            }
+            // ranges that overlap or touch the last one extend it.
+            if (!ranges.empty() && (ranges.back().high == max || r.low <= ranges.back().high + 1)) {
+                ranges.back().high = std::max(ranges.back().high, r.high);
+            } else {
+                ranges.push_back(r);
+            }
+        }
+        layout();
+    }
+
+    // the prefixes of t, whatever their values.
+    template <typename T>
+    static range_index from_trie(const trie<T>& t) {
+        std::vector<prefix<K>> prefixes;
+        t.dump(prefixes);
+        std::vector<range<K>> input;
+        input.reserve(prefixes.size());
+        for (const auto& p : prefixes) {
+            input.push_back(p.len ? p.convert_to_range() : range<K>(0, max));
+        }
+        return range_index(std::move(input));
+    }
+
+    // inserts the minimal set of prefixes covering the ranges, all with value.
+    template <typename T>
+    void to_trie(trie<T>& t, T value) const {
+        for (const auto& r : ranges) {
+            K lo = r.low;
+            while (true) {
+                // the largest aligned block starting at lo that fits in r.
+                K rest = r.high - lo;
+                unsigned bits = rest == max ? width : std::bit_width(K(rest + 1)) - 1;
+                if (lo) {
+                    bits = std::min<unsigned>(bits, std::countr_zero(lo));
+                }
+                t.insert(prefix<K>(lo, width - bits), value);
+                if (bits == width || K(lo + (K(1) << bits) - 1) == r.high) {
+                    break;
+                }
+                lo += K(1) << bits;
+            }
+        }
+    }
+
+    bool contains(K key) const {
+        return find(key).has_value();
+    }
+
+    // the merged range holding key.
+    std::optional<range<K>> find(K key) const {
+        if (ranges.empty()) {
+            return std::nullopt;
+        }
+        size_t rank;
+        if (key == max) {
+            // the padding compares equal to max, rank it directly.
+            rank = ranges.size();
+        } else {
+            rank = search(key);
+        }
+        if (rank == 0 || ranges[rank - 1].high < key) {
+            return std::nullopt;
+        }
+        return ranges[rank - 1];
+    }
+
+    const std::vector<range<K>>& merged() const {
+        return ranges;
+    }
+
+    size_t memory_usage() const {
+        return ranges.capacity() * sizeof(range<K>) + tree.capacity() * sizeof(node) +
+               ranks.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    static constexpr K max = std::numeric_limits<K>::max();
+    static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+    struct alignas(64) node {
+        K keys[B];
+    };
+
+    // number of starts <= key, i.e. one past the rank of the candidate range.
+    size_t search(K key) const {
+        size_t k = 0;
+        size_t slot = none;
+        while (k < tree.size()) {
+            unsigned i = rank_in_block(tree[k].keys, key);
+            // the deepest block with a start <= key holds the predecessor.
+            slot = i ? k * B + i - 1 : slot;
+            k = k * (B + 1) + i + 1;
+        }
+        return slot == none ? 0 : ranks[slot] + 1;
+    }
+
+    // number of keys in the block <= key, padding never counts as key < max.
+    static unsigned rank_in_block(const K* keys, K key) {
+#ifdef __AVX2__
+        if constexpr (sizeof(K) == sizeof(uint32_t)) {
+            // unsigned compare through the signed one, both sides biased.
+            const __m256i bias = _mm256_set1_epi32(int32_t(0x80000000));
+            __m256i x = _mm256_xor_si256(_mm256_set1_epi32(int32_t(key)), bias);
+            __m256i a = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(keys)), bias);
+            __m256i b = _mm256_xor_si256(_mm256_load_si256(reinterpret_cast<const __m256i*>(keys + 8)), bias);
+            unsigned gt = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, x))) |
+                          _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, x))) << 8;
+            return B - std::popcount(gt);
+        }
+#endif
+        unsigned count = 0;
+        for (size_t j = 0; j < B; j++) {
+            count += keys[j] <= key;
+        }
+        return count;
+    }
+
+    void layout() {
+        size_t blocks = (ranges.size() + B - 1) / B;
+        tree.assign(blocks, node{});
+        ranks.assign(blocks * B, 0);
+        size_t next = 0;
+        fill(0, next);
+    }
+
+    // in-order walk of the implicit tree hands out the sorted starts.
+    void fill(size_t k, size_t& next) {
+        if (k >= tree.size()) {
+            return;
+        }
+        for (size_t i = 0; i < B; i++) {
+            fill(k * (B + 1) + i + 1, next);
+            if (next < ranges.size()) {
+                tree[k].keys[i] = ranges[next].low;
+                ranks[k * B + i] = next++;
+            } else {
+                tree[k].keys[i] = max;
+            }
+        }
+        fill(k * (B + 1) + B + 1, next);
+    }
+
+    std::vector<range<K>> ranges;
+    std::vector<node> tree;
+    // sorted index of every tree slot.
+    std::vector<uint32_t> ranks;
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include "range_index.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(RangeIndex, Test1) {
+    range_index<uint32_t> ri({{10, 20}, {15, 30}, {31, 40}, {50, 60}, {0xfffffff0, 0xffffffff}});
+    // [10, 30] and [31, 40] touch and merge as well.
+    EXPECT_EQ(ri.merged().size(), 3);
+    EXPECT_FALSE(ri.contains(9));
+    EXPECT_TRUE(ri.contains(10));
+    EXPECT_TRUE(ri.contains(40));
+    EXPECT_FALSE(ri.contains(41));
+    EXPECT_EQ(ri.find(55)->low, 50);
+    EXPECT_EQ(ri.find(55)->high, 60);
+    EXPECT_TRUE(ri.contains(0xffffffff));
+    EXPECT_FALSE(ri.contains(0xffffffef));
+
+    EXPECT_FALSE(range_index<uint32_t>().contains(0));
+    EXPECT_THROW(range_index<uint32_t>({{5, 4}}), std::invalid_argument);
+}
+
+template <typename K>
+void same_as_scan(size_t n, uint32_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<range<K>> input;
+    for (size_t i = 0; i < n; i++) {
+        K low = K(rng()) & K(0xfffff);
+        input.emplace_back(low, low + K(rng() % 64));
+    }
+    range_index<K> ri(input);
+
+    for (int i = 0; i < 20000; i++) {
+        K key = K(rng()) & K(0xfffff);
+        bool expected = std::any_of(input.begin(), input.end(), [&](const auto& r) {
+            return r.contains(key);
+        });
+        EXPECT_EQ(ri.contains(key), expected) << key;
+    }
+}
+
+TEST(RangeIndex, SameAsScan) {
+    // sizes around full levels of the tree.
+    for (size_t n : {1, 15, 16, 17, 272, 273, 3000}) {
+        same_as_scan<uint32_t>(n, n);
+        same_as_scan<uint64_t>(n, n);
+    }
+}
+
+TEST(RangeIndex, Trie) {
+    std::mt19937 rng(10);
+    trie<uint32_t> bt;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = 8 + rng() % 25;
+        uint32_t v = rng() & ~((uint64_t(1) << (32 - len)) - 1);
+        bt.insert<uint32_t>({v, len}, i);
+    }
+    auto ri = range_index<uint32_t>::from_trie(bt);
+
+    trie<uint32_t> back;
+    ri.to_trie(back, 1u);
+    for (int i = 0; i < 20000; i++) {
+        uint32_t key = rng();
+        EXPECT_EQ(ri.contains(key), bt.lookup(key).has_value()) << key;
+        EXPECT_EQ(ri.contains(key), back.lookup(key).has_value()) << key;
+    }
+    // the round trip gives the same merged ranges.
+    auto again = range_index<uint32_t>::from_trie(back);
+    ASSERT_EQ(again.merged().size(), ri.merged().size());
+    for (size_t i = 0; i < ri.merged().size(); i++) {
+        EXPECT_EQ(again.merged()[i].low, ri.merged()[i].low);
+        EXPECT_EQ(again.merged()[i].high, ri.merged()[i].high);
+    }
+
+    // a default route covers everything and comes back as one prefix.
+    trie<uint32_t> all;
+    all.insert<uint32_t>({0, 0}, 1);
+    auto everything = range_index<uint32_t>::from_trie(all);
+    EXPECT_TRUE(everything.contains(0));
+    EXPECT_TRUE(everything.contains(0xffffffff));
+    trie<uint32_t> all_back;
+    everything.to_trie(all_back, 1u);
+    std::vector<prefix<uint32_t>> prefixes;
+    all_back.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::ElementsAre(prefix<uint32_t>{0, 0}));
+}
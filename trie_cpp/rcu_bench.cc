@@ -0,0 +1,102 @@
+#include "bench_util.hh"
+#include "rcu_trie.hh"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// One writer keeps re-inserting and removing a slice of the table while the
+// benchmark threads look up. Started by thread 0, the other readers wait for
+// it at the start of the timed loop.
+struct churn {
+    std::atomic<bool> stop{false};
+    std::thread writer;
+
+    template <typename F>
+    void start(F&& f) {
+        stop = false;
+        writer = std::thread([this, f] {
+            auto prefixes = random_prefixes(1 << 12, 7);
+            uint32_t round = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                for (const auto& p : prefixes) {
+                    f(p, ++round);
+                }
+            }
+        });
+    }
+
+    void finish() {
+        stop = true;
+        writer.join();
+    }
+};
+
+template <typename Table>
+Table& mutable_table() {
+    static auto table = [] {
+        auto t = std::make_unique<Table>();
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            t->insert(p, value++);
+        }
+        return t;
+    }();
+    return *table;
+}
+
+churn rcu_churn;
+
+void BM_rcu_lookup(benchmark::State& state) {
+    auto& table = mutable_table<rcu_trie<uint32_t>>();
+    if (state.thread_index() == 0) {
+        rcu_churn.start([&table](const prefix<uint32_t>& p, uint32_t round) {
+            if (round & 1) {
+                table.insert(p, round);
+            } else {
+                table.remove(p);
+            }
+        });
+    }
+    auto reader = table.register_reader();
+    auto keys = random_keys(key_count, state.thread_index() + 2);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(reader.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        rcu_churn.finish();
+    }
+}
+
+// the global lock the concurrent mode replaces.
+std::mutex table_lock;
+churn locked_churn;
+
+void BM_locked_lookup(benchmark::State& state) {
+    auto& table = mutable_table<trie<uint32_t>>();
+    if (state.thread_index() == 0) {
+        locked_churn.start([&table](const prefix<uint32_t>& p, uint32_t round) {
+            std::lock_guard<std::mutex> guard(table_lock);
+            table.insert(p, round | 1);
+        });
+    }
+    auto keys = random_keys(key_count, state.thread_index() + 2);
+    size_t i = 0;
+    for (auto _ : state) {
+        std::lock_guard<std::mutex> guard(table_lock);
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    if (state.thread_index() == 0) {
+        locked_churn.finish();
+    }
+}
+
+}
+
+BENCHMARK(BM_rcu_lookup)->ThreadRange(1, 32)->UseRealTime();
+BENCHMARK(BM_locked_lookup)->ThreadRange(1, 32)->UseRealTime();
@@ -0,0 +1,360 @@
+#ifndef RCU_TRIE_HH
+#define RCU_TRIE_HH
+
+#include "trie.hh"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Epoch based reclamation for one writer and many readers.
+//
+// A reader publishes the global epoch it observed in its slot for the duration
+// of a read section and clears it afterwards, which is wait-free. The writer
+// unlinks nodes, retires them tagged with the current epoch and bumps the
+// epoch in reclaim(); a retired node is freed once every reader inside a read
+// section has published a newer epoch, i.e. entered after the unlink.
+template <size_t MAX_READERS = 64>
+class epoch_domain {
+public:
+    static constexpr uint64_t quiescent = 0;
+
+    class reader {
+    public:
+        reader() = default;
+        reader(epoch_domain* d, size_t slot) : domain{d}, slot{slot} {}
+        reader(reader&& other) noexcept : domain{other.domain}, slot{other.slot} {
+            other.domain = nullptr;
+        }
+        reader& operator=(reader&& other) noexcept {
+            std::swap(domain, other.domain);
+            std::swap(slot, other.slot);
+            return *this;
+        }
+        ~reader() {
+            if (domain) {
+                domain->slots[slot].used.store(false, std::memory_order_release);
+            }
+        }
+
+        void enter() const {
+            auto& s = domain->slots[slot];
+            s.epoch.store(domain->global.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            // the slot store must be visible before any child link is loaded,
+            // pairs with the fence in reclaim().
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        void exit() const {
+            domain->slots[slot].epoch.store(quiescent, std::memory_order_release);
+        }
+
+    private:
+        epoch_domain* domain = nullptr;
+        size_t slot = 0;
+    };
+
+    epoch_domain() = default;
+    epoch_domain(const epoch_domain&) = delete;
+    epoch_domain& operator=(const epoch_domain&) = delete;
+
+    ~epoch_domain() {
+        for (auto& r : retired) {
+            r.deleter(r.ptr);
+        }
+    }
+
+    reader register_reader() {
+        for (size_t i = 0; i < MAX_READERS; i++) {
+            bool expected = false;
+            if (slots[i].used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return reader(this, i);
+            }
+        }
+        throw std::runtime_error(fmt::format("too many readers, max {}", MAX_READERS));
+    }
+
+    // writer only.
+    void retire(void* ptr, void (*deleter)(void*)) {
+        retired.push_back({ptr, deleter, global.load(std::memory_order_relaxed)});
+    }
+
+    // writer only, frees the retired objects no reader can still see.
+    void reclaim() {
+        global.fetch_add(1, std::memory_order_seq_cst);
+        // orders the unlinks before the slot loads, pairs with the fence in
+        // reader::enter(): either the reader sees the unlink or we see its epoch.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        uint64_t min_epoch = UINT64_MAX;
+        for (auto& s : slots) {
+            uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+            if (e != quiescent) {
+                min_epoch = std::min(min_epoch, e);
+            }
+        }
+
+        size_t kept = 0;
+        for (auto& r : retired) {
+            if (r.epoch < min_epoch) {
+                r.deleter(r.ptr);
+            } else {
+                retired[kept++] = r;
+            }
+        }
+        retired.resize(kept);
+    }
+
+    size_t pending() const {
+        return retired.size();
+    }
+
+private:
+    struct alignas(64) slot_t {
+        std::atomic<uint64_t> epoch{quiescent};
+        std::atomic<bool> used{false};
+    };
+
+    struct retired_t {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    alignas(64) std::atomic<uint64_t> global{1};
+    std::array<slot_t, MAX_READERS> slots;
+    std::vector<retired_t> retired;
+};
+
+template<typename T>
+struct rcu_trie_node {
+    std::atomic<rcu_trie_node*> left{nullptr};
+    std::atomic<rcu_trie_node*> right{nullptr};
+    std::atomic<T> value{init_value<T>()};
+
+    bool has_info() const {
+        return value.load(std::memory_order_relaxed) != init_value<T>();
+    }
+
+    bool empty_node() const {
+        return !has_info() && !left.load(std::memory_order_relaxed) && !right.load(std::memory_order_relaxed);
+    }
+
+    // frees the node and its whole subtree, no reader may reach it anymore.
+    static void destroy(void* ptr) {
+        auto* node = static_cast<rcu_trie_node*>(ptr);
+        if (!node) {
+            return;
+        }
+        destroy(node->left.load(std::memory_order_relaxed));
+        destroy(node->right.load(std::memory_order_relaxed));
+        delete node;
+    }
+};
+
+// Binary trie with the same insert/find/lookup/dump surface as trie<T> that
+// serves any number of concurrent readers while one writer thread inserts and
+// removes prefixes. Readers go through a registered reader handle and never
+// block or retry; the nodes the writer prunes are freed via epoch_domain.
+template <typename T, size_t MAX_READERS = 64>
+class rcu_trie {
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+    using node = rcu_trie_node<T>;
+    using domain = epoch_domain<MAX_READERS>;
+
+    class reader {
+    public:
+        explicit reader(const rcu_trie& t) : t{&t}, handle{t.epochs.register_reader()} {}
+
+        template<typename P>
+        std::optional<T> find(prefix<P> p) const {
+            section s(handle);
+            return t->find_unsafe(p);
+        }
+
+        template<typename P>
+        std::optional<T> lookup(P key) const {
+            section s(handle);
+            return t->lookup_unsafe(key);
+        }
+
+    private:
+        struct section {
+            const typename domain::reader& h;
+            explicit section(const typename domain::reader& h) : h{h} { h.enter(); }
+            ~section() { h.exit(); }
+        };
+
+        const rcu_trie* t;
+        typename domain::reader handle;
+    };
+
+    rcu_trie() = default;
+    rcu_trie(const rcu_trie&) = delete;
+    rcu_trie& operator=(const rcu_trie&) = delete;
+
+    ~rcu_trie() {
+        node::destroy(root.left.load(std::memory_order_relaxed));
+        node::destroy(root.right.load(std::memory_order_relaxed));
+    }
+
+    reader register_reader() const {
+        return reader(*this);
+    }
+
+    // writer only.
+    template<typename P>
+    void insert(prefix<P> p, T value) {
+        node* currNode = &root;
+        while (p.len) {
+            auto& child = p.highest_bit_is_set() ? currNode->right : currNode->left;
+            node* next = child.load(std::memory_order_relaxed);
+            if (!next) {
+                next = new node();
+                child.store(next, std::memory_order_release);
+            }
+            currNode = next;
+            p.v <<= 1;
+            p.len--;
+        }
+        currNode->value.store(value, std::memory_order_release);
+    }
+
+    // writer only, returns false if p was not in the trie.
+    template<typename P>
+    bool remove(prefix<P> p) {
+        std::array<node*, sizeof(P) * 8 + 1> path;
+        size_t depth = 0;
+        node* currNode = &root;
+        path[depth++] = currNode;
+
+        while (p.len) {
+            currNode = (p.highest_bit_is_set() ? currNode->right : currNode->left).load(std::memory_order_relaxed);
+            if (!currNode) {
+                return false;
+            }
+            path[depth++] = currNode;
+            p.v <<= 1;
+            p.len--;
+        }
+
+        if (!currNode->has_info()) {
+            return false;
+        }
+        currNode->value.store(init_value<T>(), std::memory_order_release);
+
+        // unlink the highest node of the chain that became empty, the rest of
+        // the chain goes away with it.
+        if (depth == 1 || !currNode->empty_node()) {
+            return true;
+        }
+        size_t top = depth - 1;
+        while (top > 1 && single_child_of(path[top - 1], path[top])) {
+            top--;
+        }
+        node* parent = path[top - 1];
+        auto& link = parent->left.load(std::memory_order_relaxed) == path[top] ? parent->left : parent->right;
+        link.store(nullptr, std::memory_order_release);
+        epochs.retire(path[top], &node::destroy);
+        if (epochs.pending() >= reclaim_threshold) {
+            epochs.reclaim();
+        }
+        return true;
+    }
+
+    // writer only, frees what readers can no longer see.
+    void reclaim() {
+        epochs.reclaim();
+    }
+
+    // writer only.
+    template<typename P>
+    void dump(std::vector<prefix<P>>& prefixes) const {
+        dump(&root, prefix<P>{0, 0}, prefixes);
+    }
+
+    size_t max_depth() const {
+        return max_depth(&root);
+    }
+
+private:
+    template<typename P>
+    std::optional<T> find_unsafe(prefix<P> p) const {
+        const node* currNode = &root;
+        while (p.len) {
+            currNode = (p.highest_bit_is_set() ? currNode->right : currNode->left).load(std::memory_order_acquire);
+            if (!currNode) {
+                return std::nullopt;
+            }
+            p.v <<= 1;
+            p.len--;
+        }
+        return currNode->value.load(std::memory_order_acquire);
+    }
+
+    template<typename P>
+    std::optional<T> lookup_unsafe(P key) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+        const node* currNode = &root;
+        std::optional<T> best;
+        unsigned bits = sizeof(P) * 8;
+
+        while (true) {
+            T v = currNode->value.load(std::memory_order_acquire);
+            if (v != init_value<T>()) {
+                best = v;
+            }
+            if (bits == 0) {
+                break;
+            }
+            currNode = ((key & (P(1) << (sizeof(P) * 8 - 1))) ? currNode->right : currNode->left).load(std::memory_order_acquire);
+            if (!currNode) {
+                break;
+            }
+            key <<= 1;
+            bits--;
+        }
+        return best;
+    }
+
+    static bool single_child_of(const node* parent, const node* child) {
+        const node* l = parent->left.load(std::memory_order_relaxed);
+        const node* r = parent->right.load(std::memory_order_relaxed);
+        return !parent->has_info() && ((l == child && !r) || (r == child && !l));
+    }
+
+    template<typename P>
+    void dump(const node* n, prefix<P> p, std::vector<prefix<P>>& prefixes) const {
+        if (n->has_info()) {
+            prefixes.push_back(p);
+        }
+        if (const node* l = n->left.load(std::memory_order_relaxed)) {
+            dump(l, prefix<P>(p.v, p.len + 1), prefixes);
+        }
+        if (const node* r = n->right.load(std::memory_order_relaxed)) {
+            dump(r, prefix<P>(p.v | (P(1) << (sizeof(P) * 8 - 1 - p.len)), p.len + 1), prefixes);
+        }
+    }
+
+    static size_t max_depth(const node* n) {
+        size_t depth = 0;
+        if (const node* l = n->left.load(std::memory_order_relaxed)) {
+            depth = std::max(depth, 1 + max_depth(l));
+        }
+        if (const node* r = n->right.load(std::memory_order_relaxed)) {
+            depth = std::max(depth, 1 + max_depth(r));
+        }
+        return depth;
+    }
+
+    static constexpr size_t reclaim_threshold = 64;
+
+    node root;
+    mutable domain epochs;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "rcu_trie.hh"
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(RcuTrie, Test1) {
+    rcu_trie<uint32_t> rt;
+    rt.insert<uint16_t>({0x1234, 16}, 1);
+    rt.insert<uint16_t>({0x4, 16}, 2);
+    EXPECT_EQ(rt.max_depth(), 16);
+
+    auto r = rt.register_reader();
+    EXPECT_EQ(r.find<uint16_t>({0x1234, 16}), 1);
+    EXPECT_EQ(r.find<uint16_t>({0x4, 16}), 2);
+    EXPECT_EQ(r.lookup<uint16_t>(0x1234), 1);
+
+    std::vector<prefix<uint16_t>> prefixes;
+    rt.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::UnorderedElementsAre(
+        prefix<uint16_t>{0x1234, 16},
+        prefix<uint16_t>{0x4, 16}
+    ));
+}
+
+TEST(RcuTrie, Remove) {
+    rcu_trie<uint32_t> rt;
+    rt.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    rt.insert(ipv4_prefix("10.1.2.0/24"), 2);
+    auto r = rt.register_reader();
+
+    EXPECT_EQ(r.lookup<uint32_t>(0x0a010203), 2);
+    EXPECT_EQ(rt.remove(ipv4_prefix("10.1.2.0/24")), true);
+    EXPECT_EQ(rt.remove(ipv4_prefix("10.1.2.0/24")), false);
+    EXPECT_EQ(rt.remove(ipv4_prefix("10.1.0.0/16")), false);
+    EXPECT_EQ(r.lookup<uint32_t>(0x0a010203), 1);
+    EXPECT_EQ(rt.max_depth(), 8);
+
+    EXPECT_EQ(rt.remove(ipv4_prefix("10.0.0.0/8")), true);
+    EXPECT_EQ(rt.max_depth(), 0);
+    EXPECT_EQ(r.lookup<uint32_t>(0x0a010203), std::nullopt);
+    rt.reclaim();
+}
+
+TEST(RcuTrie, TooManyReaders) {
+    rcu_trie<uint32_t, 2> rt;
+    auto r1 = rt.register_reader();
+    {
+        auto r2 = rt.register_reader();
+        EXPECT_THROW(rt.register_reader(), std::runtime_error);
+    }
+    auto r3 = rt.register_reader();
+}
+
+// The writer churns a fixed set of prefixes whose values are derived from the
+// prefix itself, so every answer a reader gets can be checked without
+// synchronizing with the writer. Freed nodes still in use show up under ASan.
+TEST(RcuTrie, Stress) {
+    constexpr int readers = 4;
+    rcu_trie<uint32_t> rt;
+    std::vector<prefix<uint32_t>> prefixes;
+    std::mt19937 rng(3);
+    for (int i = 0; i < 512; i++) {
+        uint8_t len = 8 + rng() % 25;
+        prefixes.emplace_back(rng() & ~((uint64_t(1) << (32 - len)) - 1), len);
+    }
+    auto value_of = [](const prefix<uint32_t>& p) {
+        return (p.v ^ (uint32_t(p.len) << 24)) | 1;
+    };
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> bad{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < readers; t++) {
+        threads.emplace_back([&, t] {
+            auto r = rt.register_reader();
+            std::mt19937 rng(t);
+            while (!stop.load(std::memory_order_relaxed)) {
+                const auto& p = prefixes[rng() % prefixes.size()];
+                auto v = r.find(p);
+                if (v && *v != 0 && *v != value_of(p)) {
+                    bad++;
+                }
+                auto lv = r.lookup<uint32_t>(p.v);
+                if (lv && (*lv & 1) == 0) {
+                    bad++;
+                }
+            }
+        });
+    }
+
+    for (int round = 0; round < 200; round++) {
+        for (const auto& p : prefixes) {
+            if (rng() & 1) {
+                rt.insert(p, value_of(p));
+            } else {
+                rt.remove(p);
+            }
+        }
+    }
+    stop = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    rt.reclaim();
+    EXPECT_EQ(bad.load(), 0);
+}
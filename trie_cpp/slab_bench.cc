@@ -0,0 +1,148 @@
+#include "bench_util.hh"
+#include "slab_trie.hh"
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// dTLB load misses of this thread from perf_event_open, no libpfm needed.
+// Reads 0 where perf events are not allowed (perf_event_paranoid > 2).
+class dtlb_misses {
+public:
+    dtlb_misses() {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                      PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    ~dtlb_misses() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    uint64_t read() const {
+        uint64_t n = 0;
+        if (fd < 0 || ::read(fd, &n, sizeof(n)) != sizeof(n)) {
+            return 0;
+        }
+        return n;
+    }
+
+private:
+    int fd;
+};
+
+// bytes of this process on transparent huge pages, what the kernel made of
+// the MADV_HUGEPAGE requests.
+uint64_t anon_huge_bytes() {
+    std::ifstream f("/proc/self/smaps_rollup");
+    std::string key;
+    while (f >> key) {
+        if (key == "AnonHugePages:") {
+            uint64_t kb = 0;
+            f >> kb;
+            return kb << 10;
+        }
+        f.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+template <typename Table>
+const Table& huge_table() {
+    static auto table = [] {
+        auto t = std::make_unique<Table>();
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            t->insert(p, value++);
+        }
+        t->compact();
+        return t;
+    }();
+    return *table;
+}
+
+slab_trie<uint32_t>& slab_table(bool compacted) {
+    static auto table = [] {
+        auto t = std::make_unique<slab_trie<uint32_t>>();
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            t->insert(p, value++);
+        }
+        return t;
+    }();
+    static auto compact_table = [] {
+        auto t = std::make_unique<slab_trie<uint32_t>>();
+        uint32_t value = 1;
+        for (const auto& p : random_prefixes(table_size)) {
+            t->insert(p, value++);
+        }
+        t->compact();
+        return t;
+    }();
+    return compacted ? *compact_table : *table;
+}
+
+// the pointer trie pays sizeof(trie_node) per node plus the malloc header,
+// which is not counted here.
+void BM_pointer_trie(benchmark::State& state) {
+    const auto& table = build_table<trie<uint32_t>>();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_prefix"] = double(table.node_count() * sizeof(trie_node<uint32_t>)) / table_size;
+}
+
+void BM_slab_trie(benchmark::State& state) {
+    const auto& table = slab_table(state.range(0));
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_prefix"] = double(table.memory_usage()) / table_size;
+}
+
+// compacted slab tries on 4K and 2M pages, with the dTLB misses of the
+// lookups and the backing the slabs got.
+template <typename Table>
+void BM_slab_trie_pages(benchmark::State& state) {
+    const auto& table = huge_table<Table>();
+    auto keys = random_keys(key_count);
+    dtlb_misses misses;
+    size_t i = 0;
+    uint64_t start = misses.read();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    uint64_t n = misses.read() - start;
+    state.SetItemsProcessed(state.iterations());
+    state.counters["dtlb_misses"] = benchmark::Counter(n, benchmark::Counter::kAvgIterations);
+    const auto& stats = huge_page_stats();
+    state.counters["hugetlb_maps"] = stats.hugetlb.load();
+    state.counters["thp_requested_maps"] = stats.thp_requested.load();
+    state.counters["plain_maps"] = stats.plain.load();
+    state.counters["anon_huge_bytes"] = anon_huge_bytes();
+}
+
+}
+
+BENCHMARK(BM_pointer_trie);
+BENCHMARK(BM_slab_trie)->ArgName("compacted")->Arg(0)->Arg(1);
+BENCHMARK_TEMPLATE(BM_slab_trie_pages, slab_trie<uint32_t>);
+BENCHMARK_TEMPLATE(BM_slab_trie_pages, huge_slab_trie<uint32_t>);
@@ -0,0 +1,311 @@
+#ifndef SLAB_TRIE_HH
+#define SLAB_TRIE_HH
+
+#include "trie.hh"
+#include "huge_pages.hh"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Node allocator handing out 32-bit indices into fixed size slabs, the C++
+// counterpart of TbmAllocator in tbm/src/tbmlib.c3. Index 0 is never handed
+// out and stands for "no node".
+//
+// Any allocator plugged into slab_trie provides the same surface:
+//   uint32_t alloc(size_t nodes_count);          first index of a contiguous run
+//   void free(uint32_t idx, size_t nodes_count);
+//   Node& at(uint32_t idx);
+//   size_t memory_usage() const;
+//
+// The slabs come from SlabAlloc, huge_page_allocator puts them on 2M pages.
+template <typename Node, unsigned SLAB_SHIFT = 12, typename SlabAlloc = std::allocator<Node>>
+class slab_allocator {
+public:
+    static constexpr uint32_t null = 0;
+    static constexpr size_t slab_size = size_t(1) << SLAB_SHIFT;
+
+    slab_allocator() = default;
+    slab_allocator(slab_allocator&&) = default;
+    slab_allocator& operator=(slab_allocator&&) = default;
+
+    uint32_t alloc(size_t nodes_count) {
+        if (nodes_count == 0 || nodes_count > slab_size) {
+            throw std::invalid_argument(fmt::format("invalid nodes count {}", nodes_count));
+        }
+
+        if (nodes_count == 1 && !free_list.empty()) {
+            uint32_t idx = free_list.back();
+            free_list.pop_back();
+            at(idx) = Node{};
+            return idx;
+        }
+
+        // a run never crosses a slab boundary.
+        if ((next & (slab_size - 1)) + nodes_count > slab_size) {
+            next = (next | (slab_size - 1)) + 1;
+        }
+        if (uint64_t(next) + nodes_count > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("slab allocator out of 32-bit node indices");
+        }
+        while ((next >> SLAB_SHIFT) >= slabs.size()) {
+            Node* slab = SlabAlloc().allocate(slab_size);
+            std::uninitialized_value_construct_n(slab, slab_size);
+            slabs.emplace_back(slab);
+        }
+
+        uint32_t idx = next;
+        next += nodes_count;
+        return idx;
+    }
+
+    void free(uint32_t idx, size_t nodes_count) {
+        for (size_t i = 0; i < nodes_count; i++) {
+            free_list.push_back(idx + i);
+        }
+    }
+
+    Node& at(uint32_t idx) {
+        return slabs[idx >> SLAB_SHIFT][idx & (slab_size - 1)];
+    }
+
+    const Node& at(uint32_t idx) const {
+        return slabs[idx >> SLAB_SHIFT][idx & (slab_size - 1)];
+    }
+
+    size_t memory_usage() const {
+        return slabs.size() * slab_size * sizeof(Node) +
+               slabs.capacity() * sizeof(slabs[0]) +
+               free_list.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct slab_delete {
+        void operator()(Node* slab) const {
+            std::destroy_n(slab, slab_size);
+            SlabAlloc().deallocate(slab, slab_size);
+        }
+    };
+
+    std::vector<std::unique_ptr<Node[], slab_delete>> slabs;
+    std::vector<uint32_t> free_list;
+    uint32_t next = 1;
+};
+
+template<typename T>
+struct slab_trie_node {
+    uint32_t left = 0;
+    uint32_t right = 0;
+    T value = init_value<T>();
+
+    bool has_info() const {
+        return value != init_value<T>();
+    }
+};
+
+// Binary trie with the surface of trie<T> whose nodes live in an allocator
+// and link to each other with 32-bit indices instead of owning pointers.
+template <typename T, typename Alloc = slab_allocator<slab_trie_node<T>>>
+class slab_trie {
+public:
+    using node = slab_trie_node<T>;
+    static constexpr uint32_t null = 0;
+
+    slab_trie() : root{nodes.alloc(1)} {}
+
+    template<typename P>
+    void insert(prefix<P> p, T value) {
+        uint32_t curr = root;
+        while (p.len) {
+            uint32_t next = child(curr, p.highest_bit_is_set());
+            if (next == null) {
+                // alloc may grow the slab table, take the reference after it.
+                next = nodes.alloc(1);
+                (p.highest_bit_is_set() ? nodes.at(curr).right : nodes.at(curr).left) = next;
+            }
+            curr = next;
+            p.v <<= 1;
+            p.len--;
+        }
+        nodes.at(curr).value = value;
+    }
+
+    template<typename P>
+    std::optional<T> find(prefix<P> p) const {
+        uint32_t curr = root;
+        while (p.len) {
+            curr = child(curr, p.highest_bit_is_set());
+            if (curr == null) {
+                return std::nullopt;
+            }
+            p.v <<= 1;
+            p.len--;
+        }
+        return nodes.at(curr).value;
+    }
+
+    // longest prefix match of the key, only nodes with info are candidates.
+    template<typename P>
+    std::optional<T> lookup(P key) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+        uint32_t curr = root;
+        std::optional<T> best;
+        unsigned bits = sizeof(P) * 8;
+
+        while (true) {
+            const node& n = nodes.at(curr);
+            if (n.has_info()) {
+                best = n.value;
+            }
+            if (bits == 0) {
+                break;
+            }
+            curr = (key & (P(1) << (sizeof(P) * 8 - 1))) ? n.right : n.left;
+            if (curr == null) {
+                break;
+            }
+            key <<= 1;
+            bits--;
+        }
+        return best;
+    }
+
+    template<typename P>
+    void dump(std::vector<prefix<P>>& prefixes) const {
+        dump(root, prefix<P>{0, 0}, prefixes);
+    }
+
+    size_t max_depth() const {
+        return max_depth(root);
+    }
+
+    size_t node_count() const {
+        return node_count(root);
+    }
+
+    size_t memory_usage() const {
+        return nodes.memory_usage();
+    }
+
+    // removes p, and with it the nodes left with neither info nor children on
+    // its path, freed back to the allocator for later inserts. False if p had
+    // no info.
+    template<typename P>
+    bool erase(prefix<P> p) {
+        // path[d] is the node at depth d on the way to p.
+        std::array<uint32_t, sizeof(P) * 8 + 1> path;
+        path[0] = root;
+        unsigned depth = 0;
+        for (; p.len; p.v <<= 1, p.len--) {
+            uint32_t next = child(path[depth], p.highest_bit_is_set());
+            if (next == null) {
+                return false;
+            }
+            path[++depth] = next;
+        }
+        if (!nodes.at(path[depth]).has_info()) {
+            return false;
+        }
+        nodes.at(path[depth]).value = init_value<T>();
+        for (; depth > 0; depth--) {
+            const node& n = nodes.at(path[depth]);
+            if (n.has_info() || n.left != null || n.right != null) {
+                break;
+            }
+            node& parent = nodes.at(path[depth - 1]);
+            (parent.left == path[depth] ? parent.left : parent.right) = null;
+            nodes.free(path[depth], 1);
+        }
+        return true;
+    }
+
+    // Re-lays-out every node into a fresh allocator in depth first pre-order,
+    // a node, its left subtree, then its right one, so a walk mostly moves
+    // forward through memory and freed holes disappear.
+    void compact() {
+        struct pending {
+            uint32_t old_idx;
+            // the new node of the parent, null for the root.
+            uint32_t parent;
+            bool right;
+        };
+
+        Alloc fresh;
+        uint32_t new_root = null;
+        std::vector<pending> stack{{root, null, false}};
+        while (!stack.empty()) {
+            auto [old_idx, parent, right] = stack.back();
+            stack.pop_back();
+            const node& n = nodes.at(old_idx);
+
+            uint32_t idx = fresh.alloc(1);
+            fresh.at(idx).value = n.value;
+            if (parent == null) {
+                new_root = idx;
+            } else {
+                (right ? fresh.at(parent).right : fresh.at(parent).left) = idx;
+            }
+
+            if (n.right != null) {
+                stack.push_back({n.right, idx, true});
+            }
+            if (n.left != null) {
+                stack.push_back({n.left, idx, false});
+            }
+        }
+
+        nodes = std::move(fresh);
+        root = new_root;
+    }
+
+private:
+    uint32_t child(uint32_t idx, bool right) const {
+        const node& n = nodes.at(idx);
+        return right ? n.right : n.left;
+    }
+
+    template<typename P>
+    void dump(uint32_t idx, prefix<P> p, std::vector<prefix<P>>& prefixes) const {
+        const node& n = nodes.at(idx);
+        if (n.has_info()) {
+            prefixes.push_back(p);
+        }
+        if (n.left != null) {
+            dump(n.left, prefix<P>(p.v, p.len + 1), prefixes);
+        }
+        if (n.right != null) {
+            dump(n.right, prefix<P>(p.v | (P(1) << (sizeof(P) * 8 - 1 - p.len)), p.len + 1), prefixes);
+        }
+    }
+
+    size_t max_depth(uint32_t idx) const {
+        const node& n = nodes.at(idx);
+        size_t depth = 0;
+        if (n.left != null) {
+            depth = std::max(depth, 1 + max_depth(n.left));
+        }
+        if (n.right != null) {
+            depth = std::max(depth, 1 + max_depth(n.right));
+        }
+        return depth;
+    }
+
+    size_t node_count(uint32_t idx) const {
+        const node& n = nodes.at(idx);
+        return 1 + (n.left != null ? node_count(n.left) : 0) + (n.right != null ? node_count(n.right) : 0);
+    }
+
+    Alloc nodes;
+    uint32_t root;
+};
+
+// slab_trie on 2M pages: 2^19 nodes a slab, 6M with 12-byte nodes, a whole
+// number of huge pages.
+template <typename T>
+using huge_slab_trie = slab_trie<T, slab_allocator<slab_trie_node<T>, 19, huge_page_allocator<slab_trie_node<T>>>>;
+
+#endif
@@ -0,0 +1,181 @@
+#include "slab_trie.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(SlabAllocator, Test1) {
+    slab_allocator<slab_trie_node<uint32_t>, 4> alloc;
+    uint32_t a = alloc.alloc(1);
+    EXPECT_EQ(a, 1);
+    uint32_t b = alloc.alloc(15);
+    // the run does not fit in the rest of the first slab.
+    EXPECT_EQ(b, 16);
+    alloc.free(a, 1);
+    EXPECT_EQ(alloc.alloc(1), a);
+    EXPECT_THROW(alloc.alloc(17), std::invalid_argument);
+}
+
+TEST(SlabTrie, Test1) {
+    slab_trie<uint32_t> st;
+    st.insert<uint16_t>({0x1234, 16}, 1);
+    st.insert<uint16_t>({0x4, 16}, 2);
+    EXPECT_EQ(st.max_depth(), 16);
+    EXPECT_EQ(st.find<uint16_t>({0x1234, 16}), 1);
+    EXPECT_EQ(st.find<uint16_t>({0x4, 16}), 2);
+
+    std::vector<prefix<uint16_t>> prefixes;
+    st.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::UnorderedElementsAre(
+        prefix<uint16_t>{0x1234, 16},
+        prefix<uint16_t>{0x4, 16}
+    ));
+}
+
+TEST(SlabTrie, SameAsTrie) {
+    std::mt19937 rng(5);
+    trie<uint32_t> bt;
+    slab_trie<uint32_t, slab_allocator<slab_trie_node<uint32_t>, 6>> st;
+    std::vector<prefix<uint32_t>> inserted;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        bt.insert<uint32_t>({v, len}, i);
+        st.insert<uint32_t>({v, len}, i);
+        inserted.emplace_back(v, len);
+    }
+    EXPECT_EQ(st.node_count(), bt.node_count());
+
+    auto check = [&] {
+        for (const auto& p : inserted) {
+            EXPECT_EQ(st.find(p), bt.find(p)) << p.show();
+        }
+        for (int i = 0; i < 3000; i++) {
+            uint32_t key = rng();
+            EXPECT_EQ(st.lookup(key), bt.lookup(key)) << key;
+        }
+        std::vector<prefix<uint32_t>> expected, dumped;
+        bt.dump(expected);
+        st.dump(dumped);
+        EXPECT_THAT(dumped, testing::UnorderedElementsAreArray(expected));
+        EXPECT_EQ(st.max_depth(), bt.max_depth());
+    };
+
+    check();
+    st.compact();
+    check();
+    EXPECT_EQ(st.node_count(), bt.node_count());
+}
+
+TEST(SlabTrie, Erase) {
+    std::mt19937 rng(7);
+    slab_trie<uint32_t, slab_allocator<slab_trie_node<uint32_t>, 6>> st;
+    trie<uint32_t> all;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        st.insert<uint32_t>({v, len}, i);
+        all.insert<uint32_t>({v, len}, i);
+    }
+    size_t nodes = st.node_count();
+
+    // every other prefix out, the rest in a trie of their own.
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> erased;
+    trie<uint32_t> kept;
+    bool out = false;
+    for (auto [p, value] : all.entries<uint32_t>()) {
+        if ((out = !out)) {
+            EXPECT_TRUE(st.erase(p));
+            EXPECT_FALSE(st.erase(p));
+            erased.emplace_back(p, value);
+        } else {
+            kept.insert(p, value);
+        }
+    }
+    EXPECT_FALSE(st.erase(prefix<uint32_t>(0x12345678, 32)));
+    // the nodes only erased prefixes needed are gone.
+    EXPECT_EQ(st.node_count(), kept.node_count());
+    EXPECT_LT(st.node_count(), nodes);
+    for (const auto& [p, value] : erased) {
+        EXPECT_EQ(st.find(p).value_or(0), 0u) << p.show();
+    }
+    for (int i = 0; i < 3000; i++) {
+        uint32_t key = rng();
+        EXPECT_EQ(st.lookup(key), kept.lookup(key)) << key;
+    }
+
+    // putting them back takes the freed slots, no new slab.
+    size_t bytes = st.memory_usage();
+    for (const auto& [p, value] : erased) {
+        st.insert(p, value);
+    }
+    EXPECT_EQ(st.node_count(), nodes);
+    EXPECT_EQ(st.memory_usage(), bytes);
+    for (int i = 0; i < 3000; i++) {
+        uint32_t key = rng();
+        EXPECT_EQ(st.lookup(key), all.lookup(key)) << key;
+    }
+
+    // all gone, the root alone is left.
+    for (auto [p, value] : all.entries<uint32_t>()) {
+        st.erase(p);
+    }
+    EXPECT_EQ(st.node_count(), 1);
+    st.compact();
+    EXPECT_EQ(st.node_count(), 1);
+    EXPECT_EQ(st.lookup(uint32_t(1)), std::nullopt);
+}
+
+TEST(HugePages, Map) {
+    auto& stats = huge_page_stats();
+    uint64_t before = stats.hugetlb + stats.thp_requested + stats.plain;
+    uint64_t bytes = stats.bytes;
+    page_backing got;
+    auto* p = static_cast<char*>(huge_page_map(3 << 20, &got));
+    // one mapping of two huge pages, aligned for THP.
+    EXPECT_EQ(stats.hugetlb + stats.thp_requested + stats.plain, before + 1);
+    EXPECT_EQ(stats.bytes, bytes + (4 << 20));
+    EXPECT_EQ(uintptr_t(p) % huge_page_size, 0);
+    EXPECT_EQ(p[0], 0);
+    p[(4 << 20) - 1] = 1;
+    huge_page_unmap(p, 3 << 20);
+    EXPECT_EQ(stats.bytes, bytes);
+
+    // small blocks stay on the heap.
+    huge_page_allocator<uint32_t> a;
+    uint32_t* q = a.allocate(16);
+    EXPECT_EQ(stats.hugetlb + stats.thp_requested + stats.plain, before + 1);
+    a.deallocate(q, 16);
+}
+
+TEST(HugePages, SlabTrie) {
+    auto& stats = huge_page_stats();
+    uint64_t before = stats.hugetlb + stats.thp_requested + stats.plain;
+    uint64_t bytes = stats.bytes;
+    std::mt19937 rng(6);
+    trie<uint32_t> bt;
+    {
+        huge_slab_trie<uint32_t> st;
+        for (uint32_t i = 1; i <= 50000; i++) {
+            uint8_t len = 8 + rng() % 25;
+            uint32_t v = rng() & ~((uint64_t(1) << (32 - len)) - 1);
+            bt.insert<uint32_t>({v, len}, i);
+            st.insert<uint32_t>({v, len}, i);
+        }
+        // well under 2^19 nodes, a single slab.
+        EXPECT_EQ(stats.hugetlb + stats.thp_requested + stats.plain, before + 1);
+        EXPECT_EQ(st.node_count(), bt.node_count());
+        for (int i = 0; i < 10000; i++) {
+            uint32_t key = rng();
+            ASSERT_EQ(st.lookup(key), bt.lookup(key)) << key;
+        }
+        st.compact();
+        for (int i = 0; i < 10000; i++) {
+            uint32_t key = rng();
+            ASSERT_EQ(st.lookup(key), bt.lookup(key)) << key;
+        }
+    }
+    EXPECT_EQ(stats.bytes, bytes);
+}
+
@@ -0,0 +1,94 @@
+#include "bench_util.hh"
+#include "soa_vector.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// the fields of five_tuple, one column each.
+using tuple_columns = soa_vector<TypeList<uint32_t, uint32_t, uint16_t, uint16_t, uint8_t>>;
+
+constexpr size_t flow_count = 1 << 22;
+
+const std::vector<five_tuple>& flows_aos() {
+    static const auto flows = random_tuples(random_rules(1000), flow_count);
+    return flows;
+}
+
+const tuple_columns& flows_soa() {
+    static const auto flows = [] {
+        tuple_columns c;
+        c.reserve(flow_count);
+        for (const auto& t : flows_aos()) {
+            c.push_back(t.src, t.dst, t.src_port, t.dst_port, t.proto);
+        }
+        return c;
+    }();
+    return flows;
+}
+
+// https flows: tcp to port 443. 16 bytes a flow as structs, 3 as columns.
+void BM_filter_count_aos(benchmark::State& state) {
+    const auto& flows = flows_aos();
+    for (auto _ : state) {
+        size_t n = 0;
+        for (const auto& t : flows) {
+            n += (t.proto == 6) & (t.dst_port == 443);
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * flows.size());
+    state.SetBytesProcessed(state.iterations() * flows.size() * sizeof(five_tuple));
+}
+
+// a plain loop over the columns, gcc -O2 does not vectorize it.
+void BM_filter_count_soa(benchmark::State& state) {
+    const auto& flows = flows_soa();
+    const uint16_t* port = flows.data<3>();
+    const uint8_t* proto = flows.data<4>();
+    for (auto _ : state) {
+        size_t n = 0;
+        for (size_t i = 0; i < flows.size(); i++) {
+            n += (proto[i] == 6) & (port[i] == 443);
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * flows.size());
+    state.SetBytesProcessed(state.iterations() * flows.size() * (sizeof(uint16_t) + sizeof(uint8_t)));
+}
+
+// the same in blocks of a constant row count, vectorized.
+void BM_filter_count_soa_blocks(benchmark::State& state) {
+    const auto& flows = flows_soa();
+    for (auto _ : state) {
+        size_t n = 0;
+        flows.for_each_block<3, 4>([&](auto rows, const uint16_t* port, const uint8_t* proto) {
+            for (size_t i = 0; i < rows; i++) {
+                n += (proto[i] == 6) & (port[i] == 443);
+            }
+        });
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * flows.size());
+    state.SetBytesProcessed(state.iterations() * flows.size() * (sizeof(uint16_t) + sizeof(uint8_t)));
+}
+
+// the same filter on the row proxies: columns underneath, but one row at a
+// time.
+void BM_filter_count_soa_rows(benchmark::State& state) {
+    const auto& flows = flows_soa();
+    for (auto _ : state) {
+        size_t n = 0;
+        for (auto r : flows) {
+            n += (r.get<4>() == 6) & (r.get<3>() == 443);
+        }
+        benchmark::DoNotOptimize(n);
+    }
+    state.SetItemsProcessed(state.iterations() * flows.size());
+}
+
+}
+
+BENCHMARK(BM_filter_count_aos);
+BENCHMARK(BM_filter_count_soa);
+BENCHMARK(BM_filter_count_soa_blocks);
+BENCHMARK(BM_filter_count_soa_rows);
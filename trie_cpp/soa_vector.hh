@@ -0,0 +1,369 @@
+#ifndef SOA_VECTOR_HH
+#define SOA_VECTOR_HH
+
+#include <typelist.hh>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// Growable table of records stored as a structure of arrays: the record is a
+// TypeList of field types and every field lives in its own contiguous array,
+// 64-byte aligned. A pass over one or two fields of millions of records
+// reads only those, where a std::vector of structs drags whole records
+// through the cache, and a loop over columns is one the compiler vectorizes.
+//
+//   soa_vector<TypeList<uint32_t, uint16_t, uint8_t>> v;
+//   v.push_back(0x0a000001, 443, 6);
+//   v[0].get<1>() = 80;
+//   for (uint16_t port : v.column<1>()) ...
+//   v.for_each_block<1, 2>([&](auto rows, const uint16_t* port, const uint8_t* proto) { ... });
+//
+// Rows are reached through proxies holding the table and the row index, which
+// give references to the fields with get<I>() and convert to and from a
+// std::tuple of the fields, compared as that tuple. The iterators are
+// random access over the proxies, enough for std::sort with a comparator
+// on value_type or none. Fields must be trivially copyable, growing moves
+// the columns with memcpy.
+template <typename List>
+class soa_vector;
+
+template <typename... Fields>
+class soa_vector<TypeList<Fields...>> {
+public:
+    static_assert(sizeof...(Fields) > 0, "a record needs a field");
+    static_assert((std::is_trivially_copyable_v<Fields> && ...), "fields must be trivially copyable");
+
+    using fields = TypeList<Fields...>;
+    using value_type = std::tuple<Fields...>;
+    template <size_t I>
+    using field = typename atN<I, fields>::Type;
+
+    static constexpr size_t field_count = sizeof...(Fields);
+    static constexpr size_t alignment = 64;
+    // rows a for_each_block() call gets, the last one aside.
+    static constexpr size_t block_rows = 64;
+
+    template <bool Const>
+    class basic_reference {
+    public:
+        using table = std::conditional_t<Const, const soa_vector, soa_vector>;
+
+        basic_reference(table* t, size_t row) : t{t}, row{row} {}
+
+        template <size_t I>
+        auto& get() const {
+            return t->template data<I>()[row];
+        }
+
+        operator value_type() const {
+            return tuple(std::index_sequence_for<Fields...>());
+        }
+
+        // assigns the fields of the row, not the proxy.
+        const basic_reference& operator=(const value_type& v) const requires(!Const) {
+            assign(v, std::index_sequence_for<Fields...>());
+            return *this;
+        }
+
+        const basic_reference& operator=(const basic_reference& other) const requires(!Const) {
+            return *this = value_type(other);
+        }
+
+        bool operator==(const value_type& v) const {
+            return value_type(*this) == v;
+        }
+
+        auto operator<=>(const value_type& v) const {
+            return value_type(*this) <=> v;
+        }
+
+        operator basic_reference<true>() const requires(!Const) {
+            return {t, row};
+        }
+
+        // swaps the fields of two rows; the proxies are temporaries, so
+        // std::swap does not apply, std::sort and std::iter_swap find this.
+        friend void swap(const basic_reference& a, const basic_reference& b) requires(!Const) {
+            value_type tmp = a;
+            a = b;
+            b = tmp;
+        }
+
+    private:
+        template <size_t... I>
+        value_type tuple(std::index_sequence<I...>) const {
+            return value_type(get<I>()...);
+        }
+
+        template <size_t... I>
+        void assign(const value_type& v, std::index_sequence<I...>) const {
+            ((get<I>() = std::get<I>(v)), ...);
+        }
+
+        table* t;
+        size_t row;
+    };
+
+    using reference = basic_reference<false>;
+    using const_reference = basic_reference<true>;
+
+    // random access over the row proxies.
+    template <bool Const>
+    class basic_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = soa_vector::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = basic_reference<Const>;
+        using table = typename reference::table;
+
+        basic_iterator() = default;
+        basic_iterator(table* t, size_t row) : t{t}, row{row} {}
+
+        operator basic_iterator<true>() const requires(!Const) {
+            return {t, row};
+        }
+
+        reference operator*() const {
+            return {t, row};
+        }
+
+        reference operator[](difference_type n) const {
+            return {t, row + n};
+        }
+
+        basic_iterator& operator++() {
+            row++;
+            return *this;
+        }
+
+        basic_iterator operator++(int) {
+            auto old = *this;
+            row++;
+            return old;
+        }
+
+        basic_iterator& operator--() {
+            row--;
+            return *this;
+        }
+
+        basic_iterator operator--(int) {
+            auto old = *this;
+            row--;
+            return old;
+        }
+
+        basic_iterator& operator+=(difference_type n) {
+            row += n;
+            return *this;
+        }
+
+        basic_iterator& operator-=(difference_type n) {
+            row -= n;
+            return *this;
+        }
+
+        friend basic_iterator operator+(basic_iterator it, difference_type n) {
+            return it += n;
+        }
+
+        friend basic_iterator operator+(difference_type n, basic_iterator it) {
+            return it += n;
+        }
+
+        friend basic_iterator operator-(basic_iterator it, difference_type n) {
+            return it -= n;
+        }
+
+        friend difference_type operator-(const basic_iterator& a, const basic_iterator& b) {
+            return difference_type(a.row) - difference_type(b.row);
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return row == other.row;
+        }
+
+        auto operator<=>(const basic_iterator& other) const {
+            return row <=> other.row;
+        }
+
+    private:
+        table* t = nullptr;
+        size_t row = 0;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    soa_vector() = default;
+
+    soa_vector(const soa_vector& other) {
+        reserve(other.n);
+        n = other.n;
+        copy_columns(other, std::index_sequence_for<Fields...>());
+    }
+
+    soa_vector(soa_vector&& other) noexcept
+        : columns{std::exchange(other.columns, {})}, n{std::exchange(other.n, 0)}, cap{std::exchange(other.cap, 0)} {}
+
+    soa_vector& operator=(soa_vector other) noexcept {
+        std::swap(columns, other.columns);
+        std::swap(n, other.n);
+        std::swap(cap, other.cap);
+        return *this;
+    }
+
+    ~soa_vector() {
+        std::apply([](auto*... c) { (release(c), ...); }, columns);
+    }
+
+    // by value: a field of a row of this table stays valid across growing.
+    void push_back(Fields... f) {
+        if (n == cap) {
+            reserve(std::max<size_t>(alignment, cap * 2));
+        }
+        std::apply([&](auto*... c) { ((c[n] = f), ...); }, columns);
+        n++;
+    }
+
+    void push_back(const value_type& v) {
+        std::apply([&](const Fields&... f) { push_back(f...); }, v);
+    }
+
+    // new rows are value initialized.
+    void resize(size_t size) {
+        reserve(size);
+        if (size > n) {
+            std::apply([&](auto*... c) { (std::uninitialized_value_construct(c + n, c + size), ...); }, columns);
+        }
+        n = size;
+    }
+
+    // capacity rounded up to whole cache lines of the narrowest column.
+    void reserve(size_t size) {
+        if (size <= cap) {
+            return;
+        }
+        size_t new_cap = (size + alignment - 1) / alignment * alignment;
+        std::apply([&](auto*&... c) { (grow(c, new_cap), ...); }, columns);
+        cap = new_cap;
+    }
+
+    void clear() {
+        n = 0;
+    }
+
+    size_t size() const {
+        return n;
+    }
+
+    bool empty() const {
+        return n == 0;
+    }
+
+    size_t capacity() const {
+        return cap;
+    }
+
+    reference operator[](size_t row) {
+        return {this, row};
+    }
+
+    const_reference operator[](size_t row) const {
+        return {this, row};
+    }
+
+    iterator begin() {
+        return {this, 0};
+    }
+
+    iterator end() {
+        return {this, n};
+    }
+
+    const_iterator begin() const {
+        return {this, 0};
+    }
+
+    const_iterator end() const {
+        return {this, n};
+    }
+
+    // the array of field I, aligned to 64 bytes.
+    template <size_t I>
+    field<I>* data() {
+        return std::assume_aligned<alignment>(std::get<I>(columns));
+    }
+
+    template <size_t I>
+    const field<I>* data() const {
+        return std::assume_aligned<alignment>(std::get<I>(columns));
+    }
+
+    template <size_t I>
+    std::span<field<I>> column() {
+        return {data<I>(), n};
+    }
+
+    template <size_t I>
+    std::span<const field<I>> column() const {
+        return {data<I>(), n};
+    }
+
+    // calls f(rows, columns I... from the first row of the block) for blocks
+    // of block_rows rows, then for the rest. rows is a std::integral_constant
+    // for the full blocks, so the loop of f over them has a constant trip
+    // count, one gcc vectorizes even at -O2.
+    template <size_t... I, typename F>
+    void for_each_block(F&& f) const {
+        size_t i = 0;
+        for (; i + block_rows <= n; i += block_rows) {
+            f(std::integral_constant<size_t, block_rows>(), (data<I>() + i)...);
+        }
+        if (i < n) {
+            f(n - i, (data<I>() + i)...);
+        }
+    }
+
+    // bytes of the columns.
+    size_t memory_usage() const {
+        return cap * (sizeof(Fields) + ...);
+    }
+
+private:
+    template <typename F>
+    static void release(F* c) {
+        if (c) {
+            ::operator delete(c, std::align_val_t(alignment));
+        }
+    }
+
+    template <typename F>
+    void grow(F*& c, size_t new_cap) {
+        auto* fresh = static_cast<F*>(::operator new(new_cap * sizeof(F), std::align_val_t(alignment)));
+        if (n) {
+            std::memcpy(fresh, c, n * sizeof(F));
+        }
+        release(c);
+        c = fresh;
+    }
+
+    template <size_t... I>
+    void copy_columns(const soa_vector& other, std::index_sequence<I...>) {
+        ((n ? std::memcpy(std::get<I>(columns), std::get<I>(other.columns), n * sizeof(field<I>)) : nullptr), ...);
+    }
+
+    std::tuple<Fields*...> columns{};
+    size_t n = 0;
+    size_t cap = 0;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "soa_vector.hh"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+using flows = soa_vector<TypeList<uint32_t, uint16_t, uint8_t, double>>;
+static_assert(std::is_same_v<flows::field<1>, uint16_t>);
+static_assert(std::is_same_v<flows::field<3>, double>);
+static_assert(flows::field_count == 4);
+static_assert(std::random_access_iterator<flows::const_iterator>);
+static_assert(std::is_convertible_v<flows::iterator, flows::const_iterator>);
+
+}
+
+TEST(SoaVector, Test1) {
+    flows v;
+    EXPECT_TRUE(v.empty());
+    v.push_back(0x0a000001, 443, 6, 1.5);
+    v.push_back({0x0a000002, 80, 17, 2.5});
+    ASSERT_EQ(v.size(), 2);
+    EXPECT_EQ(v[0].get<0>(), 0x0a000001u);
+    EXPECT_EQ(v[1].get<1>(), 80);
+    EXPECT_TRUE(v[1] == std::make_tuple(0x0a000002u, uint16_t(80), uint8_t(17), 2.5));
+
+    // a row proxy writes through to the columns.
+    v[0].get<1>() = 8443;
+    v[1] = v[0];
+    EXPECT_EQ(v.column<1>()[1], 8443);
+    flows::value_type row = v[1];
+    EXPECT_EQ(std::get<2>(row), 6);
+
+    // every column on its own cache line aligned array.
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data<0>()) % flows::alignment, 0);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(v.data<2>()) % flows::alignment, 0);
+    EXPECT_EQ(v.capacity() % flows::alignment, 0);
+    EXPECT_EQ(v.memory_usage(), v.capacity() * (4 + 2 + 1 + 8));
+}
+
+TEST(SoaVector, SameAsVector) {
+    std::mt19937 rng(1);
+    flows v;
+    std::vector<flows::value_type> expected;
+    for (int i = 0; i < 10000; i++) {
+        flows::value_type r(rng(), rng(), rng(), rng() / 7.0);
+        v.push_back(r);
+        expected.push_back(r);
+        // a row of the table itself, the table growing under it.
+        if (i % 1000 == 999) {
+            v.push_back(v[i / 2]);
+            expected.push_back(expected[i / 2]);
+        }
+    }
+    ASSERT_EQ(v.size(), expected.size());
+    size_t i = 0;
+    for (auto r : v) {
+        ASSERT_TRUE(r == expected[i]) << i;
+        i++;
+    }
+    EXPECT_EQ(v.end() - v.begin(), v.size());
+
+    auto ports = v.column<1>();
+    size_t sum = std::accumulate(ports.begin(), ports.end(), size_t(0));
+    size_t expected_sum = 0;
+    for (const auto& r : expected) {
+        expected_sum += std::get<1>(r);
+    }
+    EXPECT_EQ(sum, expected_sum);
+
+    // copies are deep, moves take the columns.
+    flows copy = v;
+    copy[0].get<0>() = ~v[0].get<0>();
+    EXPECT_NE(copy[0].get<0>(), v[0].get<0>());
+    flows moved = std::move(copy);
+    EXPECT_EQ(moved.size(), v.size());
+    EXPECT_EQ(copy.size(), 0);
+    copy = moved;
+    EXPECT_TRUE(copy[5] == expected[5]);
+
+    // the blocks cover every row once, full ones with a constant count.
+    size_t rows_seen = 0, full = 0, block_sum = 0;
+    v.for_each_block<1>([&](auto rows, const uint16_t* port) {
+        if constexpr (!std::is_same_v<decltype(rows), size_t>) {
+            static_assert(rows == flows::block_rows);
+            full++;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            block_sum += port[i];
+        }
+        rows_seen += rows;
+    });
+    EXPECT_EQ(rows_seen, v.size());
+    EXPECT_EQ(full, v.size() / flows::block_rows);
+    EXPECT_EQ(block_sum, expected_sum);
+
+    // sorted in place through the proxies, as the rows would be.
+    std::sort(v.begin(), v.end());
+    std::sort(expected.begin(), expected.end());
+    for (size_t i = 0; i < v.size(); i++) {
+        ASSERT_TRUE(v[i] == expected[i]) << i;
+    }
+    auto by_port = [](const flows::value_type& a, const flows::value_type& b) {
+        return std::get<1>(a) < std::get<1>(b);
+    };
+    std::stable_sort(v.begin(), v.end(), by_port);
+    std::stable_sort(expected.begin(), expected.end(), by_port);
+    std::iter_swap(v.begin(), v.begin() + 1);
+    std::iter_swap(expected.begin(), expected.begin() + 1);
+    for (size_t i = 0; i < v.size(); i++) {
+        ASSERT_TRUE(v[i] == expected[i]) << i;
+    }
+    flows::const_iterator first = v.begin();
+    EXPECT_TRUE(*first == expected[0]);
+
+    v.resize(v.size() + 3);
+    EXPECT_TRUE(v[v.size() - 1] == flows::value_type{});
+    v.resize(2);
+    EXPECT_EQ(v.size(), 2);
+    v.clear();
+    EXPECT_TRUE(v.empty());
+    EXPECT_EQ(v.begin(), v.end());
+}
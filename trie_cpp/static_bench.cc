@@ -0,0 +1,54 @@
+#include "bench_util.hh"
+#include "static_trie.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// IPv4 special purpose ranges, the value being the index in the list.
+constexpr std::pair<prefix<uint32_t>, uint32_t> bogons[] = {
+    {{0x00000000, 8}, 1},   {{0x0a000000, 8}, 2},   {{0x64400000, 10}, 3}, {{0x7f000000, 8}, 4},
+    {{0xa9fe0000, 16}, 5},  {{0xac100000, 12}, 6},  {{0xc0000200, 24}, 7}, {{0xc0a80000, 16}, 8},
+    {{0xc6120000, 15}, 9},  {{0xc6336400, 24}, 10}, {{0xcb007100, 24}, 11}, {{0xe0000000, 4}, 12},
+    {{0xf0000000, 4}, 13},  {{0xffffffff, 32}, 14},
+};
+
+constexpr auto bogon_trie = make_static_trie<bogons>();
+
+// what a process pays at startup for the same table without static_trie.
+void BM_bogon_build(benchmark::State& state) {
+    for (auto _ : state) {
+        trie<uint32_t> t;
+        for (const auto& [p, v] : bogons) {
+            t.insert(p, v);
+        }
+        benchmark::DoNotOptimize(&t);
+    }
+}
+
+template <typename Table>
+void BM_bogon_lookup(benchmark::State& state, const Table& t) {
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(t.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_bogon_lookup_trie(benchmark::State& state) {
+    trie<uint32_t> t;
+    for (const auto& [p, v] : bogons) {
+        t.insert(p, v);
+    }
+    BM_bogon_lookup(state, t);
+}
+
+void BM_bogon_lookup_static(benchmark::State& state) {
+    BM_bogon_lookup(state, bogon_trie);
+}
+
+}
+
+BENCHMARK(BM_bogon_build);
+BENCHMARK(BM_bogon_lookup_trie);
+BENCHMARK(BM_bogon_lookup_static);
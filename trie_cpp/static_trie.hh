@@ -0,0 +1,113 @@
+#ifndef STATIC_TRIE_HH
+#define STATIC_TRIE_HH
+
+#include "trie.hh"
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+
+// Binary trie built by the compiler out of a constexpr table of (prefix,
+// value) pairs, for the tables that never change: bogons, RFC 1918 and other
+// special purpose ranges. A constexpr static_trie is constant initialized, so
+// it sits in .rodata, costs nothing at startup and never touches the heap.
+//
+//   constexpr std::pair<prefix<uint32_t>, uint32_t> table[] = {{{0x0a000000, 8}, 1}, ...};
+//   constexpr auto t = make_static_trie<table>();
+//   static_assert(t.lookup(0x0a010203u) == 1u);
+//
+// The nodes are an array linked by index as in trie_view, the root first, so
+// index 0 means no child. find() and lookup() answer as the ones of a trie<T>
+// holding the same table, at compile time or at runtime.
+template <typename T>
+struct static_trie_node {
+    uint32_t child[2];
+    T value;
+};
+
+template <typename T, typename P, size_t N>
+class static_trie {
+public:
+    static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+    static constexpr unsigned width = sizeof(P) * 8;
+
+    constexpr std::optional<T> find(prefix<P> p) const {
+        uint32_t n = 0;
+        for (unsigned d = 0; d < p.len; d++) {
+            n = nodes[n].child[(p.v >> (width - 1 - d)) & 1];
+            if (!n) {
+                return std::nullopt;
+            }
+        }
+        return nodes[n].value;
+    }
+
+    // longest prefix match of the key, only nodes with info are candidates.
+    constexpr std::optional<T> lookup(P key) const {
+        std::optional<T> best;
+        uint32_t n = 0;
+        for (unsigned d = 0;; d++) {
+            if (nodes[n].value != init_value<T>()) {
+                best = nodes[n].value;
+            }
+            if (d == width) {
+                break;
+            }
+            n = nodes[n].child[(key >> (width - 1 - d)) & 1];
+            if (!n) {
+                break;
+            }
+        }
+        return best;
+    }
+
+    constexpr size_t node_count() const {
+        return N;
+    }
+
+    std::array<static_trie_node<T>, N> nodes;
+};
+
+template <const auto& Table>
+using static_trie_entry = std::remove_cvref_t<decltype(*std::begin(Table))>;
+
+// inserts Table into t as trie<T>::insert() would, later duplicates
+// winning, and returns the number of nodes used.
+template <const auto& Table, typename T, typename P, size_t Cap>
+constexpr size_t static_trie_insert(static_trie<T, P, Cap>& t) {
+    constexpr unsigned width = sizeof(P) * 8;
+    size_t used = 1;
+    t.nodes[0] = {{0, 0}, init_value<T>()};
+    for (const auto& [p, value] : Table) {
+        uint32_t n = 0;
+        for (unsigned d = 0; d < p.len; d++) {
+            uint32_t& c = t.nodes[n].child[(p.v >> (width - 1 - d)) & 1];
+            if (!c) {
+                t.nodes[used] = {{0, 0}, init_value<T>()};
+                c = uint32_t(used++);
+            }
+            n = c;
+        }
+        t.nodes[n].value = value;
+    }
+    return used;
+}
+
+// the trie of a constexpr array of std::pair<prefix<P>, T>, sized exactly:
+// built once at the worst case size, a node per bit of every prefix, to
+// count the nodes, then again.
+template <const auto& Table>
+constexpr auto make_static_trie() {
+    using T = decltype(static_trie_entry<Table>{}.second);
+    using P = decltype(static_trie_entry<Table>{}.first.v);
+    constexpr size_t n = [] {
+        static_trie<T, P, 1 + std::size(Table) * sizeof(P) * 8> t{};
+        return static_trie_insert<Table>(t);
+    }();
+    static_trie<T, P, n> t{};
+    static_trie_insert<Table>(t);
+    return t;
+}
+
+#endif
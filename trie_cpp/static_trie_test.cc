@@ -0,0 +1,155 @@
+#include "static_trie.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+namespace {
+
+enum class bogon : uint8_t { none, this_network, private_use, shared, loopback, link_local, documentation, benchmark, multicast, reserved };
+
+// IPv4 special purpose ranges (RFC 6890 and friends).
+constexpr std::pair<prefix<uint32_t>, bogon> bogons[] = {
+    {{0x00000000, 8}, bogon::this_network},
+    {{0x0a000000, 8}, bogon::private_use},
+    {{0x64400000, 10}, bogon::shared},
+    {{0x7f000000, 8}, bogon::loopback},
+    {{0xa9fe0000, 16}, bogon::link_local},
+    {{0xac100000, 12}, bogon::private_use},
+    {{0xc0000200, 24}, bogon::documentation},
+    {{0xc0a80000, 16}, bogon::private_use},
+    {{0xc6120000, 15}, bogon::benchmark},
+    {{0xc6336400, 24}, bogon::documentation},
+    {{0xcb007100, 24}, bogon::documentation},
+    {{0xe0000000, 4}, bogon::multicast},
+    {{0xf0000000, 4}, bogon::reserved},
+    // limited broadcast, a more specific of 240.0.0.0/4.
+    {{0xffffffff, 32}, bogon::this_network},
+};
+
+constexpr auto bogon_trie = make_static_trie<bogons>();
+
+// nested and repeated prefixes, a default route and a /32 with the value
+// that stands for no info.
+constexpr std::pair<prefix<uint32_t>, uint32_t> nested[] = {
+    {{0x00000000, 0}, 1},  {{0x0a000000, 8}, 2},  {{0x0a010000, 16}, 3}, {{0x0a010100, 24}, 4},
+    {{0x0a010101, 32}, 5}, {{0x0a010000, 16}, 6}, {{0x0a010102, 32}, 0}, {{0x80000000, 1}, 7},
+};
+
+constexpr auto nested_trie = make_static_trie<nested>();
+
+constexpr std::pair<prefix<uint128_t>, uint32_t> v6[] = {
+    {{uint128_t(0xfc00) << 112, 7}, 1},
+    {{uint128_t(0xfe80) << 112, 10}, 2},
+    {{uint128_t(0x20010db8) << 96, 32}, 3},
+    {{uint128_t(1), 128}, 4},
+};
+
+constexpr auto v6_trie = make_static_trie<v6>();
+
+// longest match by scanning the table: the last value of every prefix
+// counts, and only if it is not the one for no info.
+template <typename T, typename P, size_t N>
+constexpr std::optional<T> linear_lookup(const std::pair<prefix<P>, T> (&table)[N], P key) {
+    std::optional<T> best;
+    int best_len = -1;
+    for (size_t i = 0; i < N; i++) {
+        const auto& [p, value] = table[i];
+        bool match = p.len == 0 || ((key ^ p.v) >> (sizeof(P) * 8 - p.len)) == 0;
+        bool last = true;
+        for (size_t j = i + 1; j < N; j++) {
+            last &= !(table[j].first == p);
+        }
+        if (match && last && value != init_value<T>() && p.len > best_len) {
+            best_len = p.len;
+            best = value;
+        }
+    }
+    return best;
+}
+
+// the first and last address of every prefix and the ones just outside.
+template <typename T, typename P, size_t N, size_t M>
+constexpr bool same_as_linear(const std::pair<prefix<P>, T> (&table)[N], const static_trie<T, P, M>& t) {
+    for (const auto& [p, value] : table) {
+        P last = p.len ? P(p.v | ((P(1) << (sizeof(P) * 8 - p.len)) - 1)) : P(~P(0));
+        for (P k : {p.v, P(p.v - 1), last, P(last + 1)}) {
+            if (t.lookup(k) != linear_lookup(table, k)) {
+                return false;
+            }
+        }
+        if (!t.find(p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(same_as_linear(bogons, bogon_trie));
+static_assert(same_as_linear(nested, nested_trie));
+static_assert(same_as_linear(v6, v6_trie));
+
+static_assert(bogon_trie.lookup(0x0a010203u) == bogon::private_use);
+static_assert(bogon_trie.lookup(0xac1f0001u) == bogon::private_use);
+static_assert(bogon_trie.lookup(0xac200001u) == std::nullopt);
+static_assert(bogon_trie.lookup(0xfffffffeu) == bogon::reserved);
+static_assert(bogon_trie.lookup(0xffffffffu) == bogon::this_network);
+static_assert(bogon_trie.lookup(0x08080808u) == std::nullopt);
+static_assert(nested_trie.lookup(0x0a010101u) == 5u);
+static_assert(nested_trie.lookup(0x0a010102u) == 4u);
+static_assert(nested_trie.lookup(0x0a01ff00u) == 6u);
+static_assert(nested_trie.lookup(0x0b000000u) == 1u);
+static_assert(nested_trie.find(prefix<uint32_t>(0x0a010000, 16)) == 6u);
+static_assert(nested_trie.find(prefix<uint32_t>(0x0a000000, 9)) == 0u);
+static_assert(nested_trie.find(prefix<uint32_t>(0x0b000000, 8)) == std::nullopt);
+static_assert(v6_trie.lookup((uint128_t(0x20010db8) << 96) | 1) == 3u);
+static_assert(v6_trie.lookup(uint128_t(1)) == 4u);
+static_assert(v6_trie.lookup(uint128_t(2)) == std::nullopt);
+
+// plain data sized to the table, nothing to construct at startup.
+static_assert(std::is_trivially_copyable_v<decltype(bogon_trie)>);
+static_assert(sizeof(bogon_trie) == bogon_trie.node_count() * sizeof(static_trie_node<bogon>));
+
+template <typename T, typename P, size_t N>
+std::unique_ptr<trie<T>> runtime_trie(const std::pair<prefix<P>, T> (&table)[N]) {
+    auto t = std::make_unique<trie<T>>();
+    for (const auto& [p, value] : table) {
+        t->insert(p, value);
+    }
+    return t;
+}
+
+}
+
+TEST(StaticTrie, SameAsTrie) {
+    auto bt = runtime_trie(bogons);
+    auto nt = runtime_trie(nested);
+    EXPECT_EQ(bogon_trie.node_count(), bt->node_count());
+    EXPECT_EQ(nested_trie.node_count(), nt->node_count());
+
+    std::mt19937 rng(1);
+    for (int i = 0; i < 100000; i++) {
+        uint32_t k = rng();
+        // the bogon space is small, half of the keys land next to a prefix.
+        if (i % 2) {
+            k = bogons[rng() % std::size(bogons)].first.v ^ (rng() >> (rng() % 32));
+        }
+        ASSERT_EQ(bogon_trie.lookup(k), bt->lookup(k)) << k;
+        ASSERT_EQ(nested_trie.lookup(k), nt->lookup(k)) << k;
+        uint8_t len = rng() % 33;
+        prefix<uint32_t> p(len ? k & ~uint32_t((uint64_t(1) << (32 - len)) - 1) : 0, len);
+        ASSERT_EQ(bogon_trie.find(p), bt->find(p)) << p.show();
+        ASSERT_EQ(nested_trie.find(p), nt->find(p)) << p.show();
+    }
+}
+
+TEST(StaticTrie, Ipv6) {
+    auto t = runtime_trie(v6);
+    EXPECT_EQ(v6_trie.node_count(), t->node_count());
+    for (const auto& [p, value] : v6) {
+        EXPECT_EQ(v6_trie.find(p), t->find(p));
+        EXPECT_EQ(v6_trie.lookup(p.v), t->lookup(p.v));
+        EXPECT_EQ(v6_trie.lookup(p.v - 1), t->lookup(p.v - 1));
+    }
+}
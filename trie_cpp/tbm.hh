@@ -0,0 +1,378 @@
+#ifndef TBM_HH
+#define TBM_HH
+
+#include "trie.hh"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Multibit tree bitmap (Eatherton et al.), the C++ counterpart of the
+// TbmNode design in tbm/src/tbmlib.c3.
+//
+// Every node covers STRIDE bits of the key. Prefixes that end inside the
+// node (length 0 .. STRIDE-1 relative to the node) are recorded in the
+// internal bitmap, children are recorded in the external bitmap. Both the
+// results and the children are kept in dense arrays indexed by popcount, so a
+// lookup touches one node per STRIDE bits instead of one per bit.
+
+template <unsigned STRIDE>
+struct tbm_bitmap {
+    static_assert(STRIDE >= 3 && STRIDE <= 7, "STRIDE must be in [3, 7]");
+
+    using type = std::conditional_t<STRIDE == 3, uint8_t,
+                 std::conditional_t<STRIDE == 4, uint16_t,
+                 std::conditional_t<STRIDE == 5, uint32_t,
+                 std::conditional_t<STRIDE == 6, uint64_t, unsigned __int128>>>>;
+
+    static constexpr unsigned width = 1u << STRIDE;
+
+    static constexpr type bit(unsigned pos) {
+        return type(1) << pos;
+    }
+
+    static constexpr unsigned popcount(type bm) {
+        if constexpr (sizeof(type) > sizeof(uint64_t)) {
+            return __builtin_popcountll(uint64_t(bm)) + __builtin_popcountll(uint64_t(bm >> 64));
+        } else {
+            return __builtin_popcountll(bm);
+        }
+    }
+
+    // number of bits set below pos.
+    static constexpr unsigned count_bits(type bm, unsigned pos) {
+        return popcount(bm & (bit(pos) - 1));
+    }
+
+    // position of the highest bit set, bm must not be 0.
+    static constexpr unsigned highest(type bm) {
+        if constexpr (sizeof(type) > sizeof(uint64_t)) {
+            uint64_t hi = uint64_t(bm >> 64);
+            return hi ? 127 - __builtin_clzll(hi) : 63 - __builtin_clzll(uint64_t(bm));
+        } else {
+            return 63 - __builtin_clzll(bm);
+        }
+    }
+
+    // position of the lowest bit set, bm must not be 0.
+    static constexpr unsigned lowest(type bm) {
+        if constexpr (sizeof(type) > sizeof(uint64_t)) {
+            uint64_t lo = uint64_t(bm);
+            return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(uint64_t(bm >> 64));
+        } else {
+            return __builtin_ctzll(bm);
+        }
+    }
+
+    // 0/1 -> position 1, 00/2 -> position 3, 111/3 -> position 14 (STRIDE == 4).
+    static constexpr unsigned inl_bitpos(unsigned bits, unsigned len) {
+        return ((1u << len) - 1) + bits;
+    }
+
+    // For every (STRIDE - 1)-bit value, the internal positions of all the
+    // prefixes covering it, so the longest internal match is the highest bit of
+    // check_map[bits] & internal.
+    static constexpr std::array<type, (1u << (STRIDE - 1))> gen_check_map() {
+        std::array<type, (1u << (STRIDE - 1))> map{};
+        for (unsigned prefix = 0; prefix < map.size(); prefix++) {
+            type check = 0;
+            unsigned p = prefix;
+            for (int len = STRIDE - 1; len >= 0; len--) {
+                check |= bit(inl_bitpos(p, len));
+                p >>= 1;
+            }
+            map[prefix] = check;
+        }
+        return map;
+    }
+
+    static constexpr std::array<type, (1u << (STRIDE - 1))> check_map = gen_check_map();
+};
+
+template <typename T, unsigned STRIDE>
+struct tbm_node {
+    using bitmap = tbm_bitmap<STRIDE>;
+    using bitmap_type = typename bitmap::type;
+
+    bitmap_type external = 0;
+    bitmap_type internal = 0;
+    std::unique_ptr<tbm_node[]> next;
+    std::unique_ptr<T[]> values;
+
+    unsigned count_exl_nodes() const {
+        return bitmap::popcount(external);
+    }
+
+    unsigned count_inl_values() const {
+        return bitmap::popcount(internal);
+    }
+
+    bool empty_node() const {
+        return internal == 0 && external == 0;
+    }
+
+    const tbm_node* next_exl(unsigned stride) const {
+        if (!(external & bitmap::bit(stride))) {
+            return nullptr;
+        }
+        return &next[bitmap::count_bits(external, stride)];
+    }
+
+    tbm_node* next_exl(unsigned stride) {
+        return const_cast<tbm_node*>(std::as_const(*this).next_exl(stride));
+    }
+
+    const T* get_value(unsigned pos) const {
+        if (!(internal & bitmap::bit(pos))) {
+            return nullptr;
+        }
+        return &values[bitmap::count_bits(internal, pos)];
+    }
+
+    tbm_node* insert_exl_node(unsigned stride) {
+        unsigned tot = count_exl_nodes();
+        unsigned before = bitmap::count_bits(external, stride);
+
+        auto new_next = std::make_unique<tbm_node[]>(tot + 1);
+        for (unsigned i = 0; i < before; i++) {
+            new_next[i] = std::move(next[i]);
+        }
+        for (unsigned i = before; i < tot; i++) {
+            new_next[i + 1] = std::move(next[i]);
+        }
+        next = std::move(new_next);
+        external |= bitmap::bit(stride);
+        return &next[before];
+    }
+
+    void insert_value(unsigned pos, T v) {
+        if (internal & bitmap::bit(pos)) {
+            values[bitmap::count_bits(internal, pos)] = v;
+            return;
+        }
+
+        unsigned tot = count_inl_values();
+        unsigned before = bitmap::count_bits(internal, pos);
+
+        auto new_values = std::make_unique<T[]>(tot + 1);
+        for (unsigned i = 0; i < before; i++) {
+            new_values[i] = std::move(values[i]);
+        }
+        new_values[before] = v;
+        for (unsigned i = before; i < tot; i++) {
+            new_values[i + 1] = std::move(values[i]);
+        }
+        values = std::move(new_values);
+        internal |= bitmap::bit(pos);
+    }
+
+    size_t max_depth() const {
+        size_t depth = 0;
+        for (unsigned i = 0; i < count_exl_nodes(); i++) {
+            depth = std::max(depth, 1 + next[i].max_depth());
+        }
+        return depth;
+    }
+
+    // bytes of the child and value arrays below this node.
+    size_t memory_usage() const {
+        size_t bytes = count_exl_nodes() * sizeof(tbm_node) + count_inl_values() * sizeof(T);
+        for (unsigned i = 0; i < count_exl_nodes(); i++) {
+            bytes += next[i].memory_usage();
+        }
+        return bytes;
+    }
+};
+
+template <typename T, unsigned STRIDE = 4>
+class tree_bitmap {
+public:
+    using node = tbm_node<T, STRIDE>;
+    using bitmap = tbm_bitmap<STRIDE>;
+
+    node root;
+    tree_bitmap() = default;
+
+    template<typename P>
+    void insert(prefix<P> p, T value) {
+        node* currNode = &root;
+        while (p.len >= STRIDE) {
+            unsigned stride = take_stride(p.v, STRIDE);
+            node* next = currNode->next_exl(stride);
+            currNode = next ? next : currNode->insert_exl_node(stride);
+            p.len -= STRIDE;
+        }
+        currNode->insert_value(bitmap::inl_bitpos(take_stride(p.v, p.len), p.len), value);
+    }
+
+    // exact match of p, a prefix that was never inserted gives std::nullopt.
+    template<typename P>
+    std::optional<T> find(prefix<P> p) const {
+        const node* currNode = &root;
+        while (p.len >= STRIDE) {
+            currNode = currNode->next_exl(take_stride(p.v, STRIDE));
+            if (!currNode) {
+                return std::nullopt;
+            }
+            p.len -= STRIDE;
+        }
+
+        const T* v = currNode->get_value(bitmap::inl_bitpos(take_stride(p.v, p.len), p.len));
+        if (!v) {
+            return std::nullopt;
+        }
+        return *v;
+    }
+
+    // longest prefix match of the key.
+    template<typename P>
+    std::optional<T> lookup(P key) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+        const node* currNode = &root;
+        const T* best = nullptr;
+        unsigned bits_left = sizeof(P) * 8;
+
+        while (bits_left >= STRIDE) {
+            unsigned stride = take_stride(key, STRIDE);
+            bits_left -= STRIDE;
+
+            auto check = bitmap::check_map[stride >> 1] & currNode->internal;
+            if (check) {
+                best = currNode->get_value(bitmap::highest(check));
+            }
+
+            currNode = currNode->next_exl(stride);
+            if (!currNode) {
+                return best ? std::optional<T>(*best) : std::nullopt;
+            }
+        }
+
+        // the key width is not a multiple of STRIDE, only the internal
+        // prefixes no longer than the remaining bits can match.
+        unsigned stride = take_stride(key, bits_left) << (STRIDE - 1 - bits_left);
+        auto limit = bitmap::bit(bitmap::inl_bitpos(0, bits_left + 1)) - 1;
+        auto check = bitmap::check_map[stride] & currNode->internal & limit;
+        if (check) {
+            best = currNode->get_value(bitmap::highest(check));
+        }
+        return best ? std::optional<T>(*best) : std::nullopt;
+    }
+
+    // lookup() for a burst of keys. The walks advance one node at a time in
+    // lockstep and prefetch the next node of every in-flight walk.
+    template<typename P>
+    void lookup_batch(std::span<const P> keys, std::span<std::optional<T>> values) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+        if (values.size() < keys.size()) {
+            throw std::invalid_argument(fmt::format("batch output too small {} < {}", values.size(), keys.size()));
+        }
+
+        for (size_t base = 0; base < keys.size(); base += batch_group) {
+            size_t n = std::min(batch_group, keys.size() - base);
+            const node* nodes[batch_group];
+            const T* best[batch_group];
+            P ks[batch_group];
+            uint8_t lanes[batch_group];
+            size_t active = n;
+
+            for (size_t i = 0; i < n; i++) {
+                nodes[i] = &root;
+                best[i] = nullptr;
+                ks[i] = keys[base + i];
+                lanes[i] = i;
+            }
+
+            for (unsigned bits_left = sizeof(P) * 8; active && bits_left >= STRIDE; bits_left -= STRIDE) {
+                size_t still = 0;
+                for (size_t l = 0; l < active; l++) {
+                    uint8_t i = lanes[l];
+                    unsigned stride = take_stride(ks[i], STRIDE);
+                    auto check = bitmap::check_map[stride >> 1] & nodes[i]->internal;
+                    if (check) {
+                        best[i] = nodes[i]->get_value(bitmap::highest(check));
+                    }
+                    const node* next = nodes[i]->next_exl(stride);
+                    if (!next) {
+                        continue;
+                    }
+                    __builtin_prefetch(next);
+                    nodes[i] = next;
+                    lanes[still++] = i;
+                }
+                active = still;
+            }
+
+            // the lanes still active consumed all the full strides.
+            constexpr unsigned rest = sizeof(P) * 8 % STRIDE;
+            for (size_t l = 0; l < active; l++) {
+                uint8_t i = lanes[l];
+                unsigned stride = take_stride(ks[i], rest) << (STRIDE - 1 - rest);
+                auto limit = bitmap::bit(bitmap::inl_bitpos(0, rest + 1)) - 1;
+                auto check = bitmap::check_map[stride] & nodes[i]->internal & limit;
+                if (check) {
+                    best[i] = nodes[i]->get_value(bitmap::highest(check));
+                }
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                values[base + i] = best[i] ? std::optional<T>(*best[i]) : std::nullopt;
+            }
+        }
+    }
+
+    template<typename P>
+    void dump(const node* n, P v, unsigned depth, std::vector<prefix<P>>& prefixes) const {
+        auto internal = n->internal;
+        while (internal) {
+            unsigned pos = bitmap::lowest(internal);
+            internal &= internal - 1;
+
+            // pos = ((1 << len) - 1) + bits
+            unsigned len = 31 - __builtin_clz(pos + 1);
+            P bits = P(pos + 1 - (1u << len));
+            P pv = len ? P(v | P(bits << (sizeof(P) * 8 - depth - len))) : v;
+            prefixes.push_back(prefix<P>(pv, depth + len));
+        }
+
+        for (unsigned stride = 0; stride < bitmap::width; stride++) {
+            if (const node* child = n->next_exl(stride)) {
+                P cv = P(v | P(P(stride) << (sizeof(P) * 8 - depth - STRIDE)));
+                dump(child, cv, depth + STRIDE, prefixes);
+            }
+        }
+    }
+
+    template<typename P>
+    void dump(std::vector<prefix<P>>& prefixes) const {
+        dump(&root, P(0), 0, prefixes);
+    }
+
+    size_t max_depth() const {
+        return root.max_depth();
+    }
+
+    size_t memory_usage() const {
+        return sizeof(root) + root.memory_usage();
+    }
+
+private:
+    // number of walks kept in flight by lookup_batch().
+    static constexpr size_t batch_group = 16;
+
+    // take the highest n bits of v and shift them out.
+    template<typename P>
+    static unsigned take_stride(P& v, unsigned n) {
+        if (n == 0) {
+            return 0;
+        }
+        unsigned stride = unsigned(v >> (sizeof(P) * 8 - n));
+        v = n < sizeof(P) * 8 ? P(v << n) : P(0);
+        return stride;
+    }
+};
+
+#endif
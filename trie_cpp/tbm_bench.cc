@@ -0,0 +1,24 @@
+#include "bench_util.hh"
+#include "tbm.hh"
+#include <benchmark/benchmark.h>
+
+namespace {
+
+template <typename Table>
+void BM_lookup(benchmark::State& state) {
+    const Table& table = build_table<Table>();
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["max_depth"] = table.max_depth();
+}
+
+}
+
+BENCHMARK_TEMPLATE(BM_lookup, trie<uint32_t>);
+BENCHMARK_TEMPLATE(BM_lookup, tree_bitmap<uint32_t, 4>);
+BENCHMARK_TEMPLATE(BM_lookup, tree_bitmap<uint32_t, 5>);
+BENCHMARK_TEMPLATE(BM_lookup, tree_bitmap<uint32_t, 6>);
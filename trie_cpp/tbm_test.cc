@@ -0,0 +1,129 @@
+#include "tbm.hh"
+#include <cstdint>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+TEST(TbmBitmap, CheckMap) {
+    // 0b11 -> 0b11/2, 0b1/1, 0/0 -> positions 6, 2, 0.
+    EXPECT_EQ(tbm_bitmap<3>::check_map[0b11], 0b01000101);
+    EXPECT_EQ(tbm_bitmap<3>::check_map[0b10], 0b00100101);
+    EXPECT_EQ(tbm_bitmap<4>::inl_bitpos(0b111, 3), 14);
+}
+
+TEST(Tbm, Test1) {
+    tree_bitmap<uint32_t, 4> tbm;
+    tbm.insert<uint16_t>({0x1234, 16}, 1);
+    EXPECT_EQ(tbm.max_depth(), 4);
+    EXPECT_EQ(tbm.root.external, 1 << 0x1);
+}
+
+TEST(Tbm, Test2) {
+    tree_bitmap<uint32_t, 4> tbm;
+    tbm.insert<uint16_t>({0x1234, 16}, 1);
+    tbm.insert<uint16_t>({0x4, 16}, 2);
+
+    auto value = tbm.find<uint16_t>({0x1234, 16});
+    EXPECT_EQ((bool)value, true);
+    EXPECT_EQ(*value, 1);
+
+    value = tbm.find<uint16_t>({0x4, 16});
+    EXPECT_EQ((bool)value, true);
+    EXPECT_EQ(*value, 2);
+
+    EXPECT_EQ((bool)tbm.find<uint16_t>({0x1200, 8}), false);
+}
+
+TEST(Tbm, Dump) {
+    tree_bitmap<uint32_t, 5> tbm;
+    tbm.insert<uint16_t>({0x1234, 16}, 1);
+    tbm.insert<uint16_t>({0x4, 16}, 2);
+    tbm.insert<uint16_t>({0x8000, 1}, 3);
+    tbm.insert<uint16_t>({0x0, 0}, 4);
+    std::vector<prefix<uint16_t>> prefixes;
+    tbm.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::UnorderedElementsAre(
+        prefix<uint16_t>{0x1234, 16},
+        prefix<uint16_t>{0x4, 16},
+        prefix<uint16_t>{0x8000, 1},
+        prefix<uint16_t>{0x0, 0}
+    ));
+}
+
+TEST(Tbm, Lookup) {
+    tree_bitmap<uint32_t, 4> tbm;
+    tbm.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    tbm.insert(ipv4_prefix("10.1.0.0/16"), 2);
+    tbm.insert(ipv4_prefix("10.1.2.0/23"), 3);
+    tbm.insert(ipv4_prefix("10.1.2.3/32"), 4);
+
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0a010203), 4);
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0a010303), 3);
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0a010403), 2);
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0a020000), 1);
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0b000000), std::nullopt);
+
+    tbm.insert(ipv4_prefix("0.0.0.0/0"), 5);
+    EXPECT_EQ(tbm.lookup<uint32_t>(0x0b000000), 5);
+}
+
+template <typename S>
+class TbmStride : public testing::Test {};
+
+using Strides = testing::Types<std::integral_constant<unsigned, 3>,
+                               std::integral_constant<unsigned, 4>,
+                               std::integral_constant<unsigned, 5>,
+                               std::integral_constant<unsigned, 6>,
+                               std::integral_constant<unsigned, 7>>;
+TYPED_TEST_SUITE(TbmStride, Strides);
+
+TYPED_TEST(TbmStride, SameAsTrie) {
+    std::mt19937 rng(TypeParam::value);
+    trie<uint32_t> bt;
+    tree_bitmap<uint32_t, TypeParam::value> tbm;
+    std::vector<prefix<uint32_t>> inserted;
+
+    for (uint32_t i = 1; i <= 2000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        prefix<uint32_t> p(v, len);
+        bt.insert(p, i);
+        tbm.insert(p, i);
+        inserted.push_back(p);
+    }
+
+    for (const auto& p : inserted) {
+        EXPECT_EQ(tbm.find(p), bt.find(p)) << p.show();
+    }
+
+    for (int i = 0; i < 20000; i++) {
+        uint32_t key = rng();
+        EXPECT_EQ(tbm.lookup(key), bt.lookup(key)) << key;
+    }
+
+    std::vector<prefix<uint32_t>> expected, dumped;
+    bt.dump(expected);
+    tbm.dump(dumped);
+    EXPECT_THAT(dumped, testing::UnorderedElementsAreArray(expected));
+}
+
+TYPED_TEST(TbmStride, LookupBatch) {
+    std::mt19937 rng(TypeParam::value);
+    tree_bitmap<uint32_t, TypeParam::value> tbm;
+    for (uint32_t i = 1; i <= 2000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        tbm.insert(prefix<uint32_t>(v, len), i);
+    }
+
+    std::vector<uint32_t> keys(1001);
+    for (auto& k : keys) {
+        k = rng();
+    }
+    std::vector<std::optional<uint32_t>> values(keys.size());
+    tbm.template lookup_batch<uint32_t>(keys, values);
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(values[i], tbm.lookup(keys[i])) << keys[i];
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef TEST_UTIL_HH
+#define TEST_UTIL_HH
+
+#include "lc_trie.hh"
+#include "trie.hh"
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+// Rules shared by the classifier and analyzer tests. Few distinct prefixes
+// and ranges, so that rules nest and overlap often: addresses of length 0, 8,
+// 16, 24 or 32 with only the bits of addr_mask set, ports starting at one of
+// port_count multiples of port_step and up to 200 wide, a third of them
+// wildcards, and tcp or udp but a quarter of any protocol.
+inline std::vector<acl_rule> nested_rules(size_t n, uint32_t seed, uint32_t addr_mask, uint32_t port_count,
+                                          uint16_t port_step = 1) {
+    std::mt19937 rng(seed);
+    std::vector<acl_rule> rules;
+    for (size_t i = 0; i < n; i++) {
+        auto addr = [&] {
+            uint8_t len = (rng() % 5) * 8;
+            uint32_t v = len ? (rng() & addr_mask) & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+            return ipv4_prefix(v, len);
+        };
+        auto port = [&] {
+            uint16_t lo = rng() % port_count * port_step, hi = lo + rng() % 3 * 100;
+            return rng() % 3 ? acl_rule::port_range(lo, hi) : acl_rule::port_range(0, 65535);
+        };
+        auto src = addr();
+        auto dst = addr();
+        auto sp = port();
+        auto dp = port();
+        uint8_t proto = rng() % 2 ? 6 : 17;
+        rules.emplace_back(src, dst, sp, dp, rng() % 4 ? acl_rule::proto_range(proto, proto) : acl_rule::proto_range(0, 255));
+    }
+    return rules;
+}
+
+// Differential test driver for longest prefix match engines over keys K:
+// every prefix set in an engine is set in a trie<uint32_t> too, and check()
+// compares the two. A prefix with value 0 is one the engine has removed.
+template <typename K>
+class lpm_differential {
+public:
+    static_assert(std::is_unsigned_v<K>, "K must be unsigned");
+    static constexpr unsigned width = sizeof(K) * 8;
+
+    explicit lpm_differential(unsigned seed) : rng{seed} {}
+
+    K random_key() {
+        return K(uint128_t(rng()) << 64 | rng());
+    }
+
+    // a random prefix of len bits; clustered ones all start with 0xab, so
+    // that they nest and make dense regions.
+    prefix<K> random_prefix(uint8_t len, bool clustered) {
+        K v = random_key();
+        if (clustered) {
+            v = (v >> 8) | (K(0xab) << (width - 8));
+        }
+        return prefix<K>(v & lc_key<K>::mask(len), len);
+    }
+
+    // sets a new prefix in e and the reference.
+    template <typename Engine>
+    void insert(Engine& e, prefix<K> p, uint32_t value) {
+        update(e, p, value);
+        inserted.push_back(p);
+    }
+
+    // sets a prefix already inserted, 0 removing it.
+    template <typename Engine>
+    void update(Engine& e, prefix<K> p, uint32_t value) {
+        reference.insert(p, value);
+        e.insert(p, value);
+    }
+
+    // find() of every prefix inserted, lookup() of an address inside each
+    // and of random_keys random ones.
+    template <typename Engine>
+    void check(const Engine& e, int random_keys) {
+        for (const auto& p : inserted) {
+            ASSERT_EQ(e.find(p).value_or(0), reference.find(p).value_or(0)) << p.show();
+            K k = p.v | (random_key() & ~lc_key<K>::mask(p.len));
+            ASSERT_EQ(e.lookup(k), reference.lookup(k)) << p.show();
+        }
+        for (int i = 0; i < random_keys; i++) {
+            K k = random_key();
+            ASSERT_EQ(e.lookup(k), reference.lookup(k));
+        }
+    }
+
+    // dump() lists the prefixes with a value, as the reference does.
+    template <typename Engine>
+    void check_dump(const Engine& e) const {
+        std::vector<prefix<K>> expected, dumped;
+        reference.dump(expected);
+        e.dump(dumped);
+        EXPECT_THAT(dumped, testing::UnorderedElementsAreArray(expected));
+    }
+
+    std::mt19937_64 rng;
+    trie<uint32_t> reference;
+    std::vector<prefix<K>> inserted;
+};
+
+#endif
@@ -5,9 +5,16 @@
 #include <fmt/format.h>
 #include <concepts>
 #include <vector>
+#include <optional>
+#include <span>
+#include <algorithm>
+#include <utility>
 #include <absl/strings/str_split.h>
 #include <limits>
 #include <string_view>
+#include <iterator>
+#include <atomic>
+#include <thread>
 
 
 struct trie_node_base {
@@ -26,6 +33,10 @@ struct trie_node_base {
         }
     }
 
+    size_t node_count() const {
+        return 1 + (left ? left->node_count() : 0) + (right ? right->node_count() : 0);
+    }
+
     virtual ~trie_node_base() = default;
 };
 
@@ -33,7 +44,7 @@ template <typename T>
 constexpr auto init_value() {
     if constexpr (std::is_unsigned_v<T> || std::is_signed_v<T>) {
         return 0;
-    } else if (std::is_pointer_v<T>) {
+    } else if constexpr (std::is_pointer_v<T>) {
         return nullptr;
     } else {
         return T{};
@@ -110,7 +121,7 @@ struct prefix {
     static_assert(std::is_unsigned_v<T>, "T must be unsigned");
     prefix() = default;
 
-    prefix(T v, uint8_t len) : v{v}, len{len} {
+    constexpr prefix(T v, uint8_t len) : v{v}, len{len} {
         if (len == 0) {
             if (v != 0) {
                 throw std::invalid_argument(fmt::format("prefix does not match the length {:x}/{}", v, len));
@@ -129,7 +140,7 @@ struct prefix {
         }
     }
 
-    bool operator==(const prefix<T>& other) const {
+    constexpr bool operator==(const prefix<T>& other) const {
         return v == other.v && len == other.len;
     }
 
@@ -169,7 +180,7 @@ struct prefix {
 struct ipv4_prefix : public prefix<uint32_t> {
 
     ipv4_prefix() = default;
-    ipv4_prefix(uint32_t v, uint8_t len) : prefix<uint32_t>(v, len) {}
+    constexpr ipv4_prefix(uint32_t v, uint8_t len) : prefix<uint32_t>(v, len) {}
 
     std::string show() const {
         return fmt::format("{}.{}.{}.{}/{}", (v >> 24) & 0xff, (v >> 16) & 0xff, (v >> 8) & 0xff, v & 0xff, len);
@@ -208,6 +219,135 @@ struct ipv4_prefix : public prefix<uint32_t> {
 };
 
 
+using uint128_t = unsigned __int128;
+
+struct ipv6_prefix : public prefix<uint128_t> {
+
+    ipv6_prefix() = default;
+    constexpr ipv6_prefix(uint128_t v, uint8_t len) : prefix<uint128_t>(v, len) {}
+
+    // RFC 5952 text form: lowercase, no leading zeros, the longest run of two
+    // or more zero groups collapsed to "::".
+    std::string show() const {
+        uint16_t groups[8];
+        for (int i = 0; i < 8; i++) {
+            groups[i] = uint16_t(v >> (112 - 16 * i));
+        }
+
+        int best = -1, best_len = 1;
+        for (int i = 0; i < 8;) {
+            int j = i;
+            while (j < 8 && groups[j] == 0) {
+                j++;
+            }
+            if (j - i > best_len) {
+                best = i;
+                best_len = j - i;
+            }
+            i = j == i ? i + 1 : j;
+        }
+
+        std::string s;
+        for (int i = 0; i < 8; i++) {
+            if (i == best) {
+                s += "::";
+                i += best_len - 1;
+                continue;
+            }
+            if (!s.empty() && s.back() != ':') {
+                s += ':';
+            }
+            s += fmt::format("{:x}", groups[i]);
+        }
+        return fmt::format("{}/{}", s, len);
+    }
+
+    ipv6_prefix(const char *s) : ipv6_prefix(std::string_view(s)) {}
+
+    ipv6_prefix(std::string_view s) {
+        std::vector<std::string_view> parts = absl::StrSplit(s, '/');
+        if (parts.size() != 2) {
+            throw std::invalid_argument(fmt::format("invalid ipv6 prefix {}", s));
+        }
+
+        std::string_view ip = parts[0];
+        std::vector<uint16_t> head, tail;
+        auto gap = ip.find("::");
+        if (gap == std::string_view::npos) {
+            head = parse_groups(ip, s);
+            if (head.size() != 8) {
+                throw std::invalid_argument(fmt::format("invalid ipv6 prefix {}", s));
+            }
+        } else {
+            head = parse_groups(ip.substr(0, gap), s);
+            tail = parse_groups(ip.substr(gap + 2), s);
+            if (head.size() + tail.size() > 7) {
+                throw std::invalid_argument(fmt::format("invalid ipv6 prefix {}", s));
+            }
+        }
+
+        // "::" stands for the zero groups between head and tail.
+        head.resize(8 - tail.size(), 0);
+        head.insert(head.end(), tail.begin(), tail.end());
+        uint128_t v = 0;
+        for (auto g : head) {
+            v = (v << 16) | g;
+        }
+
+        if (parts[1].empty() || parts[1].size() > 3 || parts[1].find_first_not_of("0123456789") != std::string_view::npos) {
+            throw std::invalid_argument(fmt::format("invalid ipv6 prefix {}", s));
+        }
+        auto _len = std::stoul(std::string(parts[1]));
+        if (_len > 128) {
+            throw std::invalid_argument(fmt::format("invalid ipv6 prefix length {}", _len));
+        }
+        uint8_t len = _len;
+        *this = ipv6_prefix(v, len);
+    }
+
+private:
+    // colon separated hex groups, the last one may be a dotted ipv4 address.
+    static std::vector<uint16_t> parse_groups(std::string_view ip, std::string_view s) {
+        std::vector<uint16_t> groups;
+        if (ip.empty()) {
+            return groups;
+        }
+
+        std::vector<std::string_view> ip_parts = absl::StrSplit(ip, ':');
+        for (size_t i = 0; i < ip_parts.size(); i++) {
+            const auto& part = ip_parts[i];
+            if (i + 1 == ip_parts.size() && part.find('.') != std::string_view::npos) {
+                uint32_t v4 = ipv4_prefix(std::string(part) + "/32").v;
+                groups.push_back(v4 >> 16);
+                groups.push_back(v4 & 0xffff);
+                continue;
+            }
+            if (part.empty() || part.size() > 4 || part.find_first_not_of("0123456789abcdefABCDEF") != std::string_view::npos) {
+                throw std::invalid_argument(fmt::format("invalid ipv6 prefix {}", s));
+            }
+            groups.push_back(std::stoul(std::string(part), nullptr, 16));
+        }
+        return groups;
+    }
+};
+
+
+// header fields of an IPv4 packet an acl_rule is matched against.
+struct five_tuple {
+    uint32_t src;
+    uint32_t dst;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t proto;
+
+    std::string show() const {
+        auto ip = [](uint32_t a) {
+            return fmt::format("{}.{}.{}.{}", (a >> 24) & 0xff, (a >> 16) & 0xff, (a >> 8) & 0xff, a & 0xff);
+        };
+        return fmt::format("{} {} {} {} {}", ip(src), ip(dst), src_port, dst_port, proto);
+    }
+};
+
 struct acl_rule {
     using port_range = range<uint16_t>;
     using proto_range = range<uint8_t>;
@@ -227,10 +367,205 @@ struct acl_rule {
     std::string show() const {
         return fmt::format("{} {} {} {} {}", src.show(), dst.show(), src_port.show(), dst_port.show(), proto.show());
     }
+
+    bool match(const five_tuple& t) const {
+        return prefix_match(src, t.src) && prefix_match(dst, t.dst) &&
+               src_port.contains(t.src_port) && dst_port.contains(t.dst_port) && proto.contains(t.proto);
+    }
+
+private:
+    static bool prefix_match(const ipv4_prefix& p, uint32_t v) {
+        return p.len == 0 || ((v ^ p.v) >> (32 - p.len)) == 0;
+    }
 };
 
 
 
+template <typename T>
+class trie_view;
+
+template <typename T, typename P>
+class trie_aggregator;
+
+// Pre-order walk over the prefixes with info of a subtree of a trie<T>, in
+// the order dump() lists them, as (prefix, value) pairs. The path from the
+// subtree root to the current node lives in a fixed array inside the
+// iterator: no recursion and no allocation.
+template <typename T, typename P>
+class trie_iterator {
+public:
+    static constexpr unsigned width = sizeof(P) * 8;
+
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<prefix<P>, T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+
+    // the end iterator.
+    trie_iterator() = default;
+
+    // walks the subtree of node, the node of top.
+    trie_iterator(const trie_node_base* node, prefix<P> top) : v{top.v}, depth{top.len}, top{top.len} {
+        path[depth] = node;
+        if (!node || !info()) {
+            next();
+        }
+    }
+
+    value_type operator*() const {
+        return {prefix<P>(v, depth), static_cast<const trie_node<T>*>(path[depth])->value};
+    }
+
+    trie_iterator& operator++() {
+        next();
+        return *this;
+    }
+
+    trie_iterator operator++(int) {
+        auto old = *this;
+        next();
+        return old;
+    }
+
+    bool operator==(const trie_iterator& other) const {
+        return path[depth] == other.path[other.depth];
+    }
+
+private:
+    bool info() const {
+        return static_cast<const trie_node<T>*>(path[depth])->has_info();
+    }
+
+    P bit(unsigned d) const {
+        return P(1) << (width - 1 - d);
+    }
+
+    // to the next node with info in pre-order, or to the end.
+    void next() {
+        while (path[depth] && step()) {
+            if (info()) {
+                return;
+            }
+        }
+        path[depth] = nullptr;
+    }
+
+    // to the next node in pre-order, false past the last one.
+    bool step() {
+        const trie_node_base* n = path[depth];
+        if (n->left) {
+            path[++depth] = n->left.get();
+            return true;
+        }
+        if (n->right) {
+            v |= bit(depth);
+            path[++depth] = n->right.get();
+            return true;
+        }
+        // up to the deepest ancestor left through its left child that has a
+        // right child.
+        while (depth > top) {
+            bool from_left = !(v & bit(depth - 1));
+            v &= ~bit(depth - 1);
+            depth--;
+            if (from_left && path[depth]->right) {
+                v |= bit(depth);
+                path[depth + 1] = path[depth]->right.get();
+                depth++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const trie_node_base* path[width + 1] = {};
+    P v = 0;
+    unsigned depth = 0;
+    unsigned top = 0;
+};
+
+// The prefixes with info on the path from the root down to a prefix p,
+// shortest first: the less specifics of p, and p itself if it has info.
+template <typename T, typename P>
+class trie_covering_iterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<prefix<P>, T>;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type;
+
+    trie_covering_iterator() = default;
+
+    trie_covering_iterator(const trie_node_base* root, prefix<P> p) : node{root}, target{p} {
+        if (!info()) {
+            next();
+        }
+    }
+
+    value_type operator*() const {
+        P v = depth ? P(target.v & ~((P(1) << (sizeof(P) * 8 - depth)) - 1)) : P(0);
+        return {prefix<P>(v, depth), static_cast<const trie_node<T>*>(node)->value};
+    }
+
+    trie_covering_iterator& operator++() {
+        next();
+        return *this;
+    }
+
+    trie_covering_iterator operator++(int) {
+        auto old = *this;
+        next();
+        return old;
+    }
+
+    bool operator==(const trie_covering_iterator& other) const {
+        return node == other.node;
+    }
+
+private:
+    bool info() const {
+        return node && static_cast<const trie_node<T>*>(node)->has_info();
+    }
+
+    void next() {
+        do {
+            if (depth == target.len) {
+                node = nullptr;
+                return;
+            }
+            bool right = target.v & (P(1) << (sizeof(P) * 8 - 1 - depth));
+            node = right ? node->right.get() : node->left.get();
+            depth++;
+        } while (node && !info());
+    }
+
+    const trie_node_base* node = nullptr;
+    prefix<P> target{0, 0};
+    unsigned depth = 0;
+};
+
+// begin() and end() of a trie walk, for range-for.
+template <typename It>
+class trie_range {
+public:
+    explicit trie_range(It first) : first{first} {}
+
+    It begin() const {
+        return first;
+    }
+
+    It end() const {
+        return It();
+    }
+
+    bool empty() const {
+        return first == It();
+    }
+
+private:
+    It first;
+};
+
 template <typename T>
 class trie {
 public:
@@ -261,6 +596,164 @@ public:
         tn->set(value);
     }
 
+    // removes p, and the nodes on its path it leaves with neither info nor
+    // children, where insert(p, init_value<T>()) keeps them. False if p had
+    // no info.
+    template<typename P>
+    bool erase(prefix<P> p) {
+        // path[d] is the node at depth d on the way to p.
+        trie_node_base* path[sizeof(P) * 8 + 1];
+        path[0] = &root;
+        unsigned depth = 0;
+        for (; p.len; p.v <<= 1, p.len--) {
+            trie_node_base* next = p.highest_bit_is_set() ? path[depth]->right.get() : path[depth]->left.get();
+            if (!next) {
+                return false;
+            }
+            path[++depth] = next;
+        }
+        auto* tn = static_cast<trie_node<T>*>(path[depth]);
+        if (!tn->has_info()) {
+            return false;
+        }
+        tn->set(init_value<T>());
+        for (; depth > 0; depth--) {
+            trie_node_base* n = path[depth];
+            if (static_cast<trie_node<T>*>(n)->has_info() || n->left || n->right) {
+                break;
+            }
+            trie_node_base* parent = path[depth - 1];
+            (parent->left.get() == n ? parent->left : parent->right).reset();
+        }
+        return true;
+    }
+
+    // Builds the trie from scratch out of a whole table. Sorted input is laid
+    // down in one depth first pass: each prefix only walks from where its path
+    // leaves the path of the previous one, so every node is visited once.
+    // Input that is not sorted still gives the right trie, only slower; pass
+    // sorted = false to have it sorted first. Later duplicates win, as with
+    // repeated insert().
+    template<typename P>
+    void build(std::span<const std::pair<prefix<P>, T>> table, bool sorted = false) {
+        std::vector<std::pair<prefix<P>, T>> copy;
+        if (!sorted) {
+            copy.assign(table.begin(), table.end());
+            std::stable_sort(copy.begin(), copy.end(), [](const auto& a, const auto& b) {
+                return a.first.v != b.first.v ? a.first.v < b.first.v : a.first.len < b.first.len;
+            });
+            table = copy;
+        }
+
+        root.left.reset();
+        root.right.reset();
+        root.set(init_value<T>());
+        lay_down(&root, prefix<P>(0, 0), table);
+    }
+
+    // build() spread over threads: the prefixes are partitioned by their top
+    // bits, the subtries under the 2^bits nodes at that depth are built each
+    // on its own, and hung under the nodes the prefixes shorter than bits
+    // leave on top. Partitions are handed out one at a time, so a few heavy
+    // ones only keep their thread busy. The trie is the same as build() and
+    // insert() give, later duplicates winning.
+    template<typename P>
+    void build_parallel(std::span<const std::pair<prefix<P>, T>> table,
+                        size_t threads = std::max(1u, std::thread::hardware_concurrency()),
+                        bool sorted = false, unsigned bits = 8) {
+        constexpr unsigned width = sizeof(P) * 8;
+        if (threads == 0) {
+            throw std::invalid_argument("build needs at least one thread");
+        }
+        if (bits > width || bits > max_partition_bits) {
+            throw std::invalid_argument(fmt::format("invalid partition bits {}", bits));
+        }
+        if (bits == 0) {
+            build(table, sorted);
+            return;
+        }
+
+        // stable counting sort by partition, the prefixes shorter than bits
+        // first. Each partition keeps the input order.
+        size_t parts = size_t(1) << bits;
+        auto part_of = [&](const prefix<P>& p) {
+            return p.len < bits ? 0 : 1 + size_t(p.v >> (width - bits));
+        };
+        std::vector<size_t> start(parts + 2, 0);
+        for (const auto& e : table) {
+            start[part_of(e.first) + 1]++;
+        }
+        for (size_t i = 1; i < start.size(); i++) {
+            start[i] += start[i - 1];
+        }
+        std::vector<std::pair<prefix<P>, T>> split(table.size());
+        {
+            auto next = start;
+            for (const auto& e : table) {
+                split[next[part_of(e.first)]++] = e;
+            }
+        }
+        auto part = [&](size_t i) {
+            return std::span(split.data() + start[i], start[i + 1] - start[i]);
+        };
+        auto sort_part = [&](std::span<std::pair<prefix<P>, T>> s) {
+            if (!sorted) {
+                std::stable_sort(s.begin(), s.end(), [](const auto& a, const auto& b) {
+                    return a.first.v != b.first.v ? a.first.v < b.first.v : a.first.len < b.first.len;
+                });
+            }
+        };
+
+        root.left.reset();
+        root.right.reset();
+        root.set(init_value<T>());
+
+        std::vector<std::unique_ptr<trie_node<T>>> sub(parts);
+        std::atomic<size_t> next{0};
+        auto work = [&] {
+            for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < parts;) {
+                auto s = part(i + 1);
+                if (s.empty()) {
+                    continue;
+                }
+                sort_part(s);
+                sub[i] = std::make_unique<trie_node<T>>();
+                lay_down<P>(sub[i].get(), prefix<P>(P(P(i) << (width - bits)), bits), s);
+            }
+        };
+        threads = std::min(threads, parts);
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++) {
+            pool.emplace_back(work);
+        }
+        work();
+        for (auto& t : pool) {
+            t.join();
+        }
+
+        auto top = part(0);
+        sort_part(top);
+        lay_down<P>(&root, prefix<P>(0, 0), top);
+
+        // the short prefixes end above depth bits, every subtrie gets a path
+        // of fresh or existing nodes down to its parent.
+        for (size_t i = 0; i < parts; i++) {
+            if (!sub[i]) {
+                continue;
+            }
+            trie_node_base* n = &root;
+            for (unsigned d = 0; d < bits; d++) {
+                auto& child = (i >> (bits - 1 - d)) & 1 ? n->right : n->left;
+                if (d + 1 == bits) {
+                    child = std::move(sub[i]);
+                } else if (!child) {
+                    child = std::make_unique<trie_node<T>>();
+                }
+                n = child.get();
+            }
+        }
+    }
+
     template<typename P>
     std::optional<T> find(prefix<P> p) const {
 
@@ -286,31 +779,222 @@ public:
         return tn->value;
     }
 
+    // longest prefix match of the key, only nodes with info are candidates.
     template<typename P>
-    void dump(const trie_node_base* node, prefix<P> p, std::vector<prefix<P>>& prefixes) const {
-        if ((static_cast<const trie_node<T>*>(node))->has_info()) {
-            prefixes.push_back(p);
+    std::optional<T> lookup(P key) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+
+        const trie_node_base* currNode = &root;
+        std::optional<T> best;
+        unsigned bits = sizeof(P) * 8;
+
+        while (true) {
+            const trie_node<T> *tn = static_cast<const trie_node<T>*>(currNode);
+            if (tn->has_info()) {
+                best = tn->value;
+            }
+            if (bits == 0) {
+                break;
+            }
+            currNode = (key & (P(1) << (sizeof(P) * 8 - 1))) ? currNode->right.get() : currNode->left.get();
+            if (!currNode) {
+                break;
+            }
+            key <<= 1;
+            bits--;
+        }
+        return best;
+    }
+
+    // find() for a burst of prefixes. The walks advance one level at a time
+    // in lockstep and the next node of every in-flight walk is prefetched, so
+    // the cache misses of the whole group overlap instead of serializing.
+    template<typename P>
+    void find_batch(std::span<const prefix<P>> prefixes, std::span<std::optional<T>> values) const {
+        if (values.size() < prefixes.size()) {
+            throw std::invalid_argument(fmt::format("batch output too small {} < {}", values.size(), prefixes.size()));
+        }
+
+        for (size_t base = 0; base < prefixes.size(); base += batch_group) {
+            size_t n = std::min(batch_group, prefixes.size() - base);
+            const trie_node_base* nodes[batch_group];
+            prefix<P> ps[batch_group];
+            uint8_t lanes[batch_group];
+            size_t active = n;
+
+            for (size_t i = 0; i < n; i++) {
+                nodes[i] = &root;
+                ps[i] = prefixes[base + i];
+                lanes[i] = i;
+            }
+
+            while (active) {
+                size_t still = 0;
+                for (size_t l = 0; l < active; l++) {
+                    uint8_t i = lanes[l];
+                    if (ps[i].len == 0) {
+                        values[base + i] = static_cast<const trie_node<T>*>(nodes[i])->value;
+                        continue;
+                    }
+                    const trie_node_base* next = ps[i].highest_bit_is_set() ? nodes[i]->right.get() : nodes[i]->left.get();
+                    if (!next) {
+                        values[base + i] = std::nullopt;
+                        continue;
+                    }
+                    __builtin_prefetch(next);
+                    nodes[i] = next;
+                    ps[i].v <<= 1;
+                    ps[i].len--;
+                    lanes[still++] = i;
+                }
+                active = still;
+            }
         }
+    }
 
-        if (node->left) {
-            prefix<P> left_p = prefix<P>(p.v, p.len + 1);
-            dump(node->left.get(), left_p, prefixes);
+    // lookup() for a burst of keys, interleaved like find_batch().
+    template<typename P>
+    void lookup_batch(std::span<const P> keys, std::span<std::optional<T>> values) const {
+        if (values.size() < keys.size()) {
+            throw std::invalid_argument(fmt::format("batch output too small {} < {}", values.size(), keys.size()));
         }
-        if (node->right) {
-            prefix<P> right_p = prefix<P>(p.v | (P(1) << (sizeof(P) * 8 - 1 - p.len)), p.len + 1);
-            dump(node->right.get(), right_p, prefixes);
+
+        for (size_t base = 0; base < keys.size(); base += batch_group) {
+            size_t n = std::min(batch_group, keys.size() - base);
+            const trie_node_base* nodes[batch_group];
+            P ks[batch_group];
+            uint8_t lanes[batch_group];
+            size_t active = n;
+
+            for (size_t i = 0; i < n; i++) {
+                nodes[i] = &root;
+                ks[i] = keys[base + i];
+                lanes[i] = i;
+                values[base + i] = std::nullopt;
+            }
+
+            for (unsigned bits = sizeof(P) * 8; active; bits--) {
+                size_t still = 0;
+                for (size_t l = 0; l < active; l++) {
+                    uint8_t i = lanes[l];
+                    const trie_node<T> *tn = static_cast<const trie_node<T>*>(nodes[i]);
+                    if (tn->has_info()) {
+                        values[base + i] = tn->value;
+                    }
+                    if (bits == 0) {
+                        continue;
+                    }
+                    const trie_node_base* next = (ks[i] & (P(1) << (sizeof(P) * 8 - 1))) ? tn->right.get() : tn->left.get();
+                    if (!next) {
+                        continue;
+                    }
+                    __builtin_prefetch(next);
+                    nodes[i] = next;
+                    ks[i] <<= 1;
+                    lanes[still++] = i;
+                }
+                active = still;
+            }
         }
     }
 
     template<typename P>
     void dump(std::vector<prefix<P>>& prefixes) const {
-        dump(&root, {0, 0}, prefixes);
+        for (const auto& [p, value] : entries<P>()) {
+            prefixes.push_back(p);
+        }
+    }
+
+    // every (prefix, value) pair, in dump() order, without materializing
+    // them: for (auto [p, v] : t.entries<uint32_t>()).
+    template<typename P>
+    trie_range<trie_iterator<T, P>> entries() const {
+        return trie_range(trie_iterator<T, P>(&root, prefix<P>(0, 0)));
+    }
+
+    // p and its more specifics.
+    template<typename P>
+    trie_range<trie_iterator<T, P>> subtree(prefix<P> p) const {
+        const trie_node_base* n = &root;
+        for (unsigned d = 0; n && d < p.len; d++) {
+            n = (p.v & (P(1) << (sizeof(P) * 8 - 1 - d))) ? n->right.get() : n->left.get();
+        }
+        return trie_range(n ? trie_iterator<T, P>(n, p) : trie_iterator<T, P>());
+    }
+
+    // the less specifics of p, shortest first, and p itself.
+    template<typename P>
+    trie_range<trie_covering_iterator<T, P>> covering(prefix<P> p) const {
+        return trie_range(trie_covering_iterator<T, P>(&root, p));
     }
 
     size_t max_depth() const {
         return root.max_depth();
     }
 
+    size_t node_count() const {
+        return root.node_count();
+    }
+
+    // the table forwarding every address as this one does with the fewest
+    // prefixes into out, see trie_aggregator in aggregate.hh.
+    template<typename P, typename Aggregator = trie_aggregator<T, P>>
+    void aggregate(trie<T>& out) const {
+        Aggregator::aggregate(*this, out);
+    }
+
+    // writes an mmap-able snapshot served by trie_view<T>, see trie_view.hh.
+    template<typename View = trie_view<T>>
+    void save(const std::string& path) const {
+        View::save(*this, path);
+    }
+
+private:
+    // lays down sorted prefixes under at, the node of base, all of them
+    // within base: each one only walks from where its path leaves the path
+    // of the previous one.
+    template<typename P>
+    static void lay_down(trie_node_base* at, prefix<P> base, std::span<const std::pair<prefix<P>, T>> table) {
+        // path[d] is the node at depth d on the path of the previous prefix.
+        trie_node_base* path[sizeof(P) * 8 + 1];
+        path[base.len] = at;
+        prefix<P> prev = base;
+
+        for (const auto& [p, value] : table) {
+            unsigned depth = std::min<unsigned>({common_bits(p.v, prev.v), p.len, prev.len});
+            P v = depth < sizeof(P) * 8 ? P(p.v << depth) : P(0);
+            for (; depth < p.len; depth++) {
+                auto& child = (v & (P(1) << (sizeof(P) * 8 - 1))) ? path[depth]->right : path[depth]->left;
+                if (!child) {
+                    child = std::make_unique<trie_node<T>>();
+                }
+                path[depth + 1] = child.get();
+                v <<= 1;
+            }
+            static_cast<trie_node<T>*>(path[p.len])->set(value);
+            prev = p;
+        }
+    }
+
+    template<typename P>
+    static unsigned common_bits(P a, P b) {
+        P diff = a ^ b;
+        if (!diff) {
+            return sizeof(P) * 8;
+        }
+        if constexpr (sizeof(P) > sizeof(uint64_t)) {
+            uint64_t hi = uint64_t(diff >> 64);
+            return hi ? __builtin_clzll(hi) : 64 + __builtin_clzll(uint64_t(diff));
+        } else {
+            return __builtin_clzll(uint64_t(diff)) - (64 - sizeof(P) * 8);
+        }
+    }
+
+    // number of walks kept in flight by the batch lookups.
+    static constexpr size_t batch_group = 16;
+
+    // build_parallel() partitions by at most this many top bits.
+    static constexpr unsigned max_partition_bits = 20;
 };
 
 
@@ -0,0 +1,197 @@
+#include "bench_util.hh"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+
+// Core trie<T> operations over three prefix distributions. Built against a
+// benchmark library with libpfm, hardware counters can be added to every
+// result, e.g.
+//   trie_bench --benchmark_filter=BM_trie --benchmark_perf_counters=CACHE-MISSES,BRANCH-MISSES
+
+namespace {
+
+enum distribution { uniform, bgp, deep };
+
+std::vector<prefix<uint32_t>> make_prefixes(int dist) {
+    switch (dist) {
+    case uniform:
+        return uniform_prefixes(table_size);
+    case bgp:
+        return random_prefixes(table_size);
+    default:
+        return deep_prefixes(table_size);
+    }
+}
+
+// the prefixes of a distribution and the trie holding them, built once.
+struct table {
+    std::vector<prefix<uint32_t>> prefixes;
+    trie<uint32_t> t;
+
+    explicit table(int dist) : prefixes{make_prefixes(dist)} {
+        uint32_t value = 1;
+        for (const auto& p : prefixes) {
+            t.insert(p, value++);
+        }
+    }
+};
+
+const table& get_table(int dist) {
+    static std::unique_ptr<table> tables[3];
+    if (!tables[dist]) {
+        tables[dist] = std::make_unique<table>(dist);
+    }
+    return *tables[dist];
+}
+
+void set_label(benchmark::State& state) {
+    static const char* names[] = {"uniform", "bgp", "deep"};
+    state.SetLabel(names[state.range(0)]);
+}
+
+// ns/op is the per_insert counter, the table is torn down untimed.
+void BM_trie_insert(benchmark::State& state) {
+    auto prefixes = make_prefixes(state.range(0));
+    size_t nodes = 0;
+    for (auto _ : state) {
+        auto t = std::make_unique<trie<uint32_t>>();
+        uint32_t value = 1;
+        for (const auto& p : prefixes) {
+            t->insert(p, value++);
+        }
+        state.PauseTiming();
+        nodes = t->node_count();
+        t.reset();
+        state.ResumeTiming();
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations() * prefixes.size());
+    state.counters["per_insert"] = benchmark::Counter(
+        prefixes.size(), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+    // malloc headers are not counted.
+    state.counters["nodes"] = nodes;
+    state.counters["bytes_per_prefix"] = double(nodes * sizeof(trie_node<uint32_t>)) / prefixes.size();
+}
+
+void BM_trie_find_hit(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    std::vector<prefix<uint32_t>> queries(tab.prefixes.begin(), tab.prefixes.begin() + key_count);
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(3));
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tab.t.find(queries[i++ & (key_count - 1)]));
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+// siblings of inserted prefixes that were not inserted themselves, so a miss
+// walks about as deep as a hit before it fails.
+void BM_trie_find_miss(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    std::vector<prefix<uint32_t>> queries;
+    for (const auto& p : tab.prefixes) {
+        if (p.len == 0) {
+            continue;
+        }
+        prefix<uint32_t> q(p.v ^ (uint32_t(1) << (32 - p.len)), p.len);
+        auto found = tab.t.find(q);
+        if (!found || *found == init_value<uint32_t>()) {
+            queries.push_back(q);
+        }
+        if (queries.size() == key_count) {
+            break;
+        }
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tab.t.find(queries[i++ % queries.size()]));
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_trie_lookup(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    std::vector<uint32_t> keys = random_keys(key_count);
+    if (state.range(0) == deep) {
+        // random keys would leave the four /12s right away.
+        for (size_t k = 0; k < key_count; k++) {
+            keys[k] = tab.prefixes[k].v | (keys[k] & 0xf);
+        }
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tab.t.lookup(keys[i++ & (key_count - 1)]));
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_trie_dump(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    std::vector<prefix<uint32_t>> out;
+    out.reserve(tab.prefixes.size());
+    for (auto _ : state) {
+        out.clear();
+        tab.t.dump(out);
+        benchmark::DoNotOptimize(out.data());
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations() * out.size());
+    state.counters["per_prefix"] = benchmark::Counter(
+        out.size(), benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// the same walk as dump() without the vector.
+void BM_trie_iterate(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    size_t count = 0;
+    for (auto _ : state) {
+        count = 0;
+        for (auto [p, v] : tab.t.entries<uint32_t>()) {
+            benchmark::DoNotOptimize(v);
+            count++;
+        }
+    }
+    set_label(state);
+    state.SetItemsProcessed(state.iterations() * count);
+    state.counters["per_prefix"] = benchmark::Counter(
+        count, benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+// more specifics of the /8 or /12 above an inserted prefix: the part of the
+// table an operational query touches, against a dump of all of it.
+void BM_trie_subtree(benchmark::State& state) {
+    const auto& tab = get_table(state.range(0));
+    uint8_t len = state.range(0) == deep ? 12 : 8;
+    std::vector<prefix<uint32_t>> tops;
+    for (size_t k = 0; tops.size() < 1024; k += 7919) {
+        const auto& p = tab.prefixes[k % tab.prefixes.size()];
+        if (p.len >= len) {
+            tops.emplace_back(p.v & ~((uint64_t(1) << (32 - len)) - 1), len);
+        }
+    }
+    size_t i = 0, found = 0;
+    for (auto _ : state) {
+        for (auto [p, v] : tab.t.subtree(tops[i++ & 1023])) {
+            benchmark::DoNotOptimize(v);
+            found++;
+        }
+    }
+    set_label(state);
+    state.counters["prefixes"] = benchmark::Counter(found, benchmark::Counter::kAvgIterations);
+}
+
+void distributions(benchmark::internal::Benchmark* b) {
+    b->ArgName("dist")->DenseRange(uniform, deep);
+}
+
+}
+
+BENCHMARK(BM_trie_insert)->Apply(distributions)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_trie_find_hit)->Apply(distributions);
+BENCHMARK(BM_trie_find_miss)->Apply(distributions);
+BENCHMARK(BM_trie_lookup)->Apply(distributions);
+BENCHMARK(BM_trie_dump)->Apply(distributions)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_trie_iterate)->Apply(distributions)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_trie_subtree)->Apply(distributions)->Unit(benchmark::kMicrosecond);
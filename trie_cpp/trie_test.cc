@@ -1,5 +1,9 @@
 #include "trie.hh"
+#include "loader.hh"
+#include <cstdio>
+#include <fstream>
 #include <cstdint>
+#include <random>
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
@@ -36,6 +40,15 @@ TEST(ACL, Test1) {
     EXPECT_EQ(r.show(), "192.168.0.0/16 0.0.0.0/0 0-65535 0-65535 0-255");
 }
 
+TEST(ACL, Match) {
+    acl_rule r = {"192.168.0.0/16", "0.0.0.0/0", "0-65535", "80-80", "6-6"};
+    EXPECT_TRUE(r.match({0xc0a80101, 0x08080808, 1234, 80, 6}));
+    EXPECT_FALSE(r.match({0xc0a90101, 0x08080808, 1234, 80, 6}));
+    EXPECT_FALSE(r.match({0xc0a80101, 0x08080808, 1234, 81, 6}));
+    EXPECT_FALSE(r.match({0xc0a80101, 0x08080808, 1234, 80, 17}));
+    EXPECT_EQ(five_tuple({0xc0a80101, 0x08080808, 1234, 80, 6}).show(), "192.168.1.1 8.8.8.8 1234 80 6");
+}
+
 
 TEST(Trie, Test1) {
     trie<uint32_t> bt;
@@ -78,3 +91,322 @@ TEST(Trie, Test4) {
     ));
 }
 
+
+TEST(Trie, Lookup) {
+    trie<uint32_t> bt;
+    bt.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    bt.insert(ipv4_prefix("10.1.0.0/16"), 2);
+    bt.insert(ipv4_prefix("10.1.2.3/32"), 3);
+
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0a010203), 3);
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0a010204), 2);
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0a020000), 1);
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0b000000), std::nullopt);
+}
+
+TEST(Trie, Erase) {
+    trie<uint32_t> bt;
+    bt.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    bt.insert(ipv4_prefix("10.1.2.0/24"), 2);
+    bt.insert(ipv4_prefix("10.1.3.0/24"), 3);
+    size_t nodes = bt.node_count();
+
+    // the /24 shares its path with the other one down to the /23.
+    EXPECT_TRUE(bt.erase(ipv4_prefix("10.1.3.0/24")));
+    EXPECT_EQ(bt.node_count(), nodes - 1);
+    EXPECT_FALSE(bt.erase(ipv4_prefix("10.1.3.0/24")));
+    EXPECT_FALSE(bt.erase(ipv4_prefix("10.1.0.0/16")));
+    EXPECT_FALSE(bt.erase(ipv4_prefix("11.0.0.0/8")));
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0a010301), 1);
+
+    // the /8 keeps its node, the path below it goes.
+    EXPECT_TRUE(bt.erase(ipv4_prefix("10.1.2.0/24")));
+    EXPECT_EQ(bt.node_count(), 9);
+    EXPECT_TRUE(bt.erase(ipv4_prefix("10.0.0.0/8")));
+    EXPECT_EQ(bt.node_count(), 1);
+    EXPECT_EQ(bt.lookup<uint32_t>(0x0a010201), std::nullopt);
+
+    bt.insert(ipv4_prefix("0.0.0.0/0"), 4);
+    EXPECT_TRUE(bt.erase(ipv4_prefix("0.0.0.0/0")));
+    EXPECT_EQ(bt.node_count(), 1);
+}
+
+TEST(Trie, Batch) {
+    std::mt19937 rng(1);
+    trie<uint32_t> bt;
+    std::vector<prefix<uint32_t>> prefixes;
+    for (uint32_t i = 1; i <= 1000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        bt.insert<uint32_t>({v, len}, i);
+        prefixes.emplace_back(v, len);
+        prefixes.emplace_back(rng() & 0xffff0000, 16);
+    }
+
+    std::vector<std::optional<uint32_t>> values(prefixes.size());
+    bt.find_batch<uint32_t>(prefixes, values);
+    for (size_t i = 0; i < prefixes.size(); i++) {
+        EXPECT_EQ(values[i], bt.find(prefixes[i])) << prefixes[i].show();
+    }
+
+    std::vector<uint32_t> keys(1001);
+    for (auto& k : keys) {
+        k = rng();
+    }
+    values.assign(keys.size(), 0);
+    bt.lookup_batch<uint32_t>(keys, values);
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(values[i], bt.lookup(keys[i])) << keys[i];
+    }
+}
+
+TEST(IPPrefix, IPv6) {
+    ipv6_prefix p1 = "2001:db8::/32";
+    EXPECT_EQ(p1.v, uint128_t(0x20010db8) << 96);
+    EXPECT_EQ(p1.show(), "2001:db8::/32");
+
+    EXPECT_EQ(ipv6_prefix("::/0").show(), "::/0");
+    EXPECT_EQ(ipv6_prefix("::1/128").show(), "::1/128");
+    EXPECT_EQ(ipv6_prefix("2001:0DB8:0:0:1:0:0:1/128").show(), "2001:db8::1:0:0:1/128");
+    EXPECT_EQ(ipv6_prefix("2001:db8:0:1:1:1:1:1/128").show(), "2001:db8:0:1:1:1:1:1/128");
+    EXPECT_EQ(ipv6_prefix("::ffff:192.168.0.1/128").show(), "::ffff:c0a8:1/128");
+
+    EXPECT_THROW(ipv6_prefix("2001:db8::/129"), std::invalid_argument);
+    EXPECT_THROW(ipv6_prefix("2001:db8::1::/64"), std::invalid_argument);
+    EXPECT_THROW(ipv6_prefix("2001:db8:12345::/48"), std::invalid_argument);
+    EXPECT_THROW(ipv6_prefix("1:2:3:4:5:6:7/128"), std::invalid_argument);
+    EXPECT_THROW(ipv6_prefix("2001:db8::1/64"), std::invalid_argument);
+}
+
+TEST(Trie, Build) {
+    std::mt19937 rng(2);
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        table.emplace_back(prefix<uint32_t>(v, len), i);
+    }
+    // a duplicate, the later value wins.
+    table.emplace_back(table[10].first, 12345);
+
+    trie<uint32_t> inserted;
+    for (const auto& [p, v] : table) {
+        inserted.insert(p, v);
+    }
+
+    trie<uint32_t> built;
+    built.build<uint32_t>(table);
+    EXPECT_EQ(built.node_count(), inserted.node_count());
+    EXPECT_EQ(built.find(table[10].first), 12345);
+
+    std::vector<prefix<uint32_t>> expected, dumped;
+    inserted.dump(expected);
+    built.dump(dumped);
+    EXPECT_EQ(dumped, expected);
+    for (const auto& [p, v] : table) {
+        EXPECT_EQ(built.find(p), inserted.find(p)) << p.show();
+    }
+
+    // unsorted input passed as sorted is still correct.
+    trie<uint32_t> unsorted;
+    unsorted.build<uint32_t>(table, true);
+    dumped.clear();
+    unsorted.dump(dumped);
+    EXPECT_EQ(dumped, expected);
+    EXPECT_EQ(unsorted.find(table[10].first), 12345);
+}
+
+TEST(Trie, BuildParallel) {
+    std::mt19937 rng(3);
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+    for (uint32_t i = 1; i <= 5000; i++) {
+        // a third of them shorter than the partition bits, down to /0.
+        uint8_t len = i % 3 ? 8 + rng() % 25 : rng() % 12;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        table.emplace_back(prefix<uint32_t>(v, len), i);
+    }
+    table.emplace_back(table[10].first, 12345);
+    table.emplace_back(table[11].first, 0);
+
+    trie<uint32_t> inserted;
+    for (const auto& [p, v] : table) {
+        inserted.insert(p, v);
+    }
+    std::vector<prefix<uint32_t>> expected;
+    inserted.dump(expected);
+
+    auto sorted = table;
+    std::stable_sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.first.v != b.first.v ? a.first.v < b.first.v : a.first.len < b.first.len;
+    });
+    for (size_t threads : {1, 3, 8}) {
+        for (unsigned bits : {0, 1, 4, 8, 16, 20}) {
+            for (bool is_sorted : {false, true}) {
+                trie<uint32_t> built;
+                built.insert(ipv4_prefix("10.0.0.0/8"), 99);
+                built.build_parallel<uint32_t>(is_sorted ? sorted : table, threads, is_sorted, bits);
+                EXPECT_EQ(built.node_count(), inserted.node_count()) << threads << " " << bits;
+                std::vector<prefix<uint32_t>> dumped;
+                built.dump(dumped);
+                EXPECT_EQ(dumped, expected) << threads << " " << bits;
+                for (const auto& [p, v] : table) {
+                    ASSERT_EQ(built.find(p), inserted.find(p)) << p.show();
+                }
+            }
+        }
+    }
+
+    trie<uint32_t> t;
+    EXPECT_THROW(t.build_parallel<uint32_t>(table, 0), std::invalid_argument);
+    EXPECT_THROW(t.build_parallel<uint32_t>(table, 2, false, 21), std::invalid_argument);
+    // fewer prefixes than partitions, and none at all.
+    t.build_parallel<uint32_t>(std::span(table.data(), 3), 4);
+    EXPECT_EQ(t.find(table[1].first), 2);
+    t.build_parallel<uint32_t>({}, 4);
+    EXPECT_EQ(t.node_count(), 1);
+
+    // the partition bits cover all of an 8-bit key.
+    trie<uint32_t> small, small_inserted;
+    std::vector<std::pair<prefix<uint8_t>, uint32_t>> small_table;
+    for (uint32_t i = 1; i <= 300; i++) {
+        uint8_t len = rng() % 9;
+        small_table.emplace_back(prefix<uint8_t>(len ? uint8_t(rng() & ~((1u << (8 - len)) - 1)) : 0, len), i);
+        small_inserted.insert(small_table.back().first, i);
+    }
+    small.build_parallel<uint8_t>(small_table, 4, false, 8);
+    EXPECT_THROW(small.build_parallel<uint8_t>(small_table, 4, false, 9), std::invalid_argument);
+    EXPECT_EQ(small.node_count(), small_inserted.node_count());
+    for (unsigned k = 0; k < 256; k++) {
+        EXPECT_EQ(small.lookup(uint8_t(k)), small_inserted.lookup(uint8_t(k))) << k;
+    }
+}
+
+TEST(Trie, Iterator) {
+    trie<uint32_t> t;
+    EXPECT_TRUE(t.entries<uint32_t>().empty());
+    t.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    t.insert(ipv4_prefix("10.1.0.0/16"), 2);
+    t.insert(ipv4_prefix("10.1.2.3/32"), 3);
+    t.insert(ipv4_prefix("11.0.0.0/8"), 4);
+    t.insert(ipv4_prefix("0.0.0.0/0"), 5);
+
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> all(t.entries<uint32_t>().begin(), t.entries<uint32_t>().end());
+    EXPECT_THAT(all, testing::ElementsAre(std::pair(prefix<uint32_t>(ipv4_prefix("0.0.0.0/0")), 5),
+                                          std::pair(prefix<uint32_t>(ipv4_prefix("10.0.0.0/8")), 1),
+                                          std::pair(prefix<uint32_t>(ipv4_prefix("10.1.0.0/16")), 2),
+                                          std::pair(prefix<uint32_t>(ipv4_prefix("10.1.2.3/32")), 3),
+                                          std::pair(prefix<uint32_t>(ipv4_prefix("11.0.0.0/8")), 4)));
+
+    std::vector<uint32_t> values;
+    for (auto [p, v] : t.subtree(prefix<uint32_t>(ipv4_prefix("10.0.0.0/8")))) {
+        values.push_back(v);
+    }
+    EXPECT_THAT(values, testing::ElementsAre(1, 2, 3));
+    // no node for the prefix, or a node without info below.
+    EXPECT_TRUE(t.subtree(prefix<uint32_t>(ipv4_prefix("12.0.0.0/8"))).empty());
+    EXPECT_TRUE(t.subtree(prefix<uint32_t>(ipv4_prefix("10.1.2.4/32"))).empty());
+    EXPECT_EQ((*t.subtree(prefix<uint32_t>(ipv4_prefix("10.1.2.0/24"))).begin()).second, 3);
+
+    values.clear();
+    for (auto [p, v] : t.covering(prefix<uint32_t>(ipv4_prefix("10.1.2.3/32")))) {
+        values.push_back(v);
+    }
+    EXPECT_THAT(values, testing::ElementsAre(5, 1, 2, 3));
+    values.clear();
+    for (auto [p, v] : t.covering(prefix<uint32_t>(ipv4_prefix("10.1.128.0/17")))) {
+        values.push_back(v);
+    }
+    EXPECT_THAT(values, testing::ElementsAre(5, 1, 2));
+
+    trie<uint32_t> v6;
+    v6.insert(ipv6_prefix("2001:db8::/32"), 1);
+    v6.insert(ipv6_prefix("2001:db8::1/128"), 2);
+    values.clear();
+    for (auto [p, v] : v6.entries<uint128_t>()) {
+        values.push_back(v);
+    }
+    EXPECT_THAT(values, testing::ElementsAre(1, 2));
+}
+
+TEST(Trie, IteratorRandom) {
+    std::mt19937 rng(3);
+    trie<uint32_t> t;
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> table;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? (rng() & 0xf0ff00ff) & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        prefix<uint32_t> p(v, len);
+        if (!t.find(p) || !*t.find(p)) {
+            t.insert(p, i);
+            table.emplace_back(p, i);
+        }
+    }
+    // pre-order is address order, shorter first on a tie.
+    std::sort(table.begin(), table.end(), [](const auto& a, const auto& b) {
+        return a.first.v != b.first.v ? a.first.v < b.first.v : a.first.len < b.first.len;
+    });
+    std::vector<std::pair<prefix<uint32_t>, uint32_t>> all(t.entries<uint32_t>().begin(), t.entries<uint32_t>().end());
+    EXPECT_EQ(all, table);
+
+    for (int i = 0; i < 300; i++) {
+        prefix<uint32_t> q = table[rng() % table.size()].first;
+        if (i % 2) {
+            uint8_t len = rng() % 33;
+            q = prefix<uint32_t>(len ? q.v & ~((uint64_t(1) << (32 - len)) - 1) : 0, len);
+        }
+        // prefix::contains() does not take /0.
+        auto contains = [](prefix<uint32_t> a, prefix<uint32_t> b) {
+            return a.len <= b.len && (a.len == 0 || ((a.v ^ b.v) >> (32 - a.len)) == 0);
+        };
+        std::vector<std::pair<prefix<uint32_t>, uint32_t>> more, less;
+        for (const auto& e : table) {
+            if (contains(q, e.first)) {
+                more.push_back(e);
+            }
+            if (contains(e.first, q)) {
+                less.push_back(e);
+            }
+        }
+        std::sort(less.begin(), less.end(), [](const auto& a, const auto& b) {
+            return a.first.len < b.first.len;
+        });
+        auto sub = t.subtree(q);
+        auto cov = t.covering(q);
+        EXPECT_EQ(std::vector(sub.begin(), sub.end()), more) << q.show();
+        EXPECT_EQ(std::vector(cov.begin(), cov.end()), less) << q.show();
+    }
+}
+
+TEST(Loader, Test1) {
+    std::string path = testing::TempDir() + "loader_test.txt";
+    {
+        std::ofstream out(path);
+        out << "192.168.1.7\n24\n\n10.0.0.0\n8\n0.0.0.0\n0\n";
+    }
+    auto prefixes = load_prefixes<ipv4_prefix>(path);
+    ASSERT_EQ(prefixes.size(), 3);
+    EXPECT_EQ(prefixes[0].show(), "192.168.1.0/24");
+    EXPECT_EQ(prefixes[1].show(), "10.0.0.0/8");
+    EXPECT_EQ(prefixes[2].show(), "0.0.0.0/0");
+
+    {
+        std::ofstream out(path);
+        out << "2001:db8::1\n32\n";
+    }
+    auto prefixes6 = load_prefixes<ipv6_prefix>(path);
+    ASSERT_EQ(prefixes6.size(), 1);
+    EXPECT_EQ(prefixes6[0].show(), "2001:db8::/32");
+
+    {
+        std::ofstream out(path);
+        out << "10.0.0.0\n33\n";
+    }
+    EXPECT_THROW(load_prefixes<ipv4_prefix>(path), std::invalid_argument);
+    {
+        std::ofstream out(path);
+        out << "10.0.0.0\n";
+    }
+    EXPECT_THROW(load_prefixes<ipv4_prefix>(path), std::invalid_argument);
+    std::remove(path.c_str());
+    EXPECT_THROW(load_prefixes<ipv4_prefix>(path), std::runtime_error);
+}
@@ -0,0 +1,351 @@
+#ifndef TRIE_VIEW_HH
+#define TRIE_VIEW_HH
+
+#include "trie.hh"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// On disk snapshot of a trie<T>, written by trie<T>::save() and served by
+// trie_view<T>, which mmaps it read-only and looks up directly in the file.
+//
+// Layout, native byte order:
+//   trie_view_header
+//   trie_view_node<T>[node_count]   node 0 is the root, children link by index
+//
+// Nodes are numbered depth first with children after their parent, so the
+// format is position independent and a child index of 0 means "none". Every
+// process mapping the same file shares its page cache copy.
+struct trie_view_header {
+    static constexpr char expected_magic[8] = {'T', 'R', 'I', 'E', 'V', 'I', 'E', 'W'};
+    static constexpr uint32_t current_version = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t value_size;
+    uint64_t node_count;
+    // snapshot_checksum() of the node array.
+    uint64_t checksum;
+};
+
+template <typename T>
+struct trie_view_node {
+    uint32_t left;
+    uint32_t right;
+    T value;
+};
+
+// FNV-1a style 64-bit hash taken a word at a time, the tail byte by byte.
+// Meant to catch torn or corrupted files, not tampering.
+inline uint64_t snapshot_checksum(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = 0xcbf29ce484222325ull;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t w;
+        std::memcpy(&w, p + i, sizeof(w));
+        h ^= w;
+        h *= 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+template <typename T>
+class trie_view {
+public:
+    static_assert(std::is_trivially_copyable_v<T>, "T must be trivially copyable");
+    using node = trie_view_node<T>;
+    static constexpr uint32_t null = 0;
+
+    trie_view() = default;
+    trie_view(const trie_view&) = delete;
+    trie_view& operator=(const trie_view&) = delete;
+    trie_view(trie_view&& other) noexcept {
+        *this = std::move(other);
+    }
+    trie_view& operator=(trie_view&& other) noexcept {
+        std::swap(base, other.base);
+        std::swap(size, other.size);
+        std::swap(nodes, other.nodes);
+        std::swap(count, other.count);
+        return *this;
+    }
+    ~trie_view() {
+        if (base) {
+            munmap(base, size);
+        }
+    }
+
+    // Maps the snapshot at path. The header, the sizes and, when verify is
+    // set, the checksum and the child links are checked; nothing is copied.
+    static trie_view open(const std::string& path, bool verify = true) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("cannot open {}: {}", path, std::strerror(errno)));
+        }
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error(fmt::format("cannot stat {}: {}", path, std::strerror(err)));
+        }
+        if (size_t(st.st_size) < sizeof(trie_view_header)) {
+            ::close(fd);
+            throw std::invalid_argument(fmt::format("{} is too short for a trie snapshot", path));
+        }
+
+        void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        int err = errno;
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error(fmt::format("cannot mmap {}: {}", path, std::strerror(err)));
+        }
+
+        trie_view view;
+        view.base = addr;
+        view.size = st.st_size;
+        view.validate(path, verify);
+        return view;
+    }
+
+    // writes t to path through a temporary file next to it, synced before
+    // it is renamed over path, so processes that still map the previous
+    // snapshot keep a consistent copy and a crash leaves either snapshot
+    // whole. The same trie always gives the same bytes.
+    template<typename Trie>
+    static void save(const Trie& t, const std::string& path) {
+        std::vector<node> out;
+        append(out, &t.root);
+
+        std::vector<std::pair<const trie_node_base*, uint32_t>> stack{{&t.root, 0}};
+        while (!stack.empty()) {
+            auto [n, idx] = stack.back();
+            stack.pop_back();
+
+            uint32_t left = null, right = null;
+            if (n->left) {
+                left = append(out, n->left.get());
+            }
+            if (n->right) {
+                right = append(out, n->right.get());
+            }
+            out[idx].left = left;
+            out[idx].right = right;
+            if (right != null) {
+                stack.emplace_back(n->right.get(), right);
+            }
+            if (left != null) {
+                stack.emplace_back(n->left.get(), left);
+            }
+        }
+
+        trie_view_header header{};
+        std::memcpy(header.magic, trie_view_header::expected_magic, sizeof(header.magic));
+        header.version = trie_view_header::current_version;
+        header.value_size = sizeof(T);
+        header.node_count = out.size();
+        header.checksum = snapshot_checksum(out.data(), out.size() * sizeof(node));
+
+        std::string tmp = path + ".XXXXXX";
+        int fd = mkstemp(tmp.data());
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("cannot create {}: {}", tmp, std::strerror(errno)));
+        }
+        try {
+            // mkstemp creates it 0600, the snapshot is meant for other
+            // processes to map.
+            check(fchmod(fd, 0644), "chmod", tmp);
+            write_all(fd, &header, sizeof(header), tmp);
+            write_all(fd, out.data(), out.size() * sizeof(node), tmp);
+            check(fsync(fd), "fsync", tmp);
+        } catch (...) {
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            throw;
+        }
+        if (::close(fd) != 0) {
+            int err = errno;
+            ::unlink(tmp.c_str());
+            throw std::runtime_error(fmt::format("cannot close {}: {}", tmp, std::strerror(err)));
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            int err = errno;
+            ::unlink(tmp.c_str());
+            throw std::runtime_error(fmt::format("cannot rename {} to {}: {}", tmp, path, std::strerror(err)));
+        }
+
+        // the rename itself is only durable once the directory is synced.
+        size_t slash = path.rfind('/');
+        std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (dir_fd < 0) {
+            throw std::runtime_error(fmt::format("cannot open {}: {}", dir, std::strerror(errno)));
+        }
+        int synced = fsync(dir_fd);
+        int err = errno;
+        ::close(dir_fd);
+        if (synced != 0) {
+            throw std::runtime_error(fmt::format("cannot fsync {}: {}", dir, std::strerror(err)));
+        }
+    }
+
+    template<typename P>
+    std::optional<T> find(prefix<P> p) const {
+        uint32_t curr = 0;
+        while (p.len) {
+            curr = p.highest_bit_is_set() ? nodes[curr].right : nodes[curr].left;
+            if (curr == null) {
+                return std::nullopt;
+            }
+            p.v <<= 1;
+            p.len--;
+        }
+        return nodes[curr].value;
+    }
+
+    // longest prefix match of the key, only nodes with info are candidates.
+    template<typename P>
+    std::optional<T> lookup(P key) const {
+        static_assert(std::is_unsigned_v<P>, "P must be unsigned");
+        uint32_t curr = 0;
+        std::optional<T> best;
+        unsigned bits = sizeof(P) * 8;
+
+        while (true) {
+            const node& n = nodes[curr];
+            if (n.value != init_value<T>()) {
+                best = n.value;
+            }
+            if (bits == 0) {
+                break;
+            }
+            curr = (key & (P(1) << (sizeof(P) * 8 - 1))) ? n.right : n.left;
+            if (curr == null) {
+                break;
+            }
+            key <<= 1;
+            bits--;
+        }
+        return best;
+    }
+
+    template<typename P>
+    void dump(std::vector<prefix<P>>& prefixes) const {
+        std::vector<std::pair<uint32_t, prefix<P>>> stack{{0, prefix<P>{0, 0}}};
+        while (!stack.empty()) {
+            auto [idx, p] = stack.back();
+            stack.pop_back();
+            const node& n = nodes[idx];
+            if (n.value != init_value<T>()) {
+                prefixes.push_back(p);
+            }
+            if (n.right != null) {
+                stack.emplace_back(n.right, prefix<P>(p.v | (P(1) << (sizeof(P) * 8 - 1 - p.len)), p.len + 1));
+            }
+            if (n.left != null) {
+                stack.emplace_back(n.left, prefix<P>(p.v, p.len + 1));
+            }
+        }
+    }
+
+    size_t node_count() const {
+        return count;
+    }
+
+private:
+    // the node of n at the end of out. Nodes are zeroed first: the padding
+    // after a small T is written out and checksummed too.
+    static uint32_t append(std::vector<node>& out, const trie_node_base* n) {
+        if (out.size() >= std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("trie too large for a snapshot");
+        }
+        node& added = out.emplace_back();
+        std::memset(&added, 0, sizeof(node));
+        added.value = static_cast<const trie_node<T>*>(n)->value;
+        return out.size() - 1;
+    }
+
+    static void check(int ret, const char* what, const std::string& path) {
+        if (ret != 0) {
+            throw std::runtime_error(fmt::format("cannot {} {}: {}", what, path, std::strerror(errno)));
+        }
+    }
+
+    static void write_all(int fd, const void* data, size_t size, const std::string& path) {
+        const char* p = static_cast<const char*>(data);
+        while (size) {
+            ssize_t n = ::write(fd, p, size);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error(fmt::format("cannot write {}: {}", path, std::strerror(errno)));
+            }
+            p += n;
+            size -= n;
+        }
+    }
+
+    void validate(const std::string& path, bool verify) {
+        const auto* header = static_cast<const trie_view_header*>(base);
+        if (std::memcmp(header->magic, trie_view_header::expected_magic, sizeof(header->magic)) != 0) {
+            throw std::invalid_argument(fmt::format("{} is not a trie snapshot", path));
+        }
+        if (header->version != trie_view_header::current_version) {
+            throw std::invalid_argument(fmt::format("{} has snapshot version {}, expected {}",
+                                                    path, header->version, trie_view_header::current_version));
+        }
+        if (header->value_size != sizeof(T)) {
+            throw std::invalid_argument(fmt::format("{} holds {}-byte values, expected {}",
+                                                    path, header->value_size, sizeof(T)));
+        }
+        if (header->node_count == 0 ||
+            header->node_count > (size - sizeof(trie_view_header)) / sizeof(node) ||
+            sizeof(trie_view_header) + header->node_count * sizeof(node) != size) {
+            throw std::invalid_argument(fmt::format("{} has a bad node count {}", path, header->node_count));
+        }
+
+        nodes = reinterpret_cast<const node*>(static_cast<const char*>(base) + sizeof(trie_view_header));
+        count = header->node_count;
+        if (!verify) {
+            return;
+        }
+
+        if (snapshot_checksum(nodes, count * sizeof(node)) != header->checksum) {
+            throw std::invalid_argument(fmt::format("{} fails its checksum", path));
+        }
+        // children always come after their parent, so links can neither
+        // leave the array nor form a cycle.
+        for (size_t i = 0; i < count; i++) {
+            for (uint32_t c : {nodes[i].left, nodes[i].right}) {
+                if (c != null && (c <= i || c >= count)) {
+                    throw std::invalid_argument(fmt::format("{} has a bad link {} at node {}", path, c, i));
+                }
+            }
+        }
+    }
+
+    void* base = nullptr;
+    size_t size = 0;
+    const node* nodes = nullptr;
+    size_t count = 0;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "trie_view.hh"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+
+class TrieView : public testing::Test {
+protected:
+    std::string path = testing::TempDir() + "trie_view_test.snap";
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    void patch(size_t offset, const void* data, size_t size) {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(offset);
+        f.write(static_cast<const char*>(data), size);
+    }
+};
+
+TEST_F(TrieView, Test1) {
+    trie<uint32_t> bt;
+    bt.insert<uint16_t>({0x1234, 16}, 1);
+    bt.insert<uint16_t>({0x4, 16}, 2);
+    bt.save(path);
+
+    auto view = trie_view<uint32_t>::open(path);
+    EXPECT_EQ(view.node_count(), bt.node_count());
+    EXPECT_EQ(view.find<uint16_t>({0x1234, 16}), 1);
+    EXPECT_EQ(view.find<uint16_t>({0x4, 16}), 2);
+    EXPECT_EQ(view.find<uint16_t>({0x1200, 8}), bt.find<uint16_t>({0x1200, 8}));
+    EXPECT_EQ(view.find<uint16_t>({0x8000, 1}), std::nullopt);
+
+    std::vector<prefix<uint16_t>> prefixes;
+    view.dump(prefixes);
+    EXPECT_THAT(prefixes, testing::ElementsAre(
+        prefix<uint16_t>{0x4, 16},
+        prefix<uint16_t>{0x1234, 16}
+    ));
+}
+
+TEST_F(TrieView, SameAsTrie) {
+    std::mt19937 rng(7);
+    trie<uint32_t> bt;
+    std::vector<prefix<uint32_t>> inserted;
+    for (uint32_t i = 1; i <= 3000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        bt.insert<uint32_t>({v, len}, i);
+        inserted.emplace_back(v, len);
+    }
+    bt.save(path);
+    auto view = trie_view<uint32_t>::open(path);
+
+    for (const auto& p : inserted) {
+        EXPECT_EQ(view.find(p), bt.find(p)) << p.show();
+    }
+    for (int i = 0; i < 3000; i++) {
+        uint32_t key = rng();
+        EXPECT_EQ(view.lookup(key), bt.lookup(key)) << key;
+    }
+    std::vector<prefix<uint32_t>> expected, dumped;
+    bt.dump(expected);
+    view.dump(dumped);
+    EXPECT_EQ(dumped, expected);
+
+    // a moved view keeps serving.
+    trie_view<uint32_t> moved = std::move(view);
+    EXPECT_EQ(moved.find(inserted[0]), bt.find(inserted[0]));
+}
+
+TEST_F(TrieView, Invalid) {
+    trie<uint32_t> bt;
+    bt.insert(ipv4_prefix("10.0.0.0/8"), 1);
+    bt.save(path);
+
+    EXPECT_THROW(trie_view<uint64_t>::open(path), std::invalid_argument);
+
+    uint32_t version = 2;
+    patch(offsetof(trie_view_header, version), &version, sizeof(version));
+    EXPECT_THROW(trie_view<uint32_t>::open(path), std::invalid_argument);
+    version = 1;
+    patch(offsetof(trie_view_header, version), &version, sizeof(version));
+    EXPECT_NO_THROW(trie_view<uint32_t>::open(path));
+
+    uint32_t value = 5;
+    patch(sizeof(trie_view_header) + 8 * sizeof(trie_view_node<uint32_t>) + 8, &value, sizeof(value));
+    EXPECT_THROW(trie_view<uint32_t>::open(path), std::invalid_argument);
+    EXPECT_NO_THROW(trie_view<uint32_t>::open(path, false));
+
+    EXPECT_THROW(trie_view<uint32_t>::open(path + ".missing"), std::runtime_error);
+}
+
+TEST_F(TrieView, SameBytes) {
+    // 4-byte links and a 1-byte value, three bytes of padding a node.
+    static_assert(sizeof(trie_view_node<uint8_t>) > 2 * sizeof(uint32_t) + sizeof(uint8_t));
+    std::mt19937 rng(8);
+    trie<uint8_t> bt;
+    for (int i = 1; i <= 1000; i++) {
+        uint8_t len = rng() % 33;
+        uint32_t v = len ? rng() & ~((uint64_t(1) << (32 - len)) - 1) : 0;
+        bt.insert<uint32_t>({v, len}, 1 + i % 255);
+    }
+    auto read = [](const std::string& file) {
+        std::ifstream f(file, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), {});
+    };
+
+    bt.save(path);
+    std::string first = read(path);
+    bt.save(path);
+    std::string second = read(path);
+    EXPECT_EQ(first.size(), sizeof(trie_view_header) + bt.node_count() * sizeof(trie_view_node<uint8_t>));
+    EXPECT_TRUE(first == second);
+
+    auto view = trie_view<uint8_t>::open(path);
+    EXPECT_EQ(view.node_count(), bt.node_count());
+
+    EXPECT_THROW(bt.save(path + ".missing/snap"), std::runtime_error);
+}
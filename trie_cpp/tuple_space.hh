@@ -0,0 +1,314 @@
+#ifndef TUPLE_SPACE_HH
+#define TUPLE_SPACE_HH
+
+#include "classifier.hh"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Tuple space search (Srinivasan, Suri, Varghese) classifier for acl_rule
+// with incremental updates.
+//
+// A rule's tuple is (src len, dst len, src port class, dst port class, proto
+// class), a class being "any", "exact" or "range". All the rules of a tuple
+// live in one hash table keyed by their fields masked to the tuple: prefixes
+// cut to their length, exact ports and protocols as is, "any" and "range"
+// fields left out. Range fields are checked on the rules found in a bucket.
+// A lookup probes the tuples in the order of their highest priority rule and
+// stops once no tuple can beat the best match found so far. insert() and
+// remove() touch one tuple only.
+//
+// Rule ids are priorities, the lowest id wins.
+class tuple_space {
+public:
+    tuple_space() = default;
+
+    // rule i gets id i.
+    explicit tuple_space(const std::vector<acl_rule>& rules) {
+        for (uint32_t i = 0; i < rules.size(); i++) {
+            insert(i, rules[i]);
+        }
+    }
+
+    tuple_space(const tuple_space&) = delete;
+    tuple_space& operator=(const tuple_space&) = delete;
+
+    void insert(uint32_t id, const acl_rule& r) {
+        if (id == no_rule) {
+            throw std::invalid_argument(fmt::format("invalid rule id {}", id));
+        }
+        if (rules.count(id)) {
+            throw std::invalid_argument(fmt::format("rule id {} already in use", id));
+        }
+
+        uint32_t tk = tuple_of(r);
+        auto& t = tuples[tk];
+        if (!t) {
+            t = std::make_unique<tuple>();
+            t->mask = mask_of(r);
+            order.push_back(t.get());
+        }
+        acl_box box(r);
+        auto& bucket = t->table.get(key_of(box.lo, t->mask));
+        auto it = std::lower_bound(bucket.begin(), bucket.end(), id, [](const entry& e, uint32_t id) {
+            return e.id < id;
+        });
+        bucket.insert(it, entry{id, box});
+
+        uint32_t old_min = t->ids.empty() ? no_rule : *t->ids.begin();
+        t->ids.insert(id);
+        rules.emplace(id, std::pair(tk, box));
+        if (id < old_min) {
+            t->min_id = id;
+            sort_order();
+        }
+    }
+
+    // returns false if no rule has this id.
+    bool remove(uint32_t id) {
+        auto rit = rules.find(id);
+        if (rit == rules.end()) {
+            return false;
+        }
+        auto [tk, box] = rit->second;
+        rules.erase(rit);
+
+        auto tit = tuples.find(tk);
+        tuple& t = *tit->second;
+        uint128_t key = key_of(box.lo, t.mask);
+        auto& bucket = t.table.get(key);
+        bucket.erase(std::find_if(bucket.begin(), bucket.end(), [&](const entry& e) {
+            return e.id == id;
+        }));
+        if (bucket.empty()) {
+            t.table.erase(key);
+        }
+
+        t.ids.erase(id);
+        if (t.ids.empty()) {
+            order.erase(std::find(order.begin(), order.end(), &t));
+            tuples.erase(tit);
+        } else if (t.min_id == id) {
+            t.min_id = *t.ids.begin();
+            sort_order();
+        }
+        return true;
+    }
+
+    // id of the highest priority rule matching t.
+    std::optional<uint32_t> classify(const five_tuple& pkt) const {
+        acl_point f = tuple_fields(pkt);
+        uint32_t best = no_rule;
+        for (const tuple* t : order) {
+            if (t->min_id >= best) {
+                break;
+            }
+            const auto* bucket = t->table.find(key_of(f, t->mask));
+            if (!bucket) {
+                continue;
+            }
+            for (const auto& e : *bucket) {
+                if (e.id >= best) {
+                    break;
+                }
+                if (e.box.match(f)) {
+                    best = e.id;
+                    break;
+                }
+            }
+        }
+        return best == no_rule ? std::nullopt : std::optional<uint32_t>(best);
+    }
+
+    size_t size() const {
+        return rules.size();
+    }
+
+    size_t tuple_count() const {
+        return tuples.size();
+    }
+
+    // the rule map's node overhead is not counted.
+    size_t memory_usage() const {
+        size_t bytes = rules.size() * (sizeof(uint32_t) + sizeof(std::pair<uint32_t, acl_box>));
+        for (const auto& [tk, t] : tuples) {
+            bytes += sizeof(tuple) + t->ids.size() * sizeof(uint32_t) + t->table.memory_usage();
+        }
+        return bytes;
+    }
+
+private:
+    static constexpr uint32_t no_rule = std::numeric_limits<uint32_t>::max();
+
+    enum field_class : uint8_t { any, exact, ranged };
+
+    struct entry {
+        uint32_t id;
+        acl_box box;
+    };
+
+    // open addressing with linear probing, one 32-byte slot per key, so a
+    // probe of a tuple is one hash and usually one cache line.
+    class bucket_table {
+    public:
+        bucket_table() : slots(min_slots) {}
+
+        const std::vector<entry>* find(uint128_t key) const {
+            size_t mask = slots.size() - 1;
+            for (size_t i = hash(key) & mask; slots[i].bucket; i = (i + 1) & mask) {
+                if (slots[i].key == key) {
+                    return &buckets[slots[i].bucket - 1];
+                }
+            }
+            return nullptr;
+        }
+
+        std::vector<entry>& get(uint128_t key) {
+            if (2 * (used + 1) > slots.size()) {
+                grow();
+            }
+            size_t mask = slots.size() - 1;
+            size_t i = hash(key) & mask;
+            for (; slots[i].bucket; i = (i + 1) & mask) {
+                if (slots[i].key == key) {
+                    return buckets[slots[i].bucket - 1];
+                }
+            }
+            uint32_t b;
+            if (!free_buckets.empty()) {
+                b = free_buckets.back();
+                free_buckets.pop_back();
+            } else {
+                b = buckets.size();
+                buckets.emplace_back();
+            }
+            slots[i] = {key, b + 1};
+            used++;
+            return buckets[b];
+        }
+
+        // the bucket of key must exist and be empty.
+        void erase(uint128_t key) {
+            size_t mask = slots.size() - 1;
+            size_t i = hash(key) & mask;
+            while (slots[i].key != key) {
+                i = (i + 1) & mask;
+            }
+            free_buckets.push_back(slots[i].bucket - 1);
+            buckets[slots[i].bucket - 1].shrink_to_fit();
+            used--;
+            // backward shift: pull up the keys whose probe run crosses i.
+            for (size_t j = (i + 1) & mask; slots[j].bucket; j = (j + 1) & mask) {
+                size_t home = hash(slots[j].key) & mask;
+                if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+                    continue;
+                }
+                slots[i] = slots[j];
+                i = j;
+            }
+            slots[i] = slot{};
+        }
+
+        size_t memory_usage() const {
+            size_t bytes = slots.capacity() * sizeof(slot) + free_buckets.capacity() * sizeof(uint32_t);
+            for (const auto& b : buckets) {
+                bytes += sizeof(b) + b.capacity() * sizeof(entry);
+            }
+            return bytes;
+        }
+
+    private:
+        static constexpr size_t min_slots = 4;
+
+        struct slot {
+            uint128_t key = 0;
+            // index + 1 in buckets, 0 for an empty slot.
+            uint32_t bucket = 0;
+        };
+
+        static size_t hash(uint128_t k) {
+            uint64_t h = uint64_t(k) * 0x9e3779b97f4a7c15ull ^ uint64_t(k >> 64);
+            h *= 0xff51afd7ed558ccdull;
+            return h ^ (h >> 32);
+        }
+
+        void grow() {
+            std::vector<slot> old(slots.size() * 2);
+            std::swap(old, slots);
+            size_t mask = slots.size() - 1;
+            for (const auto& s : old) {
+                if (s.bucket) {
+                    size_t i = hash(s.key) & mask;
+                    while (slots[i].bucket) {
+                        i = (i + 1) & mask;
+                    }
+                    slots[i] = s;
+                }
+            }
+        }
+
+        std::vector<slot> slots;
+        size_t used = 0;
+        std::vector<std::vector<entry>> buckets;
+        std::vector<uint32_t> free_buckets;
+    };
+
+    struct tuple {
+        // per field mask applied to the packet before hashing.
+        acl_point mask;
+        uint32_t min_id = no_rule;
+        std::set<uint32_t> ids;
+        // buckets are sorted by id.
+        bucket_table table;
+    };
+
+    static field_class class_of(uint32_t lo, uint32_t hi, uint32_t max) {
+        return lo == 0 && hi == max ? any : lo == hi ? exact : ranged;
+    }
+
+    static uint32_t tuple_of(const acl_rule& r) {
+        return r.src.len | r.dst.len << 6 |
+               class_of(r.src_port.low, r.src_port.high, 0xffff) << 12 |
+               class_of(r.dst_port.low, r.dst_port.high, 0xffff) << 14 |
+               class_of(r.proto.low, r.proto.high, 0xff) << 16;
+    }
+
+    static acl_point mask_of(const acl_rule& r) {
+        auto prefix_mask = [](uint8_t len) {
+            return len ? uint32_t(~((uint64_t(1) << (32 - len)) - 1)) : 0u;
+        };
+        auto exact_mask = [](uint32_t lo, uint32_t hi) {
+            return lo == hi ? 0xffffffffu : 0u;
+        };
+        return {prefix_mask(r.src.len), prefix_mask(r.dst.len),
+                exact_mask(r.src_port.low, r.src_port.high),
+                exact_mask(r.dst_port.low, r.dst_port.high),
+                exact_mask(r.proto.low, r.proto.high)};
+    }
+
+    static uint128_t key_of(const acl_point& f, const acl_point& mask) {
+        return uint128_t(f[0] & mask[0]) << 72 | uint128_t(f[1] & mask[1]) << 40 |
+               uint128_t(f[2] & mask[2]) << 24 | uint128_t(f[3] & mask[3]) << 8 | (f[4] & mask[4]);
+    }
+
+    void sort_order() {
+        std::sort(order.begin(), order.end(), [](const tuple* a, const tuple* b) {
+            return a->min_id < b->min_id;
+        });
+    }
+
+    std::unordered_map<uint32_t, std::unique_ptr<tuple>> tuples;
+    // tuples by their highest priority rule.
+    std::vector<tuple*> order;
+    // id -> (tuple, box), to find the rule again on remove().
+    std::unordered_map<uint32_t, std::pair<uint32_t, acl_box>> rules;
+};
+
+#endif
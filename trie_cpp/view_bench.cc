@@ -0,0 +1,39 @@
+#include "bench_util.hh"
+#include "trie_view.hh"
+#include <benchmark/benchmark.h>
+#include <filesystem>
+
+namespace {
+
+const std::string& snapshot() {
+    static const std::string path = [] {
+        auto p = (std::filesystem::temp_directory_path() / "trie_bench.snap").string();
+        build_table<trie<uint32_t>>().save(p);
+        return p;
+    }();
+    return path;
+}
+
+// time until a process can serve, range(0): verify the checksum.
+void BM_view_open(benchmark::State& state) {
+    const auto& path = snapshot();
+    for (auto _ : state) {
+        auto view = trie_view<uint32_t>::open(path, state.range(0));
+        benchmark::DoNotOptimize(view.lookup(uint32_t(0x0a000001)));
+    }
+}
+
+void BM_view_lookup(benchmark::State& state) {
+    auto view = trie_view<uint32_t>::open(snapshot());
+    auto keys = random_keys(key_count);
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(view.lookup(keys[i++ & (key_count - 1)]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+}
+
+BENCHMARK(BM_view_open)->ArgName("verify")->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_view_lookup);